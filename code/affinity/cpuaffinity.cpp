@@ -0,0 +1,63 @@
+#include "cpuaffinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+using namespace std;
+
+vector<int> CpuAffinity::ParseList(const string &list) {
+    vector<int> cpus;
+    const char *p = list.c_str();
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p) {         //跳过无法识别的字符
+            p++;
+            continue;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1) { last = first; }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            if (cpu >= 0) { cpus.push_back(static_cast<int>(cpu)); }
+        }
+    }
+    return cpus;
+}
+
+bool CpuAffinity::PinThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) { return false; }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) { return false; }
+    //覆盖从进程继承的内存策略(如numactl --interleave),之后分配的页优先来自本节点;
+    //不支持NUMA的内核返回ENOSYS,不影响绑定结果
+    syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0);
+    return true;
+}
+
+int CpuAffinity::NodeOf(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (!dir) { return -1; }
+    int node = -1;
+    //该目录下有一个名为nodeN的链接指向所属节点
+    while (struct dirent *entry = readdir(dir)) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1) { break; }
+        node = -1;
+    }
+    closedir(dir);
+    return node;
+}
@@ -0,0 +1,42 @@
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+//线程的CPU绑定与NUMA相关的辅助函数
+//绑定后线程的内存策略设为本地分配,Linux按首次访问分配物理页,
+//因此线程绑定之后自己分配并初始化的缓冲区都落在该CPU所在的NUMA节点上
+class CpuAffinity {
+public:
+    /**
+     * 解析CPU列表,格式同taskset -c与/sys下的cpulist,如"0-3,8,10-11"
+     * @param list 空串返回空列表
+     * @return 按出现顺序排列的CPU编号,格式错误的部分被忽略
+     */
+    static std::vector<int> ParseList(const std::string &list);
+
+    /**
+     * 第i个线程使用的CPU,线程数多于列表长度时循环使用
+     * @return 列表为空时返回-1,表示不绑定
+     */
+    static int Pick(const std::vector<int> &cpus, size_t i) {
+        return cpus.empty() ? -1 : cpus[i % cpus.size()];
+    }
+
+    /**
+     * 把调用线程绑定到cpu上,并使其之后的内存分配优先使用本地NUMA节点
+     * 之后由该线程创建的线程继承同样的绑定,需要不绑定的线程应在调用前创建
+     * @param cpu 小于0时什么也不做
+     * @return 是否绑定成功
+     */
+    static bool PinThread(int cpu);
+
+    /**
+     * @return cpu所在的NUMA节点,无法确定(如非NUMA内核)时返回-1
+     */
+    static int NodeOf(int cpu);
+};
+
+#endif //CPU_AFFINITY_H
@@ -0,0 +1,52 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+
+//服务器的可选配置项,构造WebServer时传入
+//未在WebServer构造函数参数列表中出现的新选项统一放在这里,均带有默认值
+struct Config {
+    /* Reactor模型 */
+    int reactorNum = 0;     //子Reactor数量, 0表示单Reactor+线程池模式, >0表示one loop per thread模式
+    bool reusePort = false; //每个子Reactor各自绑定一个SO_REUSEPORT监听fd并独立accept,需要reactorNum>0
+    bool workStealing = false;  //线程池模式下按fd把任务固定投递给同一工作线程,空闲线程从其他线程窃取,需要reactorNum=0
+
+    /* CPU亲和性,CPU列表的格式同taskset -c,如"0-3,8" */
+    int mainCpu = -1;           //主Reactor线程绑定的CPU, -1表示不绑定
+    std::string workerCpus;     //工作线程(线程池模式)或子Reactor线程依次绑定到列表中的CPU,线程多于CPU时循环使用,空串表示不绑定
+    int logCpu = -1;            //异步日志写线程绑定的CPU, -1表示不绑定
+    bool incomingCpu = false;   //SO_REUSEPORT分片模式下为各分片的监听fd设置SO_INCOMING_CPU为该分片绑定的CPU,
+                                //内核(6.2起)把RX软中断落在该CPU上的连接交给该分片;需把网卡各RX队列的中断亲和性设到同一组CPU上
+
+    /* 日志 */
+    bool logBinary = false;     //以二进制格式写日志(文件后缀.blog),用make logdecode生成的工具还原为文本
+    std::string accessLog;      //访问日志格式"common"、"combined"或"json",空串表示关闭;写入./log/日期.access.log
+    int accessLogSample = 1;    //每accessLogSample个请求记录一个
+    size_t logFileBytes = 0;    //单个日志文件的最大字节数,超过后切换到新文件, 0表示按行数切换;对普通日志和访问日志都生效
+    int logKeepFiles = 0;       //每种日志保留的已切换文件个数,更旧的文件在后台删除, 0表示不删除
+    std::string logCompress;    //已切换的日志文件在后台压缩: "gzip"、"zstd"(需要zstd命令)或空串表示不压缩
+    bool logMmap = false;       //日志文件末尾按块映射到内存后追加,代替writev
+
+    /* IO后端 */
+    bool useUring = false;  //使用io_uring代替epoll,内核不支持时自动回退到epoll
+
+    /* 定时器 */
+    bool useTimingWheel = false;    //使用分层时间轮代替小根堆管理连接超时
+    int wheelTickMs = 10;           //时间轮刻度(毫秒),即超时精度
+    bool lazyTimeout = false;       //连接有活动时只记录最后活跃时间,定时任务到期时再检查并按剩余时间重新添加
+
+    /* HTTP */
+    size_t maxHeaderSize = 8192;    //请求行+请求头的最大字节数,超过则返回400
+    size_t sendfileThreshold = 256 << 10;  //不小于该大小且未被缓存的文件用sendfile零拷贝发送, 0表示总是mmap
+    int compressLevel = 6;          //错误页、POST结果页等动态响应的gzip压缩级别1~9, 0表示不压缩
+    size_t compressMinSize = 1024;  //小于该长度的动态响应不压缩
+
+    /* 静态文件缓存 */
+    size_t fileCacheBytes = 64 << 20;     //缓存总字节数, 0表示关闭
+    size_t fileCacheMaxFile = 1 << 20;    //单个文件内容的缓存上限,更大的文件只缓存元数据,内容仍用mmap
+
+    /* 监控 */
+    std::string metricsPath;    //在主端口的该路径(如"/metrics")上以Prometheus文本格式输出运行指标,空串表示关闭
+};
+
+#endif //CONFIG_H
@@ -0,0 +1,62 @@
+#include "deflater.h"
+
+using namespace std;
+
+int Deflater::level = 6;
+size_t Deflater::minSize = 1024;
+
+Deflater::Deflater() {
+    strm_ = {};
+    ready_ = false;
+    level_ = 0;
+}
+
+Deflater::~Deflater() {
+    if (ready_) { deflateEnd(&strm_); }
+}
+
+/**
+ * @return 当前线程的压缩器
+ */
+Deflater *Deflater::Local() {
+    static thread_local Deflater deflater;
+    return &deflater;
+}
+
+/**
+ * 按当前level初始化z_stream, windowBits为15+16表示输出gzip格式
+ * @return
+ */
+bool Deflater::Reinit_() {
+    if (ready_) { deflateEnd(&strm_); }
+    strm_ = {};
+    ready_ = deflateInit2(&strm_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    level_ = level;
+    return ready_;
+}
+
+/**
+ * @param data
+ * @param len
+ * @return
+ */
+string_view Deflater::Compress(const char *data, size_t len) {
+    if (level <= 0) { return string_view(); }
+    if (!ready_ || level_ != level) {
+        if (!Reinit_()) { return string_view(); }
+    } else if (deflateReset(&strm_) != Z_OK) {
+        return string_view();
+    }
+
+    size_t bound = deflateBound(&strm_, len);
+    if (out_.size() < bound) { out_.resize(bound); }
+    strm_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    strm_.avail_in = len;
+    strm_.next_out = reinterpret_cast<Bytef *>(&out_[0]);
+    strm_.avail_out = out_.size();
+    if (deflate(&strm_, Z_FINISH) != Z_STREAM_END) { return string_view(); }
+
+    size_t outLen = out_.size() - strm_.avail_out;
+    if (outLen >= len) { return string_view(); }
+    return string_view(out_.data(), outLen);
+}
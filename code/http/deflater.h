@@ -0,0 +1,38 @@
+#ifndef DEFLATER_H
+#define DEFLATER_H
+
+#include <zlib.h>
+#include <string>
+#include <string_view>
+
+//gzip压缩器,用于运行时生成的响应体(错误页、POST结果页)
+//每个线程一个实例,z_stream在多次压缩之间用deflateReset复用,输出缓冲区也保留容量,
+//压缩一个响应不再分配zlib状态
+class Deflater {
+public:
+    static Deflater *Local();
+
+    /**
+     * @param data 原始数据
+     * @param len 数据长度
+     * @return gzip格式的压缩结果,在本线程下一次Compress前有效;出错或压缩后没有变小时返回空
+     */
+    std::string_view Compress(const char *data, size_t len);
+
+    static int level;       //压缩级别1~9, 0表示不压缩
+    static size_t minSize;  //小于该长度的响应体不压缩
+
+private:
+    Deflater();
+
+    ~Deflater();
+
+    bool Reinit_();
+
+    z_stream strm_;
+    bool ready_;
+    int level_;         //当前z_stream使用的级别,与level不同时重新初始化
+    std::string out_;
+};
+
+#endif //DEFLATER_H
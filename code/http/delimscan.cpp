@@ -0,0 +1,130 @@
+#include "delimscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DELIM_SCAN_X86 1
+#endif
+
+/**
+ * 从data[begin]开始逐字节扫描,结果追加到out[n]之后
+ * @return 追加后out中的总个数
+ */
+static size_t ScanFrom(const char *data, size_t begin, size_t len, uint32_t *out, size_t n, size_t cap,
+                       size_t *scanned) {
+    for (size_t i = begin; i < len; i++) {
+        if (data[i] == '\n' || data[i] == ':') {
+            if (n == cap) {
+                *scanned = i;
+                return n;
+            }
+            out[n++] = static_cast<uint32_t>(i);
+        }
+    }
+    *scanned = len;
+    return n;
+}
+
+/**
+ * 把一个块的匹配位掩码展开为偏移
+ * @return out写满时返回false,并把scanned设为第一个未记录的位置
+ */
+static inline bool EmitMask(uint32_t mask, size_t base, uint32_t *out, size_t &n, size_t cap, size_t *scanned) {
+    while (mask) {
+        size_t pos = base + __builtin_ctz(mask);
+        if (n == cap) {
+            *scanned = pos;
+            return false;
+        }
+        out[n++] = static_cast<uint32_t>(pos);
+        mask &= mask - 1;
+    }
+    return true;
+}
+
+/**
+ * 标量实现,所有平台可用
+ */
+size_t DelimScanner::ScanScalar(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned) {
+    return ScanFrom(data, 0, len, out, 0, cap, scanned);
+}
+
+#ifdef DELIM_SCAN_X86
+
+/**
+ * SSE4.2实现,PCMPESTRM一次比较16字节与{'\n', ':'}字符集
+ */
+__attribute__((target("sse4.2")))
+size_t DelimScanner::ScanSse42_(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned) {
+    const __m128i set = _mm_setr_epi8('\n', ':', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    size_t i = 0, n = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i match = _mm_cmpestrm(set, 2, block, 16,
+                                     _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK);
+        uint32_t mask = static_cast<uint32_t>(_mm_cvtsi128_si32(match)) & 0xffff;
+        if (!EmitMask(mask, i, out, n, cap, scanned)) { return n; }
+    }
+    return ScanFrom(data, i, len, out, n, cap, scanned);
+}
+
+/**
+ * AVX2实现,一次比较32字节
+ */
+__attribute__((target("avx2")))
+size_t DelimScanner::ScanAvx2_(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned) {
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i colon = _mm256_set1_epi8(':');
+    size_t i = 0, n = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i match = _mm256_or_si256(_mm256_cmpeq_epi8(block, lf), _mm256_cmpeq_epi8(block, colon));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+        if (!EmitMask(mask, i, out, n, cap, scanned)) { return n; }
+    }
+    return ScanFrom(data, i, len, out, n, cap, scanned);
+}
+
+/**
+ * 按CPUID选择实现
+ */
+DelimScanner::ScanFunc DelimScanner::Select_() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) { return ScanAvx2_; }
+    if (__builtin_cpu_supports("sse4.2")) { return ScanSse42_; }
+    return ScanScalar;
+}
+
+#else
+
+size_t DelimScanner::ScanSse42_(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned) {
+    return ScanScalar(data, len, out, cap, scanned);
+}
+
+size_t DelimScanner::ScanAvx2_(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned) {
+    return ScanScalar(data, len, out, cap, scanned);
+}
+
+DelimScanner::ScanFunc DelimScanner::Select_() {
+    return ScanScalar;
+}
+
+#endif
+
+/**
+ * 扫描入口,使用运行时选定的实现
+ */
+size_t DelimScanner::Scan(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned) {
+    static const ScanFunc func = Select_();
+    return func(data, len, out, cap, scanned);
+}
+
+/**
+ * 当前使用的实现名称
+ * @return
+ */
+const char *DelimScanner::Name() {
+    static const ScanFunc func = Select_();
+    if (func == ScanAvx2_) { return "avx2"; }
+    if (func == ScanSse42_) { return "sse4.2"; }
+    return "scalar";
+}
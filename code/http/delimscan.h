@@ -0,0 +1,36 @@
+#ifndef DELIM_SCAN_H
+#define DELIM_SCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//请求头分隔符扫描
+//一次扫描找出一块数据中所有'\n'和':'的位置,供HttpRequest按行切分请求头、定位冒号
+//按CPU能力在运行时选择AVX2 / SSE4.2 / 标量实现,选择结果在第一次调用时确定
+class DelimScanner {
+public:
+    /**
+     * @param data 待扫描数据
+     * @param len 数据长度
+     * @param out 输出分隔符相对data的偏移,按出现顺序
+     * @param cap out的容量
+     * @param scanned 输出实际扫描过的字节数;out写满时停在下一个未记录的分隔符处,下次从这里继续
+     * @return 写入out的个数
+     */
+    static size_t Scan(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned);
+
+    static size_t ScanScalar(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned);
+
+    static const char *Name();
+
+private:
+    typedef size_t (*ScanFunc)(const char *, size_t, uint32_t *, size_t, size_t *);
+
+    static size_t ScanSse42_(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned);
+
+    static size_t ScanAvx2_(const char *data, size_t len, uint32_t *out, size_t cap, size_t *scanned);
+
+    static ScanFunc Select_();
+};
+
+#endif //DELIM_SCAN_H
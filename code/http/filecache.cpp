@@ -0,0 +1,389 @@
+#include "filecache.h"
+#include "httpresponse.h"
+#include <errno.h>
+#include <string.h>
+
+using namespace std;
+
+const FileCache::Sidecar FileCache::SIDECARS[FileCache::SIDECAR_NUM] = {
+        {".br",  "br"},
+        {".zst", "zstd"},
+        {".gz",  "gzip"},
+};
+
+/**
+ * 探测文件的预压缩版本;比原文件旧的视为过期,不使用
+ * @param path 原文件路径
+ * @param st 原文件的stat结果
+ * @return 第i位表示SIDECARS[i]可用
+ */
+uint8_t FileCache::ProbeSidecars(const string &path, const struct stat &st) {
+    uint8_t mask = 0;
+    for (int i = 0; i < SIDECAR_NUM; i++) {
+        /* 预压缩文件本身不再探测 */
+        size_t extLen = strlen(SIDECARS[i].ext);
+        if (path.size() > extLen && path.compare(path.size() - extLen, extLen, SIDECARS[i].ext) == 0) { return 0; }
+    }
+    for (int i = 0; i < SIDECAR_NUM; i++) {
+        struct stat side;
+        if (stat((path + SIDECARS[i].ext).data(), &side) == 0 && S_ISREG(side.st_mode) &&
+            (side.st_mode & S_IROTH) && side.st_mtime >= st.st_mtime) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+FileCache::FileCache() {
+    capacity_ = 0;
+    maxFileSize_ = 0;
+    invalidSeq_ = 0;
+    inotifyFd_ = -1;
+    stopFd_ = -1;
+}
+
+FileCache::~FileCache() {
+    if (watchThread_ && watchThread_->joinable()) {
+        uint64_t one = 1;
+        ssize_t ret = write(stopFd_, &one, sizeof(one));   //通知监听线程退出
+        (void) ret;
+        watchThread_->join();
+    }
+    if (inotifyFd_ >= 0) { close(inotifyFd_); }
+    if (stopFd_ >= 0) { close(stopFd_); }
+}
+
+/**
+ * @brief 单例模式的实现
+ * @return
+ */
+FileCache *FileCache::Instance() {
+    static FileCache cache;
+    return &cache;
+}
+
+/**
+ * 设置容量并启动inotify监听线程;重复调用只更新容量,并清空已有条目
+ * @param capacity
+ * @param maxFileSize
+ */
+void FileCache::Init(size_t capacity, size_t maxFileSize) {
+    Clear();
+    maxFileSize_ = maxFileSize;
+    capacity_ = capacity;
+    if (capacity_ == 0 || watchThread_) { return; }
+
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd_ < 0 || stopFd_ < 0) {
+        /* 无法感知文件变化时宁可不缓存,也不返回过期内容 */
+        capacity_ = 0;
+        return;
+    }
+    watchThread_.reset(new thread(&FileCache::WatchLoop_, this));
+}
+
+/**
+ * @param path
+ * @return
+ */
+FileCache::Shard &FileCache::Shard_(const string &path) {
+    return shards_[hash<string>()(path) % SHARD_NUM];
+}
+
+/**
+ * @param path
+ * @return
+ */
+shared_ptr<const FileCache::Entry> FileCache::Get(const string &rawPath) {
+    if (capacity_ == 0) { return nullptr; }
+    string path = Normalize_(rawPath);
+    Shard &shard = Shard_(path);
+    {
+        lock_guard <mutex> locker(shard.mtx);
+        auto it = shard.index.find(path);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return *it->second;
+        }
+    }
+    return Load_(path);
+}
+
+/**
+ * 读取文件并尝试加入缓存;超过分片容量或目录无法监听的条目只返回给本次请求使用
+ * @param path 已规范化的路径
+ * @return
+ */
+shared_ptr<const FileCache::Entry> FileCache::Load_(const string &path) {
+    uint64_t seq = invalidSeq_.load();
+    int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { return nullptr; }
+    shared_ptr<Entry> entry = make_shared<Entry>();
+    if (fstat(fd, &entry->st) < 0 || !Servable_(entry->st)) {
+        close(fd);
+        return nullptr;
+    }
+    //文件确实存在才监听其目录;先监听再读取,读取之后的修改一定能收到通知,监听之前的修改由再次fstat看到
+    bool cacheable = Watch_(path);
+    if (fstat(fd, &entry->st) < 0 || !Servable_(entry->st)) {
+        close(fd);
+        return nullptr;
+    }
+    size_t size = entry->st.st_size;
+    if (size <= maxFileSize_) {
+        entry->body.resize(size);
+        size_t done = 0;
+        while (done < size) {
+            ssize_t len = pread(fd, &entry->body[done], size - done, done);
+            if (len <= 0) { break; }
+            done += len;
+        }
+        if (done != size) {
+            /* 读取期间文件被截断 */
+            close(fd);
+            return nullptr;
+        }
+    }
+    close(fd);
+
+    entry->path = path;
+    entry->sidecars = ProbeSidecars(path, entry->st);
+    entry->mime = HttpResponse::FileType(path);
+    entry->etag = HttpResponse::ETag(entry->st);
+    entry->lastModified = HttpResponse::HttpDate(entry->st.st_mtime);
+    entry->header = "Content-type: " + entry->mime + "\r\n";
+    entry->header += "Content-length: " + to_string(size) + "\r\n\r\n";
+
+    if (cacheable) { Insert_(Shard_(path), entry, seq); }
+    return entry;
+}
+
+/**
+ * @param shard
+ * @param entry
+ * @param seq 开始加载时的失效序号,期间有失效发生时不加入缓存
+ */
+void FileCache::Insert_(Shard &shard, const shared_ptr<const Entry> &entry, uint64_t seq) {
+    size_t charge = Charge_(*entry);
+    size_t budget = capacity_ / SHARD_NUM;
+    if (charge > budget) { return; }
+
+    lock_guard <mutex> locker(shard.mtx);
+    if (seq != invalidSeq_.load()) { return; }
+    Erase_(shard, entry->path);
+    shard.lru.push_front(entry);
+    shard.index[entry->path] = shard.lru.begin();
+    shard.bytes += charge;
+    while (shard.bytes > budget) {
+        Erase_(shard, shard.lru.back()->path);
+    }
+}
+
+/**
+ * 调用者需持有shard.mtx
+ * @param shard
+ * @param path
+ */
+void FileCache::Erase_(Shard &shard, const string &path) {
+    auto it = shard.index.find(path);
+    if (it == shard.index.end()) { return; }
+    shard.bytes -= Charge_(**it->second);
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+}
+
+/**
+ * @param path
+ */
+void FileCache::Invalidate(const string &rawPath) {
+    string path = Normalize_(rawPath);
+    Shard &shard = Shard_(path);
+    lock_guard <mutex> locker(shard.mtx);
+    invalidSeq_++;
+    Erase_(shard, path);
+}
+
+/**
+ * 使某个目录下的所有条目失效
+ * @param prefix 以'/'结尾的目录
+ */
+void FileCache::InvalidatePrefix_(const string &prefix) {
+    for (Shard &shard : shards_) {
+        lock_guard <mutex> locker(shard.mtx);
+        invalidSeq_++;
+        for (auto it = shard.lru.begin(); it != shard.lru.end();) {
+            const string &path = (*it++)->path;
+            if (path.compare(0, prefix.size(), prefix) == 0) {
+                Erase_(shard, path);
+            }
+        }
+    }
+}
+
+/**
+ *
+ */
+void FileCache::Clear() {
+    for (Shard &shard : shards_) {
+        lock_guard <mutex> locker(shard.mtx);
+        invalidSeq_++;
+        shard.lru.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+/**
+ * @return 当前缓存占用的字节数
+ */
+size_t FileCache::Bytes() {
+    size_t bytes = 0;
+    for (Shard &shard : shards_) {
+        lock_guard <mutex> locker(shard.mtx);
+        bytes += shard.bytes;
+    }
+    return bytes;
+}
+
+/**
+ * @return 当前缓存的文件数
+ */
+size_t FileCache::Count() {
+    size_t count = 0;
+    for (Shard &shard : shards_) {
+        lock_guard <mutex> locker(shard.mtx);
+        count += shard.lru.size();
+    }
+    return count;
+}
+
+/**
+ * @return 当前监听的目录数
+ */
+size_t FileCache::WatchCount() {
+    lock_guard <mutex> locker(watchMtx_);
+    return wdDirs_.size();
+}
+
+/**
+ * 监听文件所在目录,每个目录只注册一次
+ * 内核按目录的inode去重,同一目录以另一种写法(如经符号链接)再次注册时返回已有的wd;
+ * 事件只按先登记的写法使条目失效,因此这种写法下的文件不缓存,wd也不再登记第二个写法
+ * @param path
+ * @return 该路径下的文件能否缓存
+ */
+bool FileCache::Watch_(const string &path) {
+    string::size_type idx = path.find_last_of('/');
+    string dir = (idx == string::npos) ? "." : path.substr(0, idx);
+    lock_guard <mutex> locker(watchMtx_);
+    if (watchedDirs_.count(dir)) { return true; }
+    int wd = inotify_add_watch(inotifyFd_, dir.empty() ? "/" : dir.data(),
+                               IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                               IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd < 0 || wdDirs_.count(wd)) { return false; }
+    watchedDirs_[dir] = wd;
+    wdDirs_[wd] = dir;
+    return true;
+}
+
+/**
+ * inotify监听线程,收到事件后使对应文件失效
+ */
+void FileCache::WatchLoop_() {
+    alignas(struct inotify_event) char buf[4096];
+    struct pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+        if (fds[1].revents) { break; }
+        ssize_t len = read(inotifyFd_, buf, sizeof(buf));
+        if (len <= 0) { continue; }
+
+        for (char *ptr = buf; ptr < buf + len;) {
+            struct inotify_event *event = reinterpret_cast<struct inotify_event *>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                /* 事件丢失,无法确定哪些文件变了 */
+                Clear();
+                continue;
+            }
+            string dir;
+            {
+                lock_guard <mutex> locker(watchMtx_);
+                auto it = wdDirs_.find(event->wd);
+                if (it == wdDirs_.end()) { continue; }
+                dir = it->second;
+                if (event->mask & IN_IGNORED) {
+                    /* 目录被删除或移走,监听已被内核移除 */
+                    watchedDirs_.erase(dir);
+                    wdDirs_.erase(it);
+                }
+            }
+            if (event->len > 0) {
+                string path = dir + "/" + event->name;
+                Invalidate(path);
+                for (const Sidecar &side : SIDECARS) {
+                    size_t extLen = strlen(side.ext);
+                    if (path.size() > extLen && path.compare(path.size() - extLen, extLen, side.ext) == 0) {
+                        Invalidate(path.substr(0, path.size() - extLen));
+                    }
+                }
+            } else {
+                InvalidatePrefix_(dir + "/");
+            }
+        }
+    }
+}
+
+/**
+ * @param entry
+ * @return 条目计入容量的字节数
+ */
+size_t FileCache::Charge_(const Entry &entry) {
+    return sizeof(Entry) + entry.path.size() + entry.mime.size() + entry.etag.size() + entry.lastModified.size() +
+           entry.header.size() + entry.body.size();
+}
+
+/**
+ * @param st
+ * @return 是否为其他用户可读的普通文件
+ */
+bool FileCache::Servable_(const struct stat &st) {
+    return S_ISREG(st.st_mode) && (st.st_mode & S_IROTH);
+}
+
+/**
+ * 合并重复的'/',去掉"."段并按".."回退一段,如"res//./a/../b.html"变为"res/b.html"
+ * 与nginx处理URI相同,".."按字面回退,不先解析符号链接;绝对路径在根目录上的".."仍为根目录
+ * @param path
+ * @return
+ */
+string FileCache::Normalize_(const string &path) {
+    bool absolute = !path.empty() && path[0] == '/';
+    string out;
+    out.reserve(path.size());
+    for (size_t i = 0; i < path.size();) {
+        size_t end = path.find('/', i);
+        if (end == string::npos) { end = path.size(); }
+        size_t len = end - i;
+        if (len == 2 && path[i] == '.' && path[i + 1] == '.') {
+            size_t slash = out.find_last_of('/');
+            size_t last = (slash == string::npos) ? 0 : slash + 1;
+            if (last < out.size() && out.compare(last, string::npos, "..") != 0) {
+                out.erase(slash == string::npos ? 0 : slash);
+            } else if (!absolute) {
+                out += out.empty() ? ".." : "/..";
+            }
+        } else if (len > 0 && !(len == 1 && path[i] == '.')) {
+            if (absolute || !out.empty()) { out += '/'; }
+            out.append(path, i, len);
+        }
+        i = end + 1;
+    }
+    if (out.empty()) { return absolute ? "/" : "."; }
+    if (path.back() == '/') { out += '/'; }
+    return out;
+}
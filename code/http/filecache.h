@@ -0,0 +1,128 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <sys/stat.h>      // stat
+#include <sys/inotify.h>   // inotify_init1
+#include <sys/eventfd.h>   // eventfd
+#include <poll.h>          // poll
+#include <fcntl.h>         // open
+#include <unistd.h>        // read, close
+#include <string>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
+//静态文件缓存,所有连接共享
+//以文件完整路径为键,缓存stat结果、MIME类型、ETag/Last-Modified、预先拼好的Content-type/Content-length头,
+//以及不超过maxFileSize的文件内容(拷贝到内存,避免文件被截断时访问映射触发SIGBUS)
+//路径先合并重复的'/'并去掉"."段,同一文件的不同写法共用一个条目
+//按路径哈希分为SHARD_NUM个分片,各分片独立加锁并按LRU淘汰,总内存不超过capacity
+//后台线程用inotify监听已缓存文件所在目录,文件修改、删除、改名或权限变化时使对应条目失效
+//预压缩文件变化时同时使原文件的条目失效,以便重新探测
+class FileCache {
+public:
+    struct Entry {
+        std::string path;
+        struct stat st;
+        std::string mime;
+        std::string etag;          //由inode/大小/修改时间生成的强ETag
+        std::string lastModified;  //HTTP-date格式的修改时间
+        std::string header;   //"Content-type: ...\r\nContent-length: ...\r\n\r\n"
+        std::string body;     //文件内容,文件过大时为空,由调用者自行映射
+        uint8_t sidecars;     //存在且不旧于本文件的预压缩文件,第i位对应SIDECARS[i]
+
+        bool HasBody() const { return body.size() == static_cast<size_t>(st.st_size); }
+    };
+
+    //预压缩的旁路文件,如style.css对应style.css.br/style.css.zst/style.css.gz,按优先级排列
+    struct Sidecar {
+        const char *ext;
+        const char *encoding;   //Content-Encoding中的名称
+    };
+
+    static const int SIDECAR_NUM = 3;
+    static const Sidecar SIDECARS[SIDECAR_NUM];
+
+    static uint8_t ProbeSidecars(const std::string &path, const struct stat &st);
+
+    static FileCache *Instance();
+
+    /**
+     * @param capacity 缓存总字节数上限, 0表示关闭缓存
+     * @param maxFileSize 单个文件内容的缓存上限,超过时只缓存元数据
+     */
+    void Init(size_t capacity, size_t maxFileSize = 1 << 20);
+
+    /**
+     * 查找文件,未命中时读取并加入缓存
+     * @param path 文件完整路径
+     * @return 文件不存在、是目录或其他用户不可读时返回nullptr,调用者按原流程处理
+     */
+    std::shared_ptr<const Entry> Get(const std::string &path);
+
+    void Invalidate(const std::string &path);
+
+    void Clear();
+
+    bool IsOpen() const { return capacity_ > 0; }
+
+    size_t Bytes();
+
+    size_t Count();
+
+    size_t WatchCount();
+
+private:
+    FileCache();
+
+    ~FileCache();
+
+    struct Shard {
+        std::mutex mtx;
+        std::list <std::shared_ptr<const Entry>> lru;   //表头为最近使用
+        std::unordered_map <std::string, std::list<std::shared_ptr<const Entry>>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    Shard &Shard_(const std::string &path);
+
+    std::shared_ptr<const Entry> Load_(const std::string &path);
+
+    void Insert_(Shard &shard, const std::shared_ptr<const Entry> &entry, uint64_t seq);
+
+    void Erase_(Shard &shard, const std::string &path);
+
+    void InvalidatePrefix_(const std::string &prefix);
+
+    bool Watch_(const std::string &path);
+
+    void WatchLoop_();
+
+    static size_t Charge_(const Entry &entry);
+
+    static bool Servable_(const struct stat &st);
+
+    static std::string Normalize_(const std::string &path);
+
+    static const int SHARD_NUM = 16;
+
+    size_t capacity_;
+    size_t maxFileSize_;
+    Shard shards_[SHARD_NUM];
+
+    //每次失效加一;加载前后比较,防止加载期间发生的修改被旧内容覆盖
+    std::atomic<uint64_t> invalidSeq_;
+
+    int inotifyFd_;
+    int stopFd_;
+    std::unique_ptr <std::thread> watchThread_;
+    std::mutex watchMtx_;
+    std::unordered_map<std::string, int> watchedDirs_;   //目录 -> wd
+    std::unordered_map<int, std::string> wdDirs_;        //每个wd只登记一种写法
+};
+
+#endif //FILE_CACHE_H
@@ -4,6 +4,7 @@ using namespace std;
 
 const char *HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
+std::string HttpConn::metricsPath;
 bool HttpConn::isET;
 
 /**
@@ -13,6 +14,17 @@ HttpConn::HttpConn() {
     fd_ = -1;
     addr_ = {0};
     isClose_ = true;
+    keepAlive_ = false;
+    iovCnt_ = iovIdx_ = 0;
+    toWrite_ = 0;
+    sendFd_ = -1;
+    sendOff_ = 0;
+    sendLeft_ = 0;
+    respCnt_ = 0;
+    gen_ = 0;
+    lastActive_ = 0;
+    accessCnt_ = 0;
+    readNs_ = firstByteNs_ = 0;
 };
 
 /**
@@ -30,11 +42,21 @@ HttpConn::~HttpConn() {
 void HttpConn::init(int fd, const sockaddr_in &addr) {
     assert(fd > 0);
     userCount++;
+    Metrics::CountAccept();
     addr_ = addr;
     fd_ = fd;
     writeBuff_.RetrieveAll();
     readBuff_.RetrieveAll();
+    request_.Init();
+    keepAlive_ = false;
+    iovCnt_ = iovIdx_ = 0;
+    toWrite_ = 0;
+    sendFd_ = -1;
+    sendLeft_ = 0;
+    respCnt_ = 0;
+    accessCnt_ = 0;
     isClose_ = false;
+    gen_.fetch_add(1, std::memory_order_release);
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int) userCount);
 }
 
@@ -42,9 +64,12 @@ void HttpConn::init(int fd, const sockaddr_in &addr) {
  *
  */
 void HttpConn::Close() {
-    response_.UnmapFile();
+    for (auto &resp : responses_) {
+        if (resp) { resp->UnmapFile(); }
+    }
     if (isClose_ == false) {
         isClose_ = true;
+        gen_.fetch_add(1, std::memory_order_release);
         userCount--;
         close(fd_);
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int) userCount);
@@ -89,73 +114,219 @@ int HttpConn::GetPort() const {
  * @return
  */
 ssize_t HttpConn::read(int *saveErrno) {
-    ssize_t len = -1;
-    do {
-        len = readBuff_.ReadFd(fd_, saveErrno);
-        if (len <= 0) {
-            break;
-        }
-    } while (isET);
-    return len;
+    return read(saveErrno, [](int fd, Buffer &buff, int *err) { return buff.ReadFd(fd, err); });
 }
 
 /**
- *
+ * 先把一批响应的所有iov用writev发出,再用sendfile发送最后一个响应的大文件,部分发送时从断点继续
+ * 后面还有sendfile数据时带MSG_MORE,让响应头与文件开头合并成满的报文段
  * @param saveErrno
  * @return
  */
 ssize_t HttpConn::write(int *saveErrno) {
-    ssize_t len = -1;
-    do {
-        len = writev(fd_, iov_, iovCnt_);
-        if (len <= 0) {
-            *saveErrno = errno;
-            break;
+    return write(saveErrno, [](int fd, const struct iovec *iov, int iovCnt, bool more, int *err) {
+        ssize_t len;
+        if (more) {
+            struct msghdr msg = {};
+            msg.msg_iov = const_cast<struct iovec *>(iov);
+            msg.msg_iovlen = iovCnt;
+            len = sendmsg(fd, &msg, MSG_MORE);
+        } else {
+            len = writev(fd, iov, iovCnt);
         }
-        if (iov_[0].iov_len + iov_[1].iov_len == 0) { break; } /* 传输结束 */
-        else if (static_cast<size_t>(len) > iov_[0].iov_len) {
-            iov_[1].iov_base = (uint8_t *) iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if (iov_[0].iov_len) {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
-            }
+        if (len < 0) { *err = errno; }
+        return len;
+    });
+}
+
+/**
+ * 按已发送的字节数推进断点
+ * @param len
+ */
+void HttpConn::AdvanceIov_(ssize_t len) {
+    size_t n = len > 0 ? len : 0;
+    while (n > 0) {
+        struct iovec &iov = iov_[iovIdx_];
+        if (n >= iov.iov_len) {
+            n -= iov.iov_len;
+            iov.iov_len = 0;
+            iovIdx_++;
         } else {
-            iov_[0].iov_base = (uint8_t *) iov_[0].iov_base + len;
-            iov_[0].iov_len -= len;
-            writeBuff_.Retrieve(len);
+            iov.iov_base = (uint8_t *) iov.iov_base + n;
+            iov.iov_len -= n;
+            n = 0;
         }
-    } while (isET || ToWriteBytes() > 10240);
+    }
+}
+
+/**
+ * 用sendfile发送最后一个响应的文件;文件被截断时sendfile返回0,按出错关闭连接
+ * @param saveErrno
+ * @return
+ */
+ssize_t HttpConn::SendFile_(int *saveErrno) {
+    ssize_t len = sendfile(fd_, sendFd_, &sendOff_, sendLeft_);
+    if (len > 0) {
+        sendLeft_ -= len;
+    } else if (len < 0) {
+        *saveErrno = errno;
+    }
     return len;
 }
 
 /**
- *
+ * 记录发出的字节数
+ * @param len
+ * @return 传输是否结束
+ */
+bool HttpConn::Sent_(size_t len) {
+    if (firstByteNs_ == 0 && accessCnt_ > 0) { firstByteNs_ = AccessLog::NowNs(); }
+    Metrics::CountBytesOut(len);
+    toWrite_ -= len;
+    if (toWrite_ == 0) { /* 传输结束 */
+        writeBuff_.RetrieveAll();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * 取第i个响应槽位,第一次使用时创建
+ * @param i
  * @return
  */
+HttpResponse &HttpConn::Response_(int i) {
+    if (!responses_[i]) {
+        responses_[i].reset(new HttpResponse());
+    }
+    return *responses_[i];
+}
+
+/**
+ * 记下刚生成响应的请求,字符串复制进复用的Entry,请求的string_view在下一次读之后失效
+ * @param response
+ * @param bytes 响应头与响应体的字节数
+ */
+void HttpConn::RecordAccess_(const HttpResponse &response, size_t bytes) {
+    if (accessCnt_ == static_cast<int>(access_.size())) {
+        access_.emplace_back();
+    }
+    AccessLog::Entry &entry = access_[accessCnt_++];
+    entry.method.assign(request_.method());
+    entry.target.assign(request_.target());
+    entry.version.assign(request_.version());
+    entry.referer.assign(request_.GetHeader("Referer"));
+    entry.userAgent.assign(request_.GetHeader("User-Agent"));
+    entry.status = response.Code();
+    entry.bytes = bytes;
+    entry.startNs = readNs_;
+}
+
+/**
+ * 一批响应发送完毕,逐个写访问日志
+ */
+void HttpConn::LogAccess() {
+    if (accessCnt_ == 0) { return; }
+    int64_t now = AccessLog::NowNs();
+    for (int i = 0; i < accessCnt_; i++) {
+        AccessLog::Write(addr_, access_[i], firstByteNs_, now);
+    }
+    accessCnt_ = 0;
+}
+
+/**
+ * 追加一段待发送数据,与上一段在内存中相邻时直接合并
+ * @param base
+ * @param len
+ */
+void HttpConn::AppendIov_(const char *base, size_t len) {
+    if (len == 0) { return; }
+    toWrite_ += len;
+    if (iovCnt_ > 0) {
+        struct iovec &last = iov_[iovCnt_ - 1];
+        if ((const char *) last.iov_base + last.iov_len == base) {
+            last.iov_len += len;
+            return;
+        }
+    }
+    assert(iovCnt_ < 2 * MAX_PIPELINE);
+    iov_[iovCnt_].iov_base = const_cast<char *>(base);
+    iov_[iovCnt_].iov_len = len;
+    iovCnt_++;
+}
+
+/**
+ * 处理读缓冲区中所有完整的请求(HTTP/1.1流水线),响应按顺序合并为一批,由write()一次writev发出
+ * 遇到不完整的请求、不保持连接的请求或达到MAX_PIPELINE时停止,剩余数据留到本批发送完后再处理
+ * @return 是否有响应需要发送
+ */
 bool HttpConn::process() {
-    request_.Init();
-    if (readBuff_.ReadableBytes() <= 0) {
+    /* writeBuff_在循环中可能扩容,先只记录每个响应头的结束位置,循环结束后再生成iov */
+    size_t headEnd[MAX_PIPELINE];
+    for (int i = 0; i < respCnt_; i++) {
+        responses_[i]->UnmapFile();  /* 上一批已发送完毕 */
+    }
+    respCnt_ = 0;
+    accessCnt_ = 0;
+    firstByteNs_ = 0;
+    while (respCnt_ < MAX_PIPELINE && readBuff_.ReadableBytes() > 0) {
+        HttpRequest::HTTP_CODE ret = request_.parse(readBuff_);
+        if (ret == HttpRequest::NO_REQUEST) {
+            /* 报文不完整,继续读,下次从断点接着解析 */
+            break;
+        }
+        HttpResponse &response = Response_(respCnt_);
+        if (ret == HttpRequest::GET_REQUEST) {
+            LOG_DEBUG("%s", request_.path().c_str());
+            keepAlive_ = request_.IsKeepAlive();
+            response.Init(srcDir, request_.path(), keepAlive_, 200, &request_);
+        } else {
+            keepAlive_ = false;
+            response.Init(srcDir, request_.path(), false, 400);
+        }
+        size_t respBegin = writeBuff_.ReadableBytes();
+        if (ret == HttpRequest::GET_REQUEST && !metricsPath.empty() && request_.method() == "GET" &&
+            request_.path() == metricsPath) {
+            response.MakeGenerated(writeBuff_, Metrics::CONTENT_TYPE, Metrics::Render());
+        } else {
+            response.MakeResponse(writeBuff_);
+        }
+        headEnd[respCnt_++] = writeBuff_.ReadableBytes();
+        Metrics::CountRequest(response.Code());
+        if (AccessLog::IsOpen() && AccessLog::Sample()) {
+            RecordAccess_(response, writeBuff_.ReadableBytes() - respBegin + response.FileLen());
+        }
+        if (!keepAlive_ || response.FileFd() >= 0) {
+            /* 连接将在本批发送完后关闭,后面的请求不再处理;
+               sendfile只能放在一批的最后,之后的请求等它发送完再处理 */
+            break;
+        }
+    }
+    if (respCnt_ == 0) {
         return false;
-    } else if (request_.parse(readBuff_)) {
-        LOG_DEBUG("%s", request_.path().c_str());
-        response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
-    } else {
-        response_.Init(srcDir, request_.path(), false, 400);
     }
 
-    response_.MakeResponse(writeBuff_);
-    /* 响应头 */
-    iov_[0].iov_base = const_cast<char *>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
-
-    /* 文件 */
-    if (response_.FileLen() > 0 && response_.File()) {
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
+    iovCnt_ = iovIdx_ = 0;
+    toWrite_ = 0;
+    sendFd_ = -1;
+    sendOff_ = 0;
+    sendLeft_ = 0;
+    size_t headBegin = 0;
+    for (int i = 0; i < respCnt_; i++) {
+        /* 响应头 */
+        AppendIov_(writeBuff_.Peek() + headBegin, headEnd[i] - headBegin);
+        headBegin = headEnd[i];
+        /* 文件 */
+        HttpResponse &response = *responses_[i];
+        if (response.FileLen() > 0 && response.File()) {
+            AppendIov_(response.File(), response.FileLen());
+        } else if (response.FileFd() >= 0) {
+            sendFd_ = response.FileFd();
+            sendOff_ = response.FileOffset();
+            sendLeft_ = response.FileLen();
+            toWrite_ += sendLeft_;
+        }
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen(), iovCnt_, ToWriteBytes());
+    LOG_DEBUG("responses:%d, iov:%d, to %d", respCnt_, iovCnt_, (int) toWrite_);
     return true;
 }
@@ -3,17 +3,24 @@
 
 #include <sys/types.h>
 #include <sys/uio.h>     // readv/writev
+#include <sys/sendfile.h> // sendfile
+#include <sys/socket.h>   // sendmsg
 #include <arpa/inet.h>   // sockaddr_in
 #include <stdlib.h>      // atoi()
 #include <errno.h>
+#include <memory>
+#include <atomic>
 
 #include "../log/log.h"
+#include "../log/accesslog.h"
 #include "../pool/sqlconnRAII.h"
 #include "../buffer/buffer.h"
+#include "../metrics/metrics.h"
 #include "httprequest.h"
 #include "httpresponse.h"
 
-class HttpConn {
+//按缓存行对齐,连接表中相邻fd的连接不会共享缓存行
+class alignas(64) HttpConn {
 public:
     HttpConn();
 
@@ -23,8 +30,47 @@ public:
 
     ssize_t read(int *saveErrno);
 
+    /**
+     * 用recv(fd, readBuff_, saveErrno)读取数据,如Poller::Recv;边沿触发时一直读到没有数据
+     */
+    template<class Recv>
+    ssize_t read(int *saveErrno, Recv &&recv) {
+        ssize_t len = -1;
+        do {
+            len = recv(fd_, readBuff_, saveErrno);
+            if (len <= 0) {
+                break;
+            }
+            if (AccessLog::IsOpen()) { readNs_ = AccessLog::NowNs(); }
+        } while (isET);
+        return len;
+    }
+
     ssize_t write(int *saveErrno);
 
+    /**
+     * 用send(fd, iov, iovCnt, more, saveErrno)发送一批响应的iov,如Poller::Send;之后的文件仍用sendfile发送
+     * send返回-1且为EAGAIN时iov原样保留,下次以同样的iov再调用
+     */
+    template<class Send>
+    ssize_t write(int *saveErrno, Send &&send) {
+        ssize_t len = -1;
+        do {
+            if (iovIdx_ < iovCnt_) {
+                len = send(fd_, iov_ + iovIdx_, iovCnt_ - iovIdx_, sendLeft_ > 0, saveErrno);
+                AdvanceIov_(len);
+            } else {
+                len = SendFile_(saveErrno);
+            }
+            if (len <= 0) {
+                if (len == 0) { *saveErrno = 0; }
+                break;
+            }
+            if (Sent_(len)) { break; }
+        } while (isET || ToWriteBytes() > 10240);
+        return len;
+    }
+
     void Close();
 
     int GetFd() const;
@@ -37,33 +83,84 @@ public:
 
     bool process();
 
-    int ToWriteBytes() {
-        return iov_[0].iov_len + iov_[1].iov_len;
+    /**
+     * 一批响应全部发送完毕后调用,为其中被抽样的请求各写一行访问日志
+     */
+    void LogAccess();
+
+    size_t ToWriteBytes() const {
+        return toWrite_;
     }
 
     bool IsKeepAlive() const {
-        return request_.IsKeepAlive();
+        return keepAlive_;
+    }
+
+    //最后活跃时间(Timer::CoarseMs),只由连接所属的事件循环线程读写
+    void Touch(int64_t nowMs) {
+        lastActive_ = nowMs;
+    }
+
+    int64_t LastActive() const {
+        return lastActive_;
+    }
+
+    //代数,init与Close时各加一;fd被复用后,旧连接的事件、任务与定时器可据此识别并丢弃
+    uint32_t GetGen() const {
+        return gen_.load(std::memory_order_acquire);
     }
 
     static bool isET;
     static const char *srcDir;
     static std::atomic<int> userCount;
+    static std::string metricsPath;   //在此路径上输出Metrics::Render(),空串表示关闭
 
 private:
+    HttpResponse &Response_(int i);
+
+    void RecordAccess_(const HttpResponse &response, size_t bytes);
+
+    void AppendIov_(const char *base, size_t len);
+
+    void AdvanceIov_(ssize_t len);
+
+    ssize_t SendFile_(int *saveErrno);
+
+    bool Sent_(size_t len);
+
+    /* 一次最多处理的流水线请求数,其响应合并为一批用一次writev发出 */
+    static const int MAX_PIPELINE = 16;
 
     int fd_;
     struct sockaddr_in addr_;
 
     bool isClose_;
+    std::atomic <uint32_t> gen_;
+    int64_t lastActive_;
+
+    bool keepAlive_;  // 本批最后一个请求是否保持连接
 
     int iovCnt_;
-    struct iovec iov_[2];
+    int iovIdx_;      // 第一个尚未发送完的iov
+    size_t toWrite_;
+    struct iovec iov_[2 * MAX_PIPELINE];   // 每个响应一段响应头+一段文件
+
+    int sendFd_;      // 本批最后一个响应的文件走sendfile时的fd,否则为-1
+    off_t sendOff_;
+    size_t sendLeft_;
 
     Buffer readBuff_; // 读缓冲区
     Buffer writeBuff_; // 写缓冲区
 
     HttpRequest request_;
-    HttpResponse response_;
+    std::unique_ptr <HttpResponse> responses_[MAX_PIPELINE];   // 按需创建,文件映射在下一批开始时释放
+    int respCnt_;
+
+    /* 访问日志,只在AccessLog打开时记录 */
+    std::vector <AccessLog::Entry> access_;    // 本批被抽样的请求,元素在多批之间复用
+    int accessCnt_;
+    int64_t readNs_;        // 最近一次读到数据的时刻
+    int64_t firstByteNs_;   // 本批发出第一个字节的时刻, 0表示还未发出
 };
 
 
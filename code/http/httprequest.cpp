@@ -10,70 +10,169 @@ const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG{
         {"/register.html", 0},
         {"/login.html",    1},};
 
+size_t HttpRequest::maxHeaderSize = 8192;
+
 /**
- *
+ * 忽略大小写比较两个字符串
+ */
+static bool EqualsNoCase(string_view a, string_view b) {
+    if (a.size() != b.size()) { return false; }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * 判断是否为HTTP token字符(RFC 7230 tchar)
+ */
+static bool IsTokenChar(char ch) {
+    if (isalnum(static_cast<unsigned char>(ch))) { return true; }
+    switch (ch) {
+        case '!': case '#': case '$': case '%': case '&': case '\'': case '*': case '+':
+        case '-': case '.': case '^': case '_': case '`': case '|': case '~':
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * 重置解析状态,不释放path_等成员已申请的内存
  */
 void HttpRequest::Init() {
-    method_ = path_ = version_ = body_ = "";
     state_ = REQUEST_LINE;
-    header_.clear();
+    cursor_ = lineStart_ = 0;
+    lineColon_ = string::npos;
+    delimBase_ = delimCnt_ = delimIdx_ = 0;
+    contentLen_ = 0;
+    keepAlive_ = false;
+    base_ = nullptr;
+    method_ = target_ = version_ = Span{0, 0};
+    headerCnt_ = 0;
+    path_.clear();
+    body_.clear();
     post_.clear();
 }
 
 /**
- *
+ * 连接是否保持,在请求头解析完成时根据版本与Connection头确定
  * @return
  */
 bool HttpRequest::IsKeepAlive() const {
-    if (header_.count("Connection") == 1) {
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
-    }
-    return false;
+    return keepAlive_;
 }
 
 /**
- *
+ * 增量解析状态机,直接在Buffer的可读区上解析,不复制行也不构造正则
+ * 请求头部分先用DelimScanner(SIMD)一次性找出一段数据中所有'\n'和':'的位置,再按行处理;
+ * 报文不完整时返回NO_REQUEST并记住扫描位置,下次ReadFd之后从断点继续;
+ * 解析完成时返回GET_REQUEST并从Buffer中取走整个报文,此后method()/version()/GetHeader()
+ * 返回的string_view指向Buffer中的原始报文,在下一次向该Buffer写入之前有效
  * @param buff
- * @return
+ * @return NO_REQUEST 报文不完整, GET_REQUEST 解析完成, BAD_REQUEST 报文错误
  */
-bool HttpRequest::parse(Buffer &buff) {
-    const char CRLF[] = "\r\n";
-    if (buff.ReadableBytes() <= 0) {
-        return false;
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer &buff) {
+    if (state_ == FINISH) {
+        Init();
     }
-    while (buff.ReadableBytes() && state_ != FINISH) {
-        const char *lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        std::string line(buff.Peek(), lineEnd);
-        switch (state_) {
-            case REQUEST_LINE:
-                if (!ParseRequestLine_(line)) {
-                    return false;
-                }
-                ParsePath_();
-                break;
-            case HEADERS:
-                ParseHeader_(line);
-                if (buff.ReadableBytes() <= 2) {
-                    state_ = FINISH;
+    const char *begin = buff.Peek();
+    const size_t len = buff.ReadableBytes();
+    base_ = begin;   /* Buffer可能在两次调用之间移动,每次都以当前可读区为准 */
+    /* 请求行和请求头最多扫描到maxHeaderSize,之后的数据属于请求体或下一个请求 */
+    const size_t scanEnd = min(len, maxHeaderSize + 1);
+    while (state_ != FINISH) {
+        if (state_ == BODY) {
+            if (len - cursor_ < contentLen_) { return NO_REQUEST; }
+            ParseBody_(begin + cursor_, contentLen_);
+            cursor_ += contentLen_;
+            state_ = FINISH;
+            break;
+        }
+        if (delimIdx_ == delimCnt_) {
+            if (cursor_ >= scanEnd) {
+                if (len > maxHeaderSize) {
+                    LOG_WARN("Request header too large");
+                    keepAlive_ = false;
+                    return BAD_REQUEST;
                 }
-                break;
-            case BODY:
-                ParseBody_(line);
-                break;
-            default:
-                break;
+                return NO_REQUEST;
+            }
+            size_t scanned = 0;
+            delimBase_ = cursor_;
+            delimCnt_ = DelimScanner::Scan(begin + cursor_, scanEnd - cursor_, delims_, MAX_DELIMS, &scanned);
+            delimIdx_ = 0;
+            cursor_ += scanned;
+            continue;
+        }
+
+        size_t pos = delimBase_ + delims_[delimIdx_++];
+        if (begin[pos] == ':') {
+            if (lineColon_ == string::npos) { lineColon_ = pos; }
+            continue;
+        }
+        /* begin[pos] == '\n', 得到完整的一行 */
+        size_t lineOff = lineStart_;
+        size_t lineLen = pos - lineOff;
+        size_t colon = lineColon_;
+        if (lineLen > 0 && begin[lineOff + lineLen - 1] == '\r') { lineLen--; }
+        lineStart_ = pos + 1;
+        lineColon_ = string::npos;
+
+        bool ok = true;
+        if (state_ == REQUEST_LINE) {
+            if (lineLen == 0) { continue; }     /* 忽略请求行之前的空行 */
+            ok = ParseRequestLine_(begin, lineOff, lineLen);
+        } else if (lineLen == 0) {
+            ok = ParseHeadersEnd_(begin);
+            /* 请求头结束,剩余的分隔符属于请求体或下一个请求 */
+            cursor_ = lineStart_;
+            delimIdx_ = delimCnt_ = 0;
+        } else {
+            ok = ParseHeader_(begin, lineOff, lineLen, colon);
+        }
+        if (!ok) {
+            keepAlive_ = false;
+            return BAD_REQUEST;
         }
-        if (lineEnd == buff.BeginWrite()) { break; }
-        buff.RetrieveUntil(lineEnd + 2);
     }
-    LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
-    return true;
+    buff.Retrieve(cursor_);
+    LOG_DEBUG("[%.*s], [%s], [%.*s]", (int) method_.len, base_ + method_.off,
+              path_.c_str(), (int) version_.len, base_ + version_.off);
+    return GET_REQUEST;
 }
 
 /**
- *
+ * 去掉"."段和重复的'/',按".."回退一段,使同一文件只有一种写法;
+ * 越过资源根目录的路径(如"/../etc/passwd")不再交给文件缓存和stat
+ * @return 路径是否在资源根目录之内
  */
-void HttpRequest::ParsePath_() {
+bool HttpRequest::ParsePath_() {
+    if (path_.empty() || path_[0] != '/' || path_.find("/.") != string::npos || path_.find("//") != string::npos) {
+        string out;
+        out.reserve(path_.size() + 1);
+        for (size_t i = 0; i < path_.size();) {
+            size_t end = path_.find('/', i);
+            if (end == string::npos) { end = path_.size(); }
+            size_t len = end - i;
+            if (len == 2 && path_[i] == '.' && path_[i + 1] == '.') {
+                if (out.empty()) { return false; }
+                out.erase(out.find_last_of('/'));
+            } else if (len > 0 && !(len == 1 && path_[i] == '.')) {
+                out += '/';
+                out.append(path_, i, len);
+            }
+            i = end + 1;
+        }
+        if (out.empty() || path_.back() == '/' ||
+            (path_.size() >= 2 && path_.compare(path_.size() - 2, 2, "/.") == 0) ||
+            (path_.size() >= 3 && path_.compare(path_.size() - 3, 3, "/..") == 0)) {
+            out += '/';
+        }
+        path_ = out;
+    }
     if (path_ == "/") {
         path_ = "/index.html";
     } else {
@@ -84,50 +183,210 @@ void HttpRequest::ParsePath_() {
             }
         }
     }
+    return true;
 }
 
 /**
- *
- * @param line
+ * 解析请求行 "METHOD SP request-target SP HTTP/x.y"
+ * @param begin 报文起始地址
+ * @param off 行起始偏移
+ * @param len 行长度,不含CRLF
  * @return
  */
-bool HttpRequest::ParseRequestLine_(const string &line) {
-    regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, patten)) {
-        method_ = subMatch[1];
-        path_ = subMatch[2];
-        version_ = subMatch[3];
-        state_ = HEADERS;
-        return true;
+bool HttpRequest::ParseRequestLine_(const char *begin, size_t off, size_t len) {
+    const char *line = begin + off;
+    size_t i = 0;
+    while (i < len && IsTokenChar(line[i])) { i++; }
+    if (i == 0 || i >= len || line[i] != ' ') {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    method_ = Span{static_cast<uint32_t>(off), static_cast<uint32_t>(i)};
+
+    size_t target = ++i;
+    size_t query = 0;
+    while (i < len && line[i] != ' ') {
+        if (line[i] == '?' && query == 0) { query = i; }
+        i++;
     }
-    LOG_ERROR("RequestLine Error");
-    return false;
+    if (i == target || i >= len) {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    target_ = Span{static_cast<uint32_t>(off + target), static_cast<uint32_t>(i - target)};
+    /* 静态资源只关心路径部分,丢弃查询串 */
+    path_.assign(line + target, (query ? query : i) - target);
+
+    i++;
+    if (len - i < 6 || memcmp(line + i, "HTTP/", 5) != 0) {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    i += 5;
+    for (size_t j = i; j < len; j++) {
+        if (!isdigit(static_cast<unsigned char>(line[j])) && line[j] != '.') {
+            LOG_ERROR("RequestLine Error");
+            return false;
+        }
+    }
+    version_ = Span{static_cast<uint32_t>(off + i), static_cast<uint32_t>(len - i)};
+    if (!ParsePath_()) {
+        LOG_ERROR("RequestLine Error: path above root");
+        return false;
+    }
+    state_ = HEADERS;
+    return true;
 }
 
 /**
- *
- * @param line
+ * 解析一行请求头 "name: value",只记录偏移
+ * @param begin 报文起始地址
+ * @param off 行起始偏移
+ * @param len 行长度,不含CRLF
+ * @param colon 行内第一个':'的偏移,没有时为npos
+ * @return
+ */
+bool HttpRequest::ParseHeader_(const char *begin, size_t off, size_t len, size_t colon) {
+    if (colon == string::npos || colon <= off || colon >= off + len || headerCnt_ >= MAX_HEADERS) {
+        LOG_ERROR("Header Error");
+        return false;
+    }
+    const char *line = begin + off;
+    size_t nameLen = colon - off;
+    for (size_t i = 0; i < nameLen; i++) {
+        if (!IsTokenChar(line[i])) {
+            LOG_ERROR("Header Error");
+            return false;
+        }
+    }
+    size_t i = nameLen + 1;
+    while (i < len && (line[i] == ' ' || line[i] == '\t')) { i++; }
+    size_t valueEnd = len;
+    while (valueEnd > i && (line[valueEnd - 1] == ' ' || line[valueEnd - 1] == '\t')) { valueEnd--; }
+    header_[headerCnt_].name = Span{static_cast<uint32_t>(off), static_cast<uint32_t>(nameLen)};
+    header_[headerCnt_].value = Span{static_cast<uint32_t>(off + i), static_cast<uint32_t>(valueEnd - i)};
+    headerCnt_++;
+    return true;
+}
+
+/**
+ * 请求头结束(空行),确定是否保持连接以及请求体长度
+ * @param begin 报文起始地址
+ * @return
  */
-void HttpRequest::ParseHeader_(const string &line) {
-    regex patten("^([^:]*): ?(.*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, patten)) {
-        header_[subMatch[1]] = subMatch[2];
+bool HttpRequest::ParseHeadersEnd_(const char *begin) {
+    string_view version(begin + version_.off, version_.len);
+    string_view conn = FindHeader_(begin, "Connection");
+    if (version == "1.1") {
+        keepAlive_ = !EqualsNoCase(conn, "close");
     } else {
-        state_ = BODY;
+        keepAlive_ = EqualsNoCase(conn, "keep-alive");
     }
+
+    if (!FindHeader_(begin, "Transfer-Encoding").empty()) {
+        LOG_ERROR("Transfer-Encoding not supported");
+        return false;
+    }
+    string_view lenStr = FindHeader_(begin, "Content-Length");
+    contentLen_ = 0;
+    for (char ch: lenStr) {
+        if (!isdigit(static_cast<unsigned char>(ch))) { return false; }
+        contentLen_ = contentLen_ * 10 + (ch - '0');
+        if (contentLen_ > MAX_BODY_SIZE) {
+            LOG_ERROR("Body too large");
+            return false;
+        }
+    }
+    state_ = contentLen_ > 0 ? BODY : FINISH;
+    return true;
 }
 
 /**
- *
- * @param line
+ * 在已解析的请求头中按名字查找(忽略大小写)
+ * @param begin 报文起始地址
+ * @param name
+ * @return 找不到时返回空
  */
-void HttpRequest::ParseBody_(const string &line) {
-    body_ = line;
+string_view HttpRequest::FindHeader_(const char *begin, string_view name) const {
+    for (size_t i = 0; i < headerCnt_; i++) {
+        string_view key(begin + header_[i].name.off, header_[i].name.len);
+        if (EqualsNoCase(key, name)) {
+            return string_view(begin + header_[i].value.off, header_[i].value.len);
+        }
+    }
+    return string_view();
+}
+
+/**
+ * 获取请求头的值,仅在parse返回GET_REQUEST之后有效
+ * @param name 请求头名,忽略大小写
+ * @return 找不到时返回空
+ */
+string_view HttpRequest::GetHeader(string_view name) const {
+    if (base_ == nullptr) { return string_view(); }
+    return FindHeader_(base_, name);
+}
+
+/**
+ * 解析十进制非负整数
+ * @param str
+ * @param out
+ * @return 为空、含非数字或溢出时返回false
+ */
+static bool ParseInt64(string_view str, int64_t &out) {
+    if (str.empty() || str.size() > 18) { return false; }
+    out = 0;
+    for (char ch : str) {
+        if (ch < '0' || ch > '9') { return false; }
+        out = out * 10 + (ch - '0');
+    }
+    return true;
+}
+
+/**
+ * 按语法解析Range请求头(RFC 7233),不涉及文件大小,是否可满足由HttpResponse判断
+ * @param out 至少MAX_RANGES个元素
+ * @return 解析出的段数;没有Range头、单位不是bytes、格式错误或超过MAX_RANGES段时返回0,按普通请求处理
+ */
+int HttpRequest::GetRanges(Range *out) const {
+    string_view value = GetHeader("Range");
+    if (value.size() < 6 || !EqualsNoCase(value.substr(0, 6), "bytes=")) { return 0; }
+    value.remove_prefix(6);
+
+    int cnt = 0;
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        string_view spec = value.substr(0, comma);
+        value = (comma == string_view::npos) ? string_view() : value.substr(comma + 1);
+        while (!spec.empty() && (spec.front() == ' ' || spec.front() == '\t')) { spec.remove_prefix(1); }
+        while (!spec.empty() && (spec.back() == ' ' || spec.back() == '\t')) { spec.remove_suffix(1); }
+        if (spec.empty()) { continue; }   //允许"a-b, ,c-d"这样的空元素
+
+        size_t dash = spec.find('-');
+        if (dash == string_view::npos || cnt == MAX_RANGES) { return 0; }
+        Range range = {-1, -1};
+        if (dash == 0) {
+            if (!ParseInt64(spec.substr(1), range.last)) { return 0; }
+        } else {
+            if (!ParseInt64(spec.substr(0, dash), range.first)) { return 0; }
+            if (dash + 1 < spec.size()) {
+                if (!ParseInt64(spec.substr(dash + 1), range.last) || range.last < range.first) { return 0; }
+            }
+        }
+        out[cnt++] = range;
+    }
+    return cnt;
+}
+
+/**
+ * 保存请求体,只有POST表单需要复制
+ * @param body
+ * @param len
+ */
+void HttpRequest::ParseBody_(const char *body, size_t len) {
+    body_.assign(body, len);
     ParsePost_();
-    state_ = FINISH;
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    LOG_DEBUG("Body:%s, len:%d", body_.c_str(), body_.size());
 }
 
 /**
@@ -145,7 +404,7 @@ int HttpRequest::ConverHex(char ch) {
  *
  */
 void HttpRequest::ParsePost_() {
-    if (method_ == "POST" && header_["Content-Type"] == "application/x-www-form-urlencoded") {
+    if (method() == "POST" && GetHeader("Content-Type") == "application/x-www-form-urlencoded") {
         ParseFromUrlencoded_();
         if (DEFAULT_HTML_TAG.count(path_)) {
             int tag = DEFAULT_HTML_TAG.find(path_)->second;
@@ -290,19 +549,27 @@ std::string &HttpRequest::path() {
 }
 
 /**
- *
+ * 仅在parse返回GET_REQUEST之后有效
  * @return
  */
-std::string HttpRequest::method() const {
-    return method_;
+std::string_view HttpRequest::method() const {
+    return base_ ? View_(method_) : std::string_view();
 }
 
 /**
- *
+ * 请求行中原样的请求目标,包括查询串;仅在parse返回GET_REQUEST之后有效
+ * @return
+ */
+std::string_view HttpRequest::target() const {
+    return base_ ? View_(target_) : std::string_view();
+}
+
+/**
+ * 仅在parse返回GET_REQUEST之后有效
  * @return
  */
-std::string HttpRequest::version() const {
-    return version_;
+std::string_view HttpRequest::version() const {
+    return base_ ? View_(version_) : std::string_view();
 }
 
 /**
@@ -4,11 +4,12 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
-#include <regex>
+#include <string_view>
 #include <errno.h>
 #include <mysql/mysql.h>  //mysql
 
 #include "../buffer/buffer.h"
+#include "delimscan.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/sqlconnRAII.h"
@@ -22,6 +23,14 @@ public:
         FINISH,
     };
 
+    //Range请求头中的一段: "a-b" -> {a, b}; "a-" -> {a, -1}; "-n"(最后n字节) -> {-1, n}
+    struct Range {
+        int64_t first;
+        int64_t last;
+    };
+
+    static const int MAX_RANGES = 16;
+
     enum HTTP_CODE {
         NO_REQUEST = 0,
         GET_REQUEST,
@@ -33,21 +42,30 @@ public:
         CLOSED_CONNECTION,
     };
 
-    HttpRequest() { Init(); }
+    HttpRequest() {
+        path_.reserve(PATH_RESERVE);
+        Init();
+    }
 
     ~HttpRequest() = default;
 
     void Init();
 
-    bool parse(Buffer &buff);
+    HTTP_CODE parse(Buffer &buff);
 
     std::string path() const;
 
     std::string &path();
 
-    std::string method() const;
+    std::string_view method() const;
+
+    std::string_view target() const;
 
-    std::string version() const;
+    std::string_view version() const;
+
+    std::string_view GetHeader(std::string_view name) const;
+
+    int GetRanges(Range *out) const;
 
     std::string GetPost(const std::string &key) const;
 
@@ -55,6 +73,8 @@ public:
 
     bool IsKeepAlive() const;
 
+    static size_t maxHeaderSize;
+
     /* 
     todo 
     void HttpConn::ParseFormData() {}
@@ -62,23 +82,63 @@ public:
     */
 
 private:
-    bool ParseRequestLine_(const std::string &line);
+    //请求中某一段在报文里的位置,相对报文起始处的偏移
+    //解析过程中报文可能随ReadFd在Buffer中移动,因此只记录偏移,解析完成后再转换为string_view
+    struct Span {
+        uint32_t off;
+        uint32_t len;
+    };
 
-    void ParseHeader_(const std::string &line);
+    struct HeaderField {
+        Span name;
+        Span value;
+    };
+
+    bool ParseRequestLine_(const char *begin, size_t off, size_t len);
+
+    bool ParseHeader_(const char *begin, size_t off, size_t len, size_t colon);
+
+    bool ParseHeadersEnd_(const char *begin);
 
-    void ParseBody_(const std::string &line);
+    void ParseBody_(const char *begin, size_t len);
 
-    void ParsePath_();
+    bool ParsePath_();
 
     void ParsePost_();
 
     void ParseFromUrlencoded_();
 
+    std::string_view FindHeader_(const char *begin, std::string_view name) const;
+
+    std::string_view View_(Span span) const {
+        return std::string_view(base_ + span.off, span.len);
+    }
+
     static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
 
+    static const size_t MAX_HEADERS = 64;
+    static const size_t MAX_DELIMS = 128;
+    static const size_t MAX_BODY_SIZE = 1 << 20;
+    static const size_t PATH_RESERVE = 256;
+
     PARSE_STATE state_;
-    std::string method_, path_, version_, body_;
-    std::unordered_map <std::string, std::string> header_;
+    size_t cursor_;      //下一次从报文的哪个偏移开始扫描,报文分多次到达时从这里继续
+    size_t lineStart_;   //当前行的起始偏移
+    size_t lineColon_;   //当前行第一个':'的偏移
+
+    uint32_t delims_[MAX_DELIMS];   //DelimScanner找到的分隔符,相对delimBase_的偏移
+    size_t delimBase_;
+    size_t delimCnt_;
+    size_t delimIdx_;
+    size_t contentLen_;
+    bool keepAlive_;
+    const char *base_;   //解析完成时报文的起始地址,string_view均指向这里
+
+    Span method_, target_, version_;
+    HeaderField header_[MAX_HEADERS];
+    size_t headerCnt_;
+
+    std::string path_, body_;
     std::unordered_map <std::string, std::string> post_;
 
     static const std::unordered_set <std::string> DEFAULT_HTML;
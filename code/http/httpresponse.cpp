@@ -18,6 +18,7 @@ const unordered_map <string, string> HttpResponse::SUFFIX_TYPE = {
         {".mpeg",  "video/mpeg"},
         {".mpg",   "video/mpeg"},
         {".avi",   "video/x-msvideo"},
+        {".mp4",   "video/mp4"},
         {".gz",    "application/x-gzip"},
         {".tar",   "application/x-tar"},
         {".css",   "text/css "},
@@ -26,11 +27,16 @@ const unordered_map <string, string> HttpResponse::SUFFIX_TYPE = {
 
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
         {200, "OK"},
+        {206, "Partial Content"},
+        {304, "Not Modified"},
         {400, "Bad Request"},
         {403, "Forbidden"},
         {404, "Not Found"},
+        {416, "Range Not Satisfiable"},
 };
 
+size_t HttpResponse::sendfileThreshold = 256 << 10;
+
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
         {400, "/400.html"},
         {403, "/403.html"},
@@ -38,12 +44,19 @@ const unordered_map<int, string> HttpResponse::CODE_PATH = {
 };
 
 
+
 HttpResponse::HttpResponse() {
     code_ = -1;
     path_ = srcDir_ = "";
     isKeepAlive_ = false;
+    request_ = nullptr;
     mmFile_ = nullptr;
+    fileFd_ = -1;
     mmFileStat_ = {0};
+    encoding_ = nullptr;
+    vary_ = false;
+    bodyOff_ = bodyLen_ = 0;
+    rangeCnt_ = 0;
 };
 
 /**
@@ -59,16 +72,23 @@ HttpResponse::~HttpResponse() {
  * @param path
  * @param isKeepAlive
  * @param code
+ * @param request 需要支持Range等请求头时传入,在MakeResponse返回前必须保持有效
  */
-void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, int code) {
+void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, int code, const HttpRequest *request) {
     assert(srcDir != "");
-    if (mmFile_) { UnmapFile(); }
+    UnmapFile();
     code_ = code;
     isKeepAlive_ = isKeepAlive;
+    request_ = request;
     path_ = path;
     srcDir_ = srcDir;
-    mmFile_ = nullptr;
     mmFileStat_ = {0};
+    encoding_ = nullptr;
+    vary_ = false;
+    etag_.clear();
+    lastModified_.clear();
+    bodyOff_ = bodyLen_ = 0;
+    rangeCnt_ = 0;
 }
 
 /**
@@ -76,26 +96,54 @@ void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, in
  * @param buff
  */
 void HttpResponse::MakeResponse(Buffer &buff) {
-    /* 判断请求的资源文件 */
-    if (stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
+    /* 判断请求的资源文件, 报文错误时直接返回400页面 */
+    if (code_ != 400) { StatFile_(); }
+    if (code_ == 400) {
+    } else if (mmFileStat_.st_mode == 0 || S_ISDIR(mmFileStat_.st_mode)) {
         code_ = 404;
     } else if (!(mmFileStat_.st_mode & S_IROTH)) {
         code_ = 403;
     } else if (code_ == -1) {
         code_ = 200;
     }
+    if (code_ == 200) { SelectEncoding_(); }
+    if (code_ == 200 && NotModified_()) {
+        /* 客户端缓存仍然有效,只发送响应头,不打开文件 */
+        code_ = 304;
+    }
+    if (code_ == 200) { SelectRanges_(); }
     ErrorHtml_();
     AddStateLine_(buff);
     AddHeader_(buff);
     AddContent_(buff);
 }
 
+/**
+ * 运行时生成的200响应(如/metrics),不对应文件;响应体按Accept-Encoding压缩后直接写入Buffer
+ * @param buff
+ * @param type 响应体的Content-type
+ * @param body
+ */
+void HttpResponse::MakeGenerated(Buffer &buff, const string &type, const string &body) {
+    code_ = 200;
+    AddStateLine_(buff);
+    AddConnection_(buff);
+    buff.Append("Content-type: " + type + "\r\n");
+    buff.Append("Cache-Control: no-store\r\n");
+    if (CompressBody_(buff, body.data(), body.size(), type)) { return; }
+    buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
+    buff.Append(body);
+}
+
 /**
  *
  * @return
  */
 char *HttpResponse::File() {
-    return mmFile_;
+    if (cached_ && cached_->HasBody()) {
+        return const_cast<char *>(cached_->body.data()) + bodyOff_;
+    }
+    return mmFile_ ? mmFile_ + bodyOff_ : nullptr;
 }
 
 /**
@@ -103,7 +151,7 @@ char *HttpResponse::File() {
  * @return
  */
 size_t HttpResponse::FileLen() const {
-    return mmFileStat_.st_size;
+    return bodyLen_;
 }
 
 /**
@@ -112,7 +160,208 @@ size_t HttpResponse::FileLen() const {
 void HttpResponse::ErrorHtml_() {
     if (CODE_PATH.count(code_) == 1) {
         path_ = CODE_PATH.find(code_)->second;
-        stat((srcDir_ + path_).data(), &mmFileStat_);
+        StatFile_();
+    }
+}
+
+/**
+ * 获取文件信息,优先从文件缓存中取,未命中时调用stat;文件不存在时mmFileStat_清零
+ */
+void HttpResponse::StatFile_() {
+    string path = srcDir_ + path_;
+    cached_ = FileCache::Instance()->Get(path);
+    if (cached_) {
+        mmFileStat_ = cached_->st;
+    } else if (stat(path.data(), &mmFileStat_) < 0) {
+        mmFileStat_ = {0};
+    } else {
+        etag_ = ETag(mmFileStat_);
+        lastModified_ = HttpDate(mmFileStat_.st_mtime);
+    }
+}
+
+static const int GZIP_INDEX = FileCache::SIDECAR_NUM - 1;   //SIDECARS中gzip的下标
+
+/**
+ * 解析Accept-Encoding中一项的参数部分,如";q=0.5"
+ * @param params
+ * @return 权重的千分值,没有q参数时为1000
+ */
+static int QValue(string_view params) {
+    size_t pos = params.find("q=");
+    if (pos == string_view::npos) { return 1000; }
+    params.remove_prefix(pos + 2);
+    if (params.empty() || (params[0] != '0' && params[0] != '1')) { return 0; }
+    int q = (params[0] - '0') * 1000;
+    if (params.size() > 1 && params[1] == '.') {
+        int scale = 100;
+        for (size_t i = 2; i < params.size() && i < 5 && params[i] >= '0' && params[i] <= '9'; i++) {
+            q += (params[i] - '0') * scale;
+            scale /= 10;
+        }
+    }
+    return min(q, 1000);
+}
+
+/**
+ * 解析Accept-Encoding,得到每种编码(与FileCache::SIDECARS对应)的权重,未列出的编码取"*"的权重
+ * @param accept
+ * @param q 输出,权重的千分值, 0表示不接受
+ */
+static void AcceptQValues(string_view accept, int q[FileCache::SIDECAR_NUM]) {
+    int anyQ = 0;
+    bool listed[FileCache::SIDECAR_NUM] = {false};
+    for (int i = 0; i < FileCache::SIDECAR_NUM; i++) { q[i] = 0; }
+    while (!accept.empty()) {
+        size_t comma = accept.find(',');
+        string_view item = accept.substr(0, comma);
+        accept = (comma == string_view::npos) ? string_view() : accept.substr(comma + 1);
+        size_t semi = item.find(';');
+        string_view coding = item.substr(0, semi);
+        while (!coding.empty() && (coding.front() == ' ' || coding.front() == '\t')) { coding.remove_prefix(1); }
+        while (!coding.empty() && (coding.back() == ' ' || coding.back() == '\t')) { coding.remove_suffix(1); }
+        int value = (semi == string_view::npos) ? 1000 : QValue(item.substr(semi + 1));
+        if (coding == "*") {
+            anyQ = value;
+            continue;
+        }
+        for (int i = 0; i < FileCache::SIDECAR_NUM; i++) {
+            if (coding == FileCache::SIDECARS[i].encoding || (coding == "x-gzip" && i == GZIP_INDEX)) {
+                q[i] = value;
+                listed[i] = true;
+            }
+        }
+    }
+    for (int i = 0; i < FileCache::SIDECAR_NUM; i++) {
+        if (!listed[i]) { q[i] = anyQ; }
+    }
+}
+
+/**
+ * 按Accept-Encoding选择预压缩文件(权重最高者,权重相同按br > zstd > gzip),选中后改为发送该文件
+ * Range请求不使用预压缩文件,区间始终针对原文件
+ */
+void HttpResponse::SelectEncoding_() {
+    if (request_ == nullptr || request_->method() != "GET") { return; }
+    string_view accept = request_->GetHeader("Accept-Encoding");
+    //不论请求是否带Accept-Encoding,只要有预压缩文件就带上Vary,缓存与未缓存时的响应头一致
+    uint8_t sidecars = cached_ ? cached_->sidecars : FileCache::ProbeSidecars(srcDir_ + path_, mmFileStat_);
+    if (sidecars == 0) { return; }
+    vary_ = true;
+    if (accept.empty() || !request_->GetHeader("Range").empty()) { return; }
+
+    int q[FileCache::SIDECAR_NUM];
+    AcceptQValues(accept, q);
+    int best = -1;
+    for (int i = 0; i < FileCache::SIDECAR_NUM; i++) {
+        if ((sidecars & (1 << i)) && q[i] > 0 && (best < 0 || q[i] > q[best])) {
+            best = i;
+        }
+    }
+    if (best < 0) { return; }
+
+    string type = ContentType_();
+    string origin = path_;
+    path_ += FileCache::SIDECARS[best].ext;
+    StatFile_();
+    if (!S_ISREG(mmFileStat_.st_mode)) {
+        /* 预压缩文件刚被删除,退回原文件 */
+        path_ = origin;
+        StatFile_();
+        return;
+    }
+    encoding_ = FileCache::SIDECARS[best].encoding;
+    contentType_ = type;
+}
+
+/**
+ * 命中缓存的GET 200响应直接使用条目中预先拼好的Content-type/Content-length
+ * @return
+ */
+bool HttpResponse::UsePrebuilt_() const {
+    return cached_ && code_ == 200 && !encoding_ && (request_ == nullptr || request_->method() == "GET");
+}
+
+/**
+ * @return 响应的Content-type,发送预压缩文件时为原文件的类型
+ */
+string HttpResponse::ContentType_() const {
+    if (encoding_) { return contentType_; }
+    return cached_ ? cached_->mime : FileType(path_);
+}
+
+/**
+ * 条件GET(RFC 7232): 有If-None-Match时只看它,否则看If-Modified-Since
+ * @return 客户端缓存的版本是否仍然有效
+ */
+bool HttpResponse::NotModified_() {
+    if (request_ == nullptr || request_->method() != "GET") { return false; }
+    const string &etag = cached_ ? cached_->etag : etag_;
+    string_view match = request_->GetHeader("If-None-Match");
+    if (!match.empty()) {
+        /* 逗号分隔的ETag列表或"*", 比较时忽略弱标记W/ */
+        while (!match.empty()) {
+            size_t comma = match.find(',');
+            string_view tag = match.substr(0, comma);
+            match = (comma == string_view::npos) ? string_view() : match.substr(comma + 1);
+            while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) { tag.remove_prefix(1); }
+            while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) { tag.remove_suffix(1); }
+            if (tag.substr(0, 2) == "W/") { tag.remove_prefix(2); }
+            if (tag == "*" || tag == etag) { return true; }
+        }
+        return false;
+    }
+    string_view since = request_->GetHeader("If-Modified-Since");
+    if (since.empty() || since.size() >= 64) { return false; }
+    char date[64];
+    memcpy(date, since.data(), since.size());
+    date[since.size()] = '\0';
+    struct tm tm = {};
+    const char *end = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == nullptr || *end != '\0') { return false; }
+    return mmFileStat_.st_mtime <= timegm(&tm);
+}
+
+/**
+ * 根据Range/If-Range把各段换算为文件内的闭区间,code_可能变为206或416
+ */
+void HttpResponse::SelectRanges_() {
+    rangeCnt_ = 0;
+    if (request_ == nullptr || request_->method() != "GET") { return; }
+    HttpRequest::Range req[HttpRequest::MAX_RANGES];
+    int cnt = request_->GetRanges(req);
+    if (cnt == 0) { return; }
+    string_view ifRange = request_->GetHeader("If-Range");
+    const string &validator = (ifRange.substr(0, 1) == "\"") ? (cached_ ? cached_->etag : etag_)
+                                                              : (cached_ ? cached_->lastModified : lastModified_);
+    if (!ifRange.empty() && ifRange != validator) {
+        /* 客户端缓存的版本已过期,发送完整内容 */
+        return;
+    }
+
+    int64_t size = mmFileStat_.st_size;
+    size_t total = 0;
+    for (int i = 0; i < cnt; i++) {
+        HttpRequest::Range range;
+        if (req[i].first < 0) {
+            /* 最后n字节 */
+            if (req[i].last == 0 || size == 0) { continue; }
+            range.first = max<int64_t>(0, size - req[i].last);
+            range.last = size - 1;
+        } else {
+            if (req[i].first >= size) { continue; }
+            range.first = req[i].first;
+            range.last = (req[i].last < 0 || req[i].last >= size) ? size - 1 : req[i].last;
+        }
+        ranges_[rangeCnt_++] = range;
+        total += range.last - range.first + 1;
+    }
+    if (rangeCnt_ == 0) {
+        code_ = 416;
+    } else if (rangeCnt_ > 1 && total > MULTI_RANGE_MAX) {
+        rangeCnt_ = 0;
+    } else {
+        code_ = 206;
     }
 }
 
@@ -136,6 +385,40 @@ void HttpResponse::AddStateLine_(Buffer &buff) {
  * @param buff
  */
 void HttpResponse::AddHeader_(Buffer &buff) {
+    AddConnection_(buff);
+    if ((code_ == 200 || code_ == 206 || code_ == 304) && request_ && request_->method() == "GET") {
+        /* POST的结果页是动态响应,不带校验器 */
+        buff.Append("ETag: " + (cached_ ? cached_->etag : etag_) + "\r\n");
+        buff.Append("Last-Modified: " + (cached_ ? cached_->lastModified : lastModified_) + "\r\n");
+    }
+    if (code_ == 200 || code_ == 206) {
+        buff.Append("Accept-Ranges: bytes\r\n");
+    }
+    if (vary_ && (code_ == 200 || code_ == 206 || code_ == 304)) {
+        buff.Append("Vary: Accept-Encoding\r\n");
+    }
+    if (encoding_ && code_ == 200) {
+        buff.Append("Content-Encoding: " + string(encoding_) + "\r\n");
+    }
+    if (code_ == 304) {
+    } else if (code_ == 416) {
+        buff.Append("Content-type: text/html\r\n");
+    } else if (rangeCnt_ > 1) {
+        static thread_local unsigned long long seq = 0;
+        char boundary[24];
+        snprintf(boundary, sizeof(boundary), "%020llu", ++seq);
+        boundary_ = boundary;
+        buff.Append("Content-type: multipart/byteranges; boundary=" + boundary_ + "\r\n");
+    } else if (!UsePrebuilt_()) {
+        buff.Append("Content-type: " + ContentType_() + "\r\n");
+    }
+}
+
+/**
+ *
+ * @param buff
+ */
+void HttpResponse::AddConnection_(Buffer &buff) {
     buff.Append("Connection: ");
     if (isKeepAlive_) {
         buff.Append("keep-alive\r\n");
@@ -143,7 +426,6 @@ void HttpResponse::AddHeader_(Buffer &buff) {
     } else {
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
 }
 
 /**
@@ -151,23 +433,112 @@ void HttpResponse::AddHeader_(Buffer &buff) {
  * @param buff
  */
 void HttpResponse::AddContent_(Buffer &buff) {
+    if (code_ == 304) {
+        buff.Append("\r\n");
+        return;
+    }
+    if (code_ == 416) {
+        buff.Append("Content-Range: bytes */" + to_string(mmFileStat_.st_size) + "\r\n");
+        ErrorContent(buff, "Requested Range Not Satisfiable");
+        return;
+    }
+    if (rangeCnt_ > 1) {
+        AddMultiRange_(buff);
+        return;
+    }
+    if (cached_ && cached_->HasBody()) {
+        /* 命中缓存: 内容和响应头都已就绪,不再open/mmap */
+        AddLength_(buff);
+        return;
+    }
     int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
     if (srcFd < 0) {
         ErrorContent(buff, "File NotFound!");
         return;
     }
 
-    /* 将文件映射到内存提高文件的访问速度 
-        MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
     LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-    int *mmRet = (int *) mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1) {
-        ErrorContent(buff, "File NotFound!");
+    if (sendfileThreshold > 0 && static_cast<size_t>(mmFileStat_.st_size) >= sendfileThreshold) {
+        /* 大文件保持fd打开,由HttpConn用sendfile直接从页缓存发往socket,
+           不经过用户态拷贝,也不会把整个文件映射进进程地址空间 */
+        fileFd_ = srcFd;
+    } else {
+        /* 将文件映射到内存提高文件的访问速度 
+            MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
+        void *mmRet = mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+        close(srcFd);
+        if (mmRet == MAP_FAILED) {
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
+        mmFile_ = (char *) mmRet;
+    }
+    AddLength_(buff);
+}
+
+/**
+ * 确定要发送的文件区间,并添加Content-Range/Content-length头
+ * @param buff
+ */
+void HttpResponse::AddLength_(Buffer &buff) {
+    if (code_ == 206) {
+        bodyOff_ = ranges_[0].first;
+        bodyLen_ = ranges_[0].last - ranges_[0].first + 1;
+        buff.Append("Content-Range: bytes " + to_string(ranges_[0].first) + "-" + to_string(ranges_[0].last) +
+                    "/" + to_string(mmFileStat_.st_size) + "\r\n");
+        buff.Append("Content-length: " + to_string(bodyLen_) + "\r\n\r\n");
         return;
     }
-    mmFile_ = (char *) mmRet;
-    close(srcFd);
-    buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
+    bodyOff_ = 0;
+    bodyLen_ = mmFileStat_.st_size;
+    if (code_ == 200 && !encoding_ && request_ && request_->method() == "POST" && File() &&
+        CompressBody_(buff, File(), bodyLen_, ContentType_())) {
+        /* POST的结果页是动态响应,压缩后的内容已在Buffer中 */
+        bodyLen_ = 0;
+        return;
+    }
+    if (UsePrebuilt_()) {
+        buff.Append(cached_->header);
+    } else {
+        buff.Append("Content-length: " + to_string(bodyLen_) + "\r\n\r\n");
+    }
+}
+
+/**
+ * 多段Range: 按multipart/byteranges格式把各段内容拼入Buffer,总长度已由SelectRanges_限制
+ * @param buff
+ */
+void HttpResponse::AddMultiRange_(Buffer &buff) {
+    int srcFd = -1;
+    if (!(cached_ && cached_->HasBody())) {
+        srcFd = open((srcDir_ + path_).data(), O_RDONLY);
+        if (srcFd < 0) {
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
+    }
+    string type = ContentType_();
+    string body;
+    for (int i = 0; i < rangeCnt_; i++) {
+        body += "--" + boundary_ + "\r\nContent-type: " + type + "\r\nContent-Range: bytes " +
+                to_string(ranges_[i].first) + "-" + to_string(ranges_[i].last) + "/" +
+                to_string(mmFileStat_.st_size) + "\r\n\r\n";
+        size_t len = ranges_[i].last - ranges_[i].first + 1;
+        size_t at = body.size();
+        body.resize(at + len);
+        if (srcFd < 0) {
+            memcpy(&body[at], cached_->body.data() + ranges_[i].first, len);
+        } else if (pread(srcFd, &body[at], len, ranges_[i].first) != static_cast<ssize_t>(len)) {
+            close(srcFd);
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
+        body += "\r\n";
+    }
+    body += "--" + boundary_ + "--\r\n";
+    if (srcFd >= 0) { close(srcFd); }
+    buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
+    buff.Append(body);
 }
 
 /**
@@ -178,19 +549,49 @@ void HttpResponse::UnmapFile() {
         munmap(mmFile_, mmFileStat_.st_size);
         mmFile_ = nullptr;
     }
+    if (fileFd_ >= 0) {
+        close(fileFd_);
+        fileFd_ = -1;
+    }
+    cached_.reset();
+}
+
+/**
+ * 强ETag,由inode、文件大小和纳秒级修改时间生成,文件被替换或修改后必然变化
+ * @param st
+ * @return 带双引号的ETag
+ */
+string HttpResponse::ETag(const struct stat &st) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "\"%llx-%llx-%llx\"", (unsigned long long) st.st_ino,
+                       (unsigned long long) st.st_size,
+                       (unsigned long long) st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec);
+    return string(buf, len);
+}
+
+/**
+ * 格式化为HTTP-date(RFC 7231 IMF-fixdate)
+ * @param t
+ * @return 如"Sun, 06 Nov 1994 08:49:37 GMT"
+ */
+string HttpResponse::HttpDate(time_t t) {
+    struct tm tm;
+    char buf[32];
+    gmtime_r(&t, &tm);
+    return string(buf, strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm));
 }
 
 /**
  *
  * @return
  */
-string HttpResponse::GetFileType_() {
+string HttpResponse::FileType(const string &path) {
     /* 判断文件类型 */
-    string::size_type idx = path_.find_last_of('.');
+    string::size_type idx = path.find_last_of('.');
     if (idx == string::npos) {
         return "text/plain";
     }
-    string suffix = path_.substr(idx);
+    string suffix = path.substr(idx);
     if (SUFFIX_TYPE.count(suffix) == 1) {
         return SUFFIX_TYPE.find(suffix)->second;
     }
@@ -216,6 +617,34 @@ void HttpResponse::ErrorContent(Buffer &buff, string message) {
     body += "<p>" + message + "</p>";
     body += "<hr><em>TinyWebServer</em></body></html>";
 
+    if (CompressBody_(buff, body.data(), body.size(), "text/html")) { return; }
     buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
     buff.Append(body);
 }
+
+/**
+ * 运行时生成的响应体: 客户端接受gzip、类型为文本且长度不小于Deflater::minSize时压缩后写入Buffer
+ * @param buff
+ * @param data
+ * @param len
+ * @param type 响应体的Content-type
+ * @return 是否已压缩并写入Content-length与响应体;返回false时由调用者按原样发送
+ */
+bool HttpResponse::CompressBody_(Buffer &buff, const char *data, size_t len, const string &type) {
+    if (Deflater::level <= 0 || len < Deflater::minSize || request_ == nullptr) { return false; }
+    if (type.compare(0, 5, "text/") != 0 && type.find("javascript") == string::npos &&
+        type.find("json") == string::npos && type.find("xml") == string::npos) {
+        return false;
+    }
+    int q[FileCache::SIDECAR_NUM];
+    AcceptQValues(request_->GetHeader("Accept-Encoding"), q);
+    if (q[GZIP_INDEX] <= 0) { return false; }
+
+    string_view out = Deflater::Local()->Compress(data, len);
+    if (out.empty()) { return false; }
+    buff.Append("Content-Encoding: gzip\r\n");
+    if (!vary_) { buff.Append("Vary: Accept-Encoding\r\n"); }
+    buff.Append("Content-length: " + to_string(out.size()) + "\r\n\r\n");
+    buff.Append(out.data(), out.size());
+    return true;
+}
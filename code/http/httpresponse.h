@@ -6,9 +6,13 @@
 #include <unistd.h>      // close
 #include <sys/stat.h>    // stat
 #include <sys/mman.h>    // mmap, munmap
+#include <memory>
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
+#include "filecache.h"
+#include "httprequest.h"
+#include "deflater.h"
 
 class HttpResponse {
 public:
@@ -16,39 +20,88 @@ public:
 
     ~HttpResponse();
 
-    void Init(const std::string &srcDir, std::string &path, bool isKeepAlive = false, int code = -1);
+    void Init(const std::string &srcDir, std::string &path, bool isKeepAlive = false, int code = -1,
+              const HttpRequest *request = nullptr);
 
     void MakeResponse(Buffer &buff);
 
+    void MakeGenerated(Buffer &buff, const std::string &type, const std::string &body);
+
     void UnmapFile();
 
     char *File();
 
     size_t FileLen() const;
 
+    int FileFd() const { return fileFd_; }
+
+    off_t FileOffset() const { return bodyOff_; }
+
     void ErrorContent(Buffer &buff, std::string message);
 
     int Code() const { return code_; }
 
+    static std::string FileType(const std::string &path);
+
+    static std::string ETag(const struct stat &st);
+
+    static std::string HttpDate(time_t t);
+
+    static size_t sendfileThreshold;   //不小于该大小的文件不做mmap,保持fd打开交给sendfile发送, 0表示不使用
+
 private:
     void AddStateLine_(Buffer &buff);
 
     void AddHeader_(Buffer &buff);
 
+    void AddConnection_(Buffer &buff);
+
     void AddContent_(Buffer &buff);
 
     void ErrorHtml_();
 
-    std::string GetFileType_();
+    void StatFile_();
+
+    void SelectEncoding_();
+
+    std::string ContentType_() const;
+
+    bool UsePrebuilt_() const;
+
+    bool NotModified_();
+
+    void SelectRanges_();
+
+    void AddLength_(Buffer &buff);
+
+    void AddMultiRange_(Buffer &buff);
+
+    bool CompressBody_(Buffer &buff, const char *data, size_t len, const std::string &type);
 
     int code_;
     bool isKeepAlive_;
+    const HttpRequest *request_;   //对应的请求,用于读取Range等请求头;报文错误时为nullptr
 
     std::string path_;
     std::string srcDir_;
 
     char *mmFile_;
+    int fileFd_;      //走sendfile时打开的文件,否则为-1
     struct stat mmFileStat_;
+    std::shared_ptr<const FileCache::Entry> cached_;   //命中文件缓存时持有条目,保证发送期间内容有效
+    const char *encoding_;       //发送预压缩文件时的Content-Encoding,否则为nullptr
+    std::string contentType_;    //发送预压缩文件时原文件的类型
+    bool vary_;                  //存在预压缩版本,响应随Accept-Encoding变化
+    std::string etag_;           //未命中缓存时现算的校验器,命中时直接用条目中的
+    std::string lastModified_;
+    size_t bodyOff_;  //需要发送的文件内容在文件中的起始偏移和长度,整个文件时为0和文件大小
+    size_t bodyLen_;
+
+    HttpRequest::Range ranges_[HttpRequest::MAX_RANGES];   //已按文件大小换算为闭区间[first, last]
+    int rangeCnt_;
+    std::string boundary_;
+
+    static const size_t MULTI_RANGE_MAX = 64 << 10;   //多段Range在Buffer中拼装,总长度超过时忽略Range发送整个文件
 
     static const std::unordered_map <std::string, std::string> SUFFIX_TYPE;
     static const std::unordered_map<int, std::string> CODE_STATUS;
@@ -0,0 +1,250 @@
+#include "accesslog.h"
+#include "log.h"
+#include "logformat.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <algorithm>
+
+using namespace std;
+
+AccessLog::Format AccessLog::format_ = AccessLog::COMMON;
+int AccessLog::sampleRate_ = 0;
+
+namespace {
+/* 在栈上的行缓冲区中拼接一行,超出容量的部分被丢弃,始终为结尾的换行符留出位置 */
+struct LineWriter {
+    char *buf;
+    size_t cap;
+    size_t len;
+
+    void Put(const char *s, size_t n) {
+        n = min(n, cap - 1 - len);
+        memcpy(buf + len, s, n);
+        len += n;
+    }
+
+    void Put(const char *s) { Put(s, strlen(s)); }
+
+    void Putc(char c) {
+        if (len + 1 < cap) { buf[len++] = c; }
+    }
+
+    void Num(long long v) {
+        char tmp[24];
+        Put(tmp, snprintf(tmp, sizeof(tmp), "%lld", v));
+    }
+
+    /**
+     * 追加转义后的字符串: JSON按RFC 8259转义, CLF按nginx的习惯把引号、反斜杠和不可打印字符写成\xHH
+     * @param maxLen 转义后最多写入的字节数,超出的字符被丢弃
+     */
+    void Escaped(const string &s, size_t maxLen, bool json) {
+        static const char HEX[] = "0123456789ABCDEF";
+        size_t end = len + maxLen;
+        for (size_t i = 0; i < s.size() && len + 6 <= end; i++) {
+            unsigned char c = s[i];
+            if (json) {
+                if (c == '"' || c == '\\') {
+                    Putc('\\');
+                    Putc(c);
+                } else if (c < 0x20) {
+                    char esc[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 15]};
+                    Put(esc, sizeof(esc));
+                } else {
+                    Putc(c);
+                }
+            } else if (c == '"' || c == '\\' || c < 0x20 || c >= 0x7f) {
+                char esc[] = {'\\', 'x', HEX[c >> 4], HEX[c & 15]};
+                Put(esc, sizeof(esc));
+            } else {
+                Putc(c);
+            }
+        }
+    }
+
+    /* CLF中空字段写作"-" */
+    void Field(const string &s, size_t maxLen) {
+        if (s.empty()) {
+            Putc('-');
+        } else {
+            Escaped(s, maxLen, false);
+        }
+    }
+};
+
+thread_local LogFormat::TimeCache t_time;
+thread_local unsigned t_sampleSeq = 0;
+}
+
+/**
+ * @brief 打开访问日志
+ *
+ * @param format 行格式
+ * @param sampleRate 每sampleRate个请求记录一个, 不大于0时视为1
+ * @param path 目录
+ * @param suffix 文件名后缀,文件名为日期+后缀
+ * @param maxQueueCapacity 每个线程的环可容纳的行数, 0表示同步写入
+ * @param cpu 写线程绑定的CPU
+ */
+void AccessLog::Init(Format format, int sampleRate, const char *path, const char *suffix,
+                     int maxQueueCapacity, int cpu) {
+    Sink_()->init(1, path, suffix, maxQueueCapacity, cpu);
+    format_ = format;
+    sampleRate_ = max(sampleRate, 1);
+}
+
+/**
+ * @brief 由配置中的名称得到格式
+ *
+ * @param name
+ * @param format
+ * @return bool 名称是否有效
+ */
+bool AccessLog::ParseFormat(const string &name, Format *format) {
+    if (name == "common") {
+        *format = COMMON;
+    } else if (name == "combined") {
+        *format = COMBINED;
+    } else if (name == "json") {
+        *format = JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 设置文件的切换、归档与写入方式
+ *
+ * @param options
+ */
+void AccessLog::SetFileOptions(const LogFileOptions &options) {
+    Sink_()->SetFileOptions(options);
+}
+
+/**
+ * @brief 1/sampleRate_抽样
+ *
+ * @return bool
+ */
+bool AccessLog::Sample() {
+    return sampleRate_ == 1 || ++t_sampleSeq % static_cast<unsigned>(sampleRate_) == 0;
+}
+
+/**
+ * @brief 单调时钟(vDSO),纳秒
+ *
+ * @return int64_t
+ */
+int64_t AccessLog::NowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * @brief 格式化一行并追加到本线程的环中
+ *
+ * @param addr 客户端地址
+ * @param entry 请求
+ * @param firstByteNs 发出第一个字节的时刻, 0表示未知
+ * @param doneNs 发送完毕的时刻
+ */
+void AccessLog::Write(const sockaddr_in &addr, const Entry &entry, int64_t firstByteNs, int64_t doneNs) {
+    char ip[INET_ADDRSTRLEN] = "-";
+    inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    long long ttfbUs = firstByteNs > 0 ? (firstByteNs - entry.startNs) / 1000 : -1;
+    long long totalUs = (doneNs - entry.startNs) / 1000;
+
+    char line[LINE_MAX_LEN];
+    LineWriter w = {line, sizeof(line), 0};
+    if (format_ == JSON) {
+        w.Put("{\"time\":\"");
+        w.Put(t_time.Get(time(nullptr), "%Y-%m-%dT%H:%M:%S%z"));
+        w.Put("\",\"remote_addr\":\"");
+        w.Put(ip);
+        w.Put("\",\"method\":\"");
+        w.Escaped(entry.method, FIELD_MAX_LEN, true);
+        w.Put("\",\"target\":\"");
+        w.Escaped(entry.target, FIELD_MAX_LEN, true);
+        w.Put("\",\"protocol\":\"");
+        if (!entry.version.empty()) {
+            w.Put("HTTP/");
+            w.Escaped(entry.version, FIELD_MAX_LEN, true);
+        }
+        w.Put("\",\"status\":");
+        w.Num(entry.status);
+        w.Put(",\"bytes\":");
+        w.Num(static_cast<long long>(entry.bytes));
+        w.Put(",\"referer\":\"");
+        w.Escaped(entry.referer, FIELD_MAX_LEN, true);
+        w.Put("\",\"user_agent\":\"");
+        w.Escaped(entry.userAgent, FIELD_MAX_LEN, true);
+        w.Put("\",\"ttfb_us\":");
+        w.Num(ttfbUs);
+        w.Put(",\"total_us\":");
+        w.Num(totalUs);
+        w.Putc('}');
+    } else {
+        w.Put(ip);
+        w.Put(" - - [");
+        w.Put(t_time.Get(time(nullptr), "%d/%b/%Y:%H:%M:%S %z"));
+        w.Put("] \"");
+        if (entry.method.empty()) {
+            w.Putc('-');
+        } else {
+            w.Escaped(entry.method, FIELD_MAX_LEN, false);
+            w.Putc(' ');
+            w.Escaped(entry.target, FIELD_MAX_LEN, false);
+            w.Put(" HTTP/");
+            w.Escaped(entry.version, FIELD_MAX_LEN, false);
+        }
+        w.Put("\" ");
+        w.Num(entry.status);
+        w.Putc(' ');
+        w.Num(static_cast<long long>(entry.bytes));
+        if (format_ == COMBINED) {
+            w.Put(" \"");
+            w.Field(entry.referer, FIELD_MAX_LEN);
+            w.Put("\" \"");
+            w.Field(entry.userAgent, FIELD_MAX_LEN);
+            w.Putc('"');
+        }
+        w.Putc(' ');
+        w.Num(ttfbUs);
+        w.Putc(' ');
+        w.Num(totalUs);
+    }
+    line[w.len++] = '\n';
+    Sink_()->Append_(1, line, w.len);
+}
+
+/**
+ * @brief 等待此前写入的行都已写入文件
+ *
+ */
+void AccessLog::Flush() {
+    Sink_()->flush();
+}
+
+/**
+ * @brief 各线程的环中等待写入的字节数
+ *
+ * @return size_t
+ */
+size_t AccessLog::QueueBytes() {
+    return Sink_()->QueueBytes();
+}
+
+/**
+ * @brief 访问日志专用的Log实例
+ *
+ * @return Log*
+ */
+Log *AccessLog::Sink_() {
+    static Log inst(1);
+    return &inst;
+}
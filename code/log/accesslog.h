@@ -0,0 +1,100 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>   //sockaddr_in
+
+class Log;
+struct LogFileOptions;
+
+//访问日志,每个发送完毕的请求一行,由WebServer::OnWrite_在一批响应发送完时写入
+//行在处理请求的线程中格式化后追加到一个独立Log实例的本线程环中,与普通日志一样由写线程批量写入
+//各格式在末尾(JSON为对应字段)附加首字节时间与总服务时间(微秒),均从读到请求的时刻算起,用单调时钟测量:
+//  COMMON   host - - [time] "request" status bytes ttfb_us total_us
+//  COMBINED host - - [time] "request" status bytes "referer" "user-agent" ttfb_us total_us
+//  JSON     {"time":..,"remote_addr":..,"method":..,"target":..,"protocol":..,"status":..,"bytes":..,
+//            "referer":..,"user_agent":..,"ttfb_us":..,"total_us":..}
+class AccessLog {
+public:
+    enum Format {
+        COMMON,
+        COMBINED,
+        JSON,
+    };
+
+    /* 一个请求的信息,由HttpConn在生成响应时填写,字符串在连接的多次请求间复用容量 */
+    struct Entry {
+        std::string method;
+        std::string target;
+        std::string version;
+        std::string referer;
+        std::string userAgent;
+        int status;
+        size_t bytes;       //响应头与响应体的总字节数
+        int64_t startNs;    //读到请求的时刻, NowNs
+    };
+
+    /**
+     * @param format 行格式
+     * @param sampleRate 每sampleRate个请求记录一个, 1表示全部记录
+     * @param maxQueueCapacity 每个线程的环可容纳的行数, 0表示同步写入
+     * @param cpu 写线程绑定的CPU
+     */
+    static void Init(Format format, int sampleRate, const char *path = "./log",
+                     const char *suffix = ".access.log", int maxQueueCapacity = 1024, int cpu = -1);
+
+    /**
+     * @param name "common", "combined"或"json"
+     * @return 名称是否有效
+     */
+    static bool ParseFormat(const std::string &name, Format *format);
+
+    /**
+     * 文件的切换、归档与写入方式,需在Init之前设置才对Init打开的文件生效
+     */
+    static void SetFileOptions(const LogFileOptions &options);
+
+    static bool IsOpen() { return sampleRate_ > 0; }
+
+    /**
+     * 按1/sampleRate抽样,每个线程单独计数
+     * @return 本次请求是否记录
+     */
+    static bool Sample();
+
+    /**
+     * 单调时钟,纳秒
+     */
+    static int64_t NowNs();
+
+    /**
+     * @param addr 客户端地址
+     * @param entry 请求
+     * @param firstByteNs 发出响应第一个字节的时刻, 0表示未知
+     * @param doneNs 响应全部发出的时刻
+     */
+    static void Write(const sockaddr_in &addr, const Entry &entry, int64_t firstByteNs, int64_t doneNs);
+
+    /**
+     * 等待此前写入的行都已写入文件
+     */
+    static void Flush();
+
+    /**
+     * 各线程的环中等待写入的字节数
+     */
+    static size_t QueueBytes();
+
+private:
+    static Log *Sink_();
+
+    static const int LINE_MAX_LEN = 4096;
+    static const size_t FIELD_MAX_LEN = 512;    //单个字符串字段转义后的最大长度,超出部分被截断,保证一行不超过LINE_MAX_LEN
+
+    static Format format_;
+    static int sampleRate_;    //0表示未打开
+};
+
+#endif //ACCESS_LOG_H
@@ -1,253 +1,554 @@
 #include "log.h"
+#include "../affinity/cpuaffinity.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <limits.h>
+#include <errno.h>
+#include <algorithm>
+#include <chrono>
 
 using namespace std;
 
+namespace {
+/* 线程退出时把自己的环标记为已关闭,写线程取空后回收 */
+struct RingHolder {
+    shared_ptr <LogRing> ring;
+
+    ~RingHolder() {
+        if (ring) { ring->closed.store(true, memory_order_release); }
+    }
+};
+
+thread_local RingHolder t_ring[Log::MAX_SLOTS];
+
+thread_local LogFormat::TimeCache t_time;
+}
+
 /**
  * @brief Construct a new Log:: Log object
- * 
+ *
  */
-Log::Log() {
+Log::Log(int slot) {
+    assert(slot >= 0 && slot < MAX_SLOTS);
+    slot_ = slot;
     lineCount_ = 0;
+    fileIndex_ = 0;
+    isOpen_ = false;
+    level_ = 1;
     isAsync_ = false;
+    isBinary_ = false;
+    cpu_ = -1;
+    ringSize_ = 1024 * AVG_LINE_LEN;
     writeThread_ = nullptr;
-    deque_ = nullptr;
     toDay_ = 0;
-    fp_ = nullptr;
+    fd_ = -1;
+    fileBytes_ = 0;
+    map_ = nullptr;
+    mapOff_ = mapLen_ = 0;
+    mapped_ = false;
+    flushReq_ = 0;
+    flushDone_ = 0;
+    closing_ = false;
+    sitesWritten_ = 0;
+    siteCount_ = 0;
 }
 
 /**
  * @brief Destroy the Log:: Log object
- * 
+ *
  */
 Log::~Log() {
     //检查是否已经创建写线程
     if (writeThread_ && writeThread_->joinable()) {
-        while (!deque_->empty()) {
-            deque_->flush();
-        };
-        //确保所有的日志消息都被写入磁盘，以避免丢失数据
-        deque_->Close();        //关闭写入队列
+        //写线程取空所有的环后退出,确保所有的日志消息都被写入磁盘
+        {
+            lock_guard <mutex> locker(waitMtx_);
+            closing_ = true;
+        }
+        writerCond_.notify_one();
         writeThread_->join();   //等待写线程退出
     }
-    if (fp_) {  //如果文件指针fp_非空
-        //加锁以确保线程安全
-        lock_guard <mutex> locker(mtx_);
-        flush();    //刷新文件缓冲区
-        fclose(fp_);//关闭文件指针
-    }
+    lock_guard <mutex> locker(fileMtx_);
+    CloseFile_();
 }
 
 /**
- * @brief 获取当前日志的级别
- * 
- * @return int 
+ * @brief 设置日志级别
+ *
+ * @param level
  */
-int Log::GetLevel() {
-    lock_guard <mutex> locker(mtx_);
-    return level_;
+void Log::SetLevel(int level) {
+    //写日志的线程只原子地读取level_,不需要加锁
+    level_.store(level, memory_order_relaxed);
 }
 
 /**
- * @brief 设置日志级别
- * 
- * @param level 
+ * @brief 设置文件的切换、归档与写入方式
+ *
+ * @param options
  */
-void Log::SetLevel(int level) {
-    //对mtx_进行加锁，以确保线程安全
-    lock_guard <mutex> locker(mtx_);
-    //将类成员变量level_设置为参数level，以更改日志级别
-    level_ = level;
-    //在函数退出之前，std::lock_guard对象会自动解锁mtx_
+void Log::SetFileOptions(const LogFileOptions &options) {
+    lock_guard <mutex> locker(fileMtx_);
+    options_ = options;
 }
 
 /**
- * @brief 日志类初始化,设置日志级别、路径、文件名后缀和最大队列大小
- * 
- * @param level 
- * @param path 
- * @param suffix 
- * @param maxQueueSize 
+ * @brief 日志类初始化,设置日志级别、路径、文件名后缀和每个线程的环的容量
+ *
+ * @param level
+ * @param path
+ * @param suffix
+ * @param maxQueueSize 每个线程的环可容纳的日志行数, 0表示同步写入
+ * @param cpu 异步写线程绑定的CPU,只在首次创建写线程时生效
+ * @param binary 以二进制格式写日志,文件用logdecode转换为文本
  */
 void Log::init(int level = 1, const char *path, const char *suffix,
-               int maxQueueSize) {
+               int maxQueueSize, int cpu, bool binary) {
+    //先把此前异步写入的日志写入旧文件
+    flush();
     isOpen_ = true;     //表示打开日志文件
-    level_ = level;
+    SetLevel(level);
     if (maxQueueSize > 0) {
-        //启用异步写入方式
-        isAsync_ = true;
-        if (!deque_) {
-            //使用unique_ptr来管理这些对象的生命周期，以避免内存泄漏
-            unique_ptr <BlockDeque<std::string>> newDeque(new BlockDeque<std::string>);
-            deque_ = move(newDeque);
-
-            std::unique_ptr <std::thread> NewThread(new thread(FlushLogThread));
-            writeThread_ = move(NewThread);
+        //启用异步写入方式,已经创建的环保持原来的容量
+        ringSize_ = static_cast<size_t>(maxQueueSize) * AVG_LINE_LEN;
+        if (!writeThread_) {
+            cpu_ = cpu;
+            writeThread_.reset(new thread(&Log::WriterThread_, this));
         }
+        isAsync_ = true;
     } else {
         //启用同步写入方式
         isAsync_ = false;
     }
-    //将lineCount_计数器重置为0
-    lineCount_ = 0;
 
     //获取当前时间并根据时间设置日志文件名
     time_t timer = time(nullptr);
-    struct tm *sysTime = localtime(&timer);
-    struct tm t = *sysTime;
+    struct tm t;
+    localtime_r(&timer, &t);
+    lock_guard <mutex> locker(fileMtx_);
     path_ = path;
     suffix_ = suffix;
-    char fileName[LOG_NAME_LEN] = {0};
-    //格式化出文件名
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s",
-             path_, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, suffix_);
+    isBinary_ = binary;
     toDay_ = t.tm_mday;
+    fileIndex_ = 0;
+    CloseFile_();
+    OpenFile_(t, false);
+}
 
-    {
-        lock_guard <mutex> locker(mtx_);    //对日志对象的互斥量mtx_加锁
-        buff_.RetrieveAll();                //将缓冲区buff_清空并关闭当前打开的文件fp_
-        if (fp_) {
-            flush();
-            fclose(fp_);
+/**
+ * @brief 按toDay_和fileIndex_打开日志文件,调用者需持有fileMtx_
+ * 已压缩过的序号总是跳过,以免之后的压缩覆盖旧的归档;切换时还跳过已存在的文件,重启后init仍追加到当天的第一个文件
+ *
+ * @param t 当前时间
+ * @param fresh 是否为切换出的新文件
+ */
+void Log::OpenFile_(const struct tm &t, bool fresh) {
+    char fileName[LOG_NAME_LEN] = {0};
+    while (true) {
+        //格式化出文件名,当天的第一个文件不带序号
+        if (fileIndex_ == 0) {
+            snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s",
+                     path_, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, suffix_);
+        } else {
+            snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d-%d%s",
+                     path_, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, fileIndex_, suffix_);
+        }
+        string name = fileName;
+        if ((!fresh || access(fileName, F_OK) != 0) &&
+            access((name + ".gz").c_str(), F_OK) != 0 && access((name + ".zst").c_str(), F_OK) != 0) {
+            break;
         }
+        fileIndex_++;
+    }
+    lineCount_ = 0;
+    fileName_ = fileName;
+
+    //重新打开一个新的日志文件，如果文件不存在，则需要先创建它;mmap模式需要可读写且不能用O_APPEND
+    mapped_ = options_.useMmap;
+    int flags = mapped_ ? (O_RDWR | O_CREAT | O_CLOEXEC) : (O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC);
+    fd_ = open(fileName, flags, 0644);
+    if (fd_ < 0) {
+        //如果文件创建失败，则需要使用mkdir函数尝试创建目录，以确保能够正确写入日志
+        mkdir(path_, 0777);
+        fd_ = open(fileName, flags, 0644);
+    }
+    assert(fd_ >= 0);
+    struct stat st;
+    fileBytes_ = fstat(fd_, &st) == 0 ? st.st_size : 0;
+    if (mapped_) { lseek(fd_, fileBytes_, SEEK_SET); }
+    //二进制文件的开头写入MAGIC,之后所有调用点的定义都要在新文件中重新写一次
+    sitesWritten_ = 0;
+    if (isBinary_ && fileBytes_ == 0) {
+        struct iovec iov = {const_cast<char *>(LogFormat::MAGIC), sizeof(LogFormat::MAGIC)};
+        WriteBytes_(&iov, 1, sizeof(LogFormat::MAGIC));
+    }
+}
 
-        //重新打开一个新的日志文件，如果文件不存在，则需要先创建它
-        fp_ = fopen(fileName, "a");
-        if (fp_ == nullptr) {
-            //如果文件创建失败，则需要使用mkdir函数尝试创建目录，以确保能够正确写入日志
-            mkdir(path_, 0777);
-            fp_ = fopen(fileName, "a");
+/**
+ * @brief 关闭当前文件,mmap模式下先解除映射并截掉预分配的部分,调用者需持有fileMtx_
+ *
+ */
+void Log::CloseFile_() {
+    if (fd_ < 0) { return; }
+    if (map_) {
+        munmap(map_, mapLen_);
+        map_ = nullptr;
+        mapOff_ = mapLen_ = 0;
+    }
+    if (mapped_) {
+        int ret = ftruncate(fd_, fileBytes_);
+        (void) ret;
+    }
+    close(fd_);
+    fd_ = -1;
+}
+
+/**
+ * @brief 在文件末尾追加iov,mmap模式下直接复制到映射区,否则用writev并处理部分写入;iov会被修改
+ *
+ * @param iov
+ * @param iovcnt
+ * @param bytes iov的总长度
+ */
+void Log::WriteBytes_(struct iovec *iov, int iovcnt, size_t bytes) {
+    if (mapped_ && MapFor_(bytes)) {
+        char *dst = map_ + (fileBytes_ - mapOff_);
+        for (int i = 0; i < iovcnt; i++) {
+            memcpy(dst, iov[i].iov_base, iov[i].iov_len);
+            dst += iov[i].iov_len;
         }
-        assert(fp_ != nullptr);
+        fileBytes_ += bytes;
+        return;
     }
+    //处理部分写入
+    while (bytes > 0) {
+        ssize_t len = writev(fd_, iov, iovcnt);
+        if (len < 0) {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+        bytes -= len;
+        fileBytes_ += len;
+        while (iovcnt > 0 && static_cast<size_t>(len) >= iov->iov_len) {
+            len -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + len;
+            iov->iov_len -= len;
+        }
+    }
+}
+
+/**
+ * @brief 保证[fileBytes_, fileBytes_ + bytes)已映射,不够时预分配并重新映射;失败时退回writev
+ *
+ * @param bytes 将要追加的字节数
+ * @return bool 是否可以直接memcpy
+ */
+bool Log::MapFor_(size_t bytes) {
+    if (map_ && fileBytes_ + bytes <= mapOff_ + mapLen_) { return true; }
+    if (map_) {
+        munmap(map_, mapLen_);
+        map_ = nullptr;
+    }
+    static const size_t PAGE = sysconf(_SC_PAGESIZE);
+    size_t off = fileBytes_ & ~(PAGE - 1);
+    //每次映射MMAP_CHUNK,设置了maxFileBytes时不超出文件切换前的长度
+    size_t chunk = MMAP_CHUNK;
+    if (options_.maxFileBytes > 0 && options_.maxFileBytes > off) { chunk = min(chunk, options_.maxFileBytes - off); }
+    size_t len = max(chunk, fileBytes_ + bytes - off);
+    len = (len + PAGE - 1) & ~(PAGE - 1);
+    //先分配磁盘空间,磁盘满时不会在memcpy中收到SIGBUS;进程崩溃时文件末尾会留下预分配的零字节
+    void *addr = MAP_FAILED;
+    if (posix_fallocate(fd_, off, len) == 0) {
+        addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, off);
+    }
+    if (addr == MAP_FAILED) {
+        mapped_ = false;
+        int ret = ftruncate(fd_, fileBytes_);
+        (void) ret;
+        lseek(fd_, fileBytes_, SEEK_SET);
+        return false;
+    }
+    map_ = static_cast<char *>(addr);
+    mapOff_ = off;
+    mapLen_ = len;
+    return true;
 }
 
 /**
  * @brief 往日志中写入一条日志信息
- * 
+ * 异步模式下只格式化到栈上并追加到本线程的环中,不加锁
+ *
  * @param level 指定了日志的等级
  * @param format 指定了日志的具体格式
- * @param ... 
+ * @param ...
  */
 void Log::write(int level, const char *format, ...) {
-    struct timeval now = {0, 0};
-    gettimeofday(&now, nullptr);    //获取当前时间
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);    //vDSO,不进入内核
+
+    /* 时间 日志级别 内容,末尾留出换行符的位置;日期到秒取自本线程的缓存,只格式化微秒 */
+    char line[LINE_MAX_LEN];
+    memcpy(line, t_time.Get(now.tv_sec, LogFormat::TIME_PREFIX_FORMAT), LogFormat::TIME_PREFIX_LEN);
+    int n = LogFormat::TIME_PREFIX_LEN;
+    line[n++] = '.';
+    long usec = now.tv_nsec / 1000;
+    for (int i = 5; i >= 0; i--, usec /= 10) { line[n + i] = static_cast<char>('0' + usec % 10); }
+    n += 6;
+    line[n++] = ' ';
+    const char *title = LogFormat::LevelTitle(level);
+    size_t titleLen = strlen(title);
+    memcpy(line + n, title, titleLen);
+    n += titleLen;
     va_list vaList;
+    va_start(vaList, format);
+    int m = vsnprintf(line + n, LINE_MAX_LEN - 1 - n, format, vaList);
+    va_end(vaList);
+    size_t len = n + min(max(m, 0), LINE_MAX_LEN - 2 - n);
+    line[len++] = '\n';
+    Append_(level, line, len);
+}
 
-    /* 日志日期 日志行数 */
-    // 判断是否需要在新的文件中写日志
-    if (toDay_ != t.tm_mday || (lineCount_ && (lineCount_ % MAX_LINES == 0))) {
-        unique_lock <mutex> locker(mtx_);
-        locker.unlock();
+/**
+ * @brief 把一条完整的日志行(或二进制记录)追加到本线程的环中,同步模式下直接写入文件
+ *
+ * @param level 日志级别
+ * @param data
+ * @param len
+ */
+void Log::Append_(int level, const char *data, size_t len) {
+    if (isAsync_) {
+        LogRing *ring = LocalRing_();
+        size_t size;
+        while ((size = ring->TryPush(data, len)) == 0) {
+            //环已满,唤醒写线程并等待其取走
+            writerCond_.notify_one();
+            this_thread::yield();
+        }
+        //刚超过半满或是错误日志时提前唤醒写线程,其余情况由写线程定时取走
+        size_t half = ring->Capacity() / 2;
+        if (level >= 3 || (size > half && size - len <= half)) {
+            writerCond_.notify_one();
+        }
+    } else {
+        struct iovec iov = {const_cast<char *>(data), len};
+        lock_guard <mutex> locker(fileMtx_);
+        WriteFile_(&iov, 1, len);
+    }
+}
 
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        // 按照一定的格式生成新的日志文件名
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+/**
+ * @brief 登记一个二进制日志的调用点
+ *
+ * @param format 格式串
+ * @param file 所在文件
+ * @param line 所在行
+ * @param signature 各参数的类型串
+ * @return uint32_t 调用点id
+ */
+uint32_t Log::RegisterSite(const char *format, const char *file, int line, const char *signature) {
+    Log *log = Instance();
+    lock_guard <mutex> locker(log->siteMtx_);
+    log->sites_.push_back({format, file, line, signature});
+    //写线程先取环中的数据再读siteCount_,因此写入某条记录时一定能看到其调用点
+    log->siteCount_.store(log->sites_.size(), memory_order_release);
+    return static_cast<uint32_t>(log->sites_.size() - 1);
+}
 
-        if (toDay_ != t.tm_mday) {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-            toDay_ = t.tm_mday;
-            lineCount_ = 0;
-        } else {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail, (lineCount_ / MAX_LINES), suffix_);
-        }
+/**
+ * @brief 等待此前写入的日志都已写入文件,同步模式下直接返回
+ *
+ */
+void Log::flush() {
+    if (!isAsync_ || !writeThread_) { return; }
+    unique_lock <mutex> locker(waitMtx_);
+    uint64_t req = ++flushReq_;
+    writerCond_.notify_one();
+    flushCond_.wait(locker, [this, req] { return flushDone_ >= req; });
+}
 
-        locker.lock();
-        flush();
-        fclose(fp_);
-        // 打开新的日志文件
-        fp_ = fopen(newFile, "a");
-        assert(fp_ != nullptr);
+/**
+ * @brief 各线程的环中等待写线程取走的字节数
+ *
+ * @return size_t
+ */
+size_t Log::QueueBytes() {
+    lock_guard <mutex> locker(ringMtx_);
+    size_t bytes = 0;
+    for (const shared_ptr <LogRing> &ring : rings_) { bytes += ring->Size(); }
+    return bytes;
+}
+
+/**
+ * @brief 本线程的环,首次调用时创建并登记
+ *
+ * @return LogRing*
+ */
+LogRing *Log::LocalRing_() {
+    RingHolder &holder = t_ring[slot_];
+    if (!holder.ring) {
+        holder.ring = make_shared<LogRing>(ringSize_);
+        lock_guard <mutex> locker(ringMtx_);
+        rings_.push_back(holder.ring);
     }
+    return holder.ring.get();
+}
 
+/**
+ * @brief 取空所有的环,一次writev写入文件,并回收所属线程已退出的环
+ *
+ * @return size_t 写入的字节数
+ */
+size_t Log::Drain_() {
+    vector <shared_ptr<LogRing>> rings;
     {
-        unique_lock <mutex> locker(mtx_);
-        lineCount_++;
-        int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-                         t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-                         t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
-
-        buff_.HasWritten(n);
-        // 添加日志级别到缓存中
-        AppendLogLevelTitle_(level);
-
-        va_start(vaList, format);
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
-        va_end(vaList);
-
-        buff_.HasWritten(m);
-        buff_.Append("\n\0", 2);
-
-        // 如果开启异步模式，则将日志添加到阻塞队列中，否则直接写入文件
-        if (isAsync_ && deque_ && !deque_->full()) {
-            deque_->push_back(buff_.RetrieveAllToStr());
-        } else {
-            fputs(buff_.Peek(), fp_);
+        lock_guard <mutex> locker(ringMtx_);
+        rings = rings_;
+    }
+    const size_t GROUP = (IOV_MAX - 1) / 2;    //每个环最多两段,二进制模式下留出一段给调用点的定义
+    struct iovec iov[GROUP * 2];
+    size_t taken[GROUP];
+    bool closed[GROUP];
+    size_t total = 0, reclaim = 0;
+    for (size_t start = 0; start < rings.size(); start += GROUP) {
+        size_t end = min(rings.size(), start + GROUP);
+        int iovcnt = 0;
+        size_t bytes = 0;
+        for (size_t i = start; i < end; i++) {
+            //先读关闭标记再取数据,关闭之后不会再有新数据
+            closed[i - start] = rings[i]->closed.load(memory_order_acquire);
+            iovcnt += rings[i]->Peek(iov + iovcnt, taken[i - start]);
+            bytes += taken[i - start];
+        }
+        if (bytes > 0) {
+            lock_guard <mutex> locker(fileMtx_);
+            WriteFile_(iov, iovcnt, bytes);
         }
-        buff_.RetrieveAll();
+        for (size_t i = start; i < end; i++) {
+            rings[i]->Consume(taken[i - start]);
+            if (closed[i - start]) { reclaim++; }
+        }
+        total += bytes;
+    }
+    if (reclaim > 0) {
+        lock_guard <mutex> locker(ringMtx_);
+        rings_.erase(remove_if(rings_.begin(), rings_.end(), [](const shared_ptr <LogRing> &ring) {
+            return ring->closed.load(memory_order_acquire) && ring->Size() == 0;
+        }), rings_.end());
     }
+    return total;
 }
 
 /**
- * @brief 在日志消息中添加与日志级别相对应的前缀
- * 
- * @param level 日志级别
+ * @brief 把一批完整的日志行写入文件,调用者需持有fileMtx_
+ * 日期变化、文件将超过maxFileBytes(未设置时为行数达到MAX_LINES)时先切换文件,切换下来的文件交给归档线程;
+ * 一批数据总是写入同一个文件,文件可能超过maxFileBytes一批的长度
+ * 二进制模式下先写入这批记录可能用到的、当前文件中还没有的调用点定义,且不按行数切换文件
+ *
+ * @param iov
+ * @param iovcnt
+ * @param bytes iov的总长度
  */
-void Log::AppendLogLevelTitle_(int level) {
-    switch (level) {
-        case 0:
-            buff_.Append("[debug]: ", 9);
-            break;
-        case 1:
-            buff_.Append("[info] : ", 9);
-            break;
-        case 2:
-            buff_.Append("[warn] : ", 9);
-            break;
-        case 3:
-            buff_.Append("[error]: ", 9);
-            break;
-        default:
-            buff_.Append("[info] : ", 9);
-            break;
+void Log::WriteFile_(const struct iovec *iov, int iovcnt, size_t bytes) {
+    time_t timer = time(nullptr);
+    struct tm t;
+    localtime_r(&timer, &t);
+    // 判断是否需要在新的文件中写日志
+    bool full = options_.maxFileBytes > 0
+                ? fileBytes_ > (isBinary_ ? sizeof(LogFormat::MAGIC) : 0) && fileBytes_ + bytes > options_.maxFileBytes
+                : !isBinary_ && lineCount_ >= MAX_LINES;
+    if (toDay_ != t.tm_mday || full) {
+        if (toDay_ != t.tm_mday) {
+            toDay_ = t.tm_mday;
+            fileIndex_ = 0;
+        } else {
+            fileIndex_++;
+        }
+        string old = fileName_;
+        CloseFile_();
+        OpenFile_(t, true);
+        archiver_.Submit(old, path_, suffix_, fileName_.substr(fileName_.rfind('/') + 1),
+                         options_.compress, options_.keepFiles);
     }
+
+    struct iovec rest[IOV_MAX];
+    struct iovec *cur = rest;
+    string defs;
+    if (isBinary_) {
+        AppendSiteDefs_(defs);
+        if (!defs.empty()) {
+            rest[0] = {&defs[0], defs.size()};
+            cur++;
+            bytes += defs.size();
+        }
+    } else {
+        for (int i = 0; i < iovcnt; i++) {
+            const char *base = static_cast<const char *>(iov[i].iov_base);
+            lineCount_ += count(base, base + iov[i].iov_len, '\n');
+        }
+    }
+    copy(iov, iov + iovcnt, cur);
+    iovcnt += cur - rest;
+    WriteBytes_(rest, iovcnt, bytes);
 }
 
 /**
- * @brief 刷新缓冲区中的数据
- * 
+ * @brief 把当前文件中还没有的调用点定义编码后追加到out,调用者需持有fileMtx_
+ *
+ * @param out
  */
-void Log::flush() {
-    if (isAsync_) {
-        //将日志队列中的所有数据刷新到文件
-        deque_->flush();
+void Log::AppendSiteDefs_(string &out) {
+    size_t count = siteCount_.load(memory_order_acquire);
+    if (sitesWritten_ >= count) { return; }
+    lock_guard <mutex> locker(siteMtx_);
+    for (; sitesWritten_ < count; sitesWritten_++) {
+        const Site &site = sites_[sitesWritten_];
+        uint32_t id = static_cast<uint32_t>(sitesWritten_), line = static_cast<uint32_t>(site.line);
+        LogFormat::RecordHeader head = {LogFormat::DEF_SITE, 0, 0, 0, 0};
+        size_t len = sizeof(head) + sizeof(id) + sizeof(line) +
+                     site.file.size() + site.format.size() + site.signature.size() + 3;
+        assert(len <= UINT16_MAX);
+        head.len = static_cast<uint16_t>(len);
+        out.append(reinterpret_cast<const char *>(&head), sizeof(head));
+        out.append(reinterpret_cast<const char *>(&id), sizeof(id));
+        out.append(reinterpret_cast<const char *>(&line), sizeof(line));
+        out.append(site.file.c_str(), site.file.size() + 1);
+        out.append(site.format.c_str(), site.format.size() + 1);
+        out.append(site.signature.c_str(), site.signature.size() + 1);
     }
-    //将缓冲区中的剩余数据写入文件
-    fflush(fp_);
 }
 
 /**
- * @brief 异步写日志
- * 
+ * @brief 写线程的主循环: 定时或被唤醒后取空所有的环,并通知等待flush的线程
+ *
  */
-void Log::AsyncWrite_() {
-    string str = "";
-    //使用一个循环不断地从阻塞队列中取出日志信息,直到队列为空
-    while (deque_->pop(str)) {
-        //使用lock_guard保护mtx_的锁
-        lock_guard <mutex> locker(mtx_);
-        //将字符串写入文件
-        fputs(str.c_str(), fp_);
+void Log::WriterLoop_() {
+    while (true) {
+        //此前flush的线程写入的日志在这一轮中都会被取走
+        uint64_t req = flushReq_.load();
+        size_t bytes = Drain_();
+        unique_lock <mutex> locker(waitMtx_);
+        if (flushDone_ < req) {
+            flushDone_ = req;
+            flushCond_.notify_all();
+        }
+        if (bytes == 0 && closing_) { break; }
+        //积压较多或有flush请求时立即开始下一轮,否则攒一批再写
+        if (bytes < ringSize_ / 2 && flushReq_.load() == flushDone_ && !closing_) {
+            writerCond_.wait_for(locker, chrono::milliseconds(FLUSH_INTERVAL_MS));
+        }
     }
 }
 
 /**
  * @brief 单例模式的实现
- * 
- * @return Log* 
+ *
+ * @return Log*
  */
 Log *Log::Instance() {
     //inst 保证了只有一个 Log 实例被创建
@@ -256,10 +557,19 @@ Log *Log::Instance() {
 }
 
 /**
- * @brief 后台刷新日志文件的线程
- * 
+ * @brief 后台写日志文件的线程
+ *
  */
 void Log::FlushLogThread() {
-    //AsyncWrite_该函数从异步队列中取出消息，然后将其写入日志文件
-    Log::Instance()->AsyncWrite_();
-}
\ No newline at end of file
+    Log::Instance()->WriterThread_();
+}
+
+/**
+ * @brief 本实例的写线程
+ *
+ */
+void Log::WriterThread_() {
+    CpuAffinity::PinThread(cpu_);
+    //WriterLoop_不断取空各线程的环,然后将其写入日志文件
+    WriterLoop_();
+}
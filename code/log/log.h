@@ -4,19 +4,46 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <condition_variable>
 #include <sys/time.h>
+#include <time.h>
 #include <string.h>
 #include <stdarg.h>           // vastart va_end
 #include <assert.h>
 #include <sys/stat.h>         //mkdir
-#include "blockqueue.h"
-#include "../buffer/buffer.h"
+#include <sys/uio.h>          //writev
+#include "logring.h"
+#include "logformat.h"
+#include "logarchiver.h"
+
+/* 日志文件的切换、归档与写入方式,在init之前设置时对init打开的文件生效,之后设置时从下一个文件开始生效 */
+struct LogFileOptions {
+    size_t maxFileBytes = 0;    //单个文件的最大字节数,达到后切换到新文件, 0表示按MAX_LINES行切换
+    int keepFiles = 0;          //保留的已切换文件个数, 0表示不删除
+    LogArchiver::Compress compress = LogArchiver::NONE;  //已切换的文件在后台压缩
+    bool useMmap = false;       //把文件末尾按块映射到内存后memcpy追加,代替writev
+};
 
+//异步模式下每个写日志的线程各有一个LogRing,格式化后整行追加到本线程的环中,不加锁也不进入内核;
+//写线程每FLUSH_INTERVAL_MS毫秒(或某个环超过半满、写入error日志时被提前唤醒)取空所有的环,
+//以一次writev写入文件;环满时写日志的线程唤醒写线程并让出CPU,直到有空间为止
+//同步模式(maxQueueCapacity为0)下直接写文件
+//二进制模式下每个调用点首次执行时登记格式串,之后只写入调用点id、时间戳和参数的原始字节(格式见logformat.h),
+//由logdecode工具离线还原为文本;写线程在写入用到新调用点的记录之前先写入其定义
+//文件按日期以及大小(或行数)切换,切换只在写线程(同步模式下为写日志的线程)中进行,旧文件交给LogArchiver在后台压缩和清理
 class Log {
 public:
+    /**
+     * @param maxQueueCapacity 每个线程的环可容纳的日志行数(按平均AVG_LINE_LEN字节估算), 0表示同步写入
+     * @param cpu 写线程绑定的CPU
+     * @param binary 以二进制格式写日志
+     */
     void init(int level, const char *path = "./log",
               const char *suffix = ".log",
-              int maxQueueCapacity = 1024);
+              int maxQueueCapacity = 1024, int cpu = -1, bool binary = false);
 
     static Log *Instance();
 
@@ -24,54 +51,156 @@ public:
 
     void write(int level, const char *format, ...);
 
+    /**
+     * 登记一个二进制日志的调用点,每个调用点只在首次执行时调用一次
+     * @param signature 各参数的类型串,见LogFormat::TypeCode
+     * @return 调用点id
+     */
+    static uint32_t RegisterSite(const char *format, const char *file, int line, const char *signature);
+
+    template<class... Args>
+    void WriteBinary(int level, uint32_t site, const Args &... args) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        char record[LINE_MAX_LEN];
+        size_t len = LogFormat::Encode(record, LINE_MAX_LEN, level, site,
+                                       now.tv_sec * 1000000000LL + now.tv_nsec, args...);
+        Append_(level, record, len);
+    }
+
+    /**
+     * 等待此前所有线程写入的日志都已写入文件
+     */
     void flush();
 
-    int GetLevel();
+    /**
+     * 只是一次原子读,可在每条日志前调用
+     */
+    int GetLevel() { return level_.load(std::memory_order_relaxed); }
 
     void SetLevel(int level);
 
+    void SetFileOptions(const LogFileOptions &options);
+
     bool IsOpen() { return isOpen_; }
 
+    bool IsBinary() { return isBinary_; }
+
+    size_t QueueBytes();
+
+    static const int MAX_SLOTS = 2;    //Log实例数的上限,每个线程为每个实例各有一个环
+
 private:
-    Log();
+    friend class AccessLog;     //访问日志使用独立的实例,有自己的文件、环和写线程
 
-    void AppendLogLevelTitle_(int level);
+    explicit Log(int slot = 0);
 
     virtual ~Log();
 
-    void AsyncWrite_();
+    LogRing *LocalRing_();
+
+    void Append_(int level, const char *data, size_t len);
+
+    void WriterThread_();
+
+    void WriterLoop_();
+
+    size_t Drain_();
+
+    void WriteFile_(const struct iovec *iov, int iovcnt, size_t bytes);
+
+    void OpenFile_(const struct tm &t, bool fresh);
+
+    void CloseFile_();
+
+    void WriteBytes_(struct iovec *iov, int iovcnt, size_t bytes);
+
+    bool MapFor_(size_t bytes);
+
+    void AppendSiteDefs_(std::string &out);
 
 private:
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
     static const int MAX_LINES = 50000;
+    static const int LINE_MAX_LEN = 4096;       //单行日志的最大长度,超出部分被截断
+    static const int AVG_LINE_LEN = 128;
+    static const int FLUSH_INTERVAL_MS = 20;
+    static const size_t MMAP_CHUNK = 4 << 20;  //mmap模式下每次映射并预分配的文件长度
 
     const char *path_;
     const char *suffix_;
 
-    int MAX_LINES_;
-
     int lineCount_;
+    int fileIndex_;    //当天因行数达到MAX_LINES而切换的文件序号
     int toDay_;
 
     bool isOpen_;
 
-    Buffer buff_;
-    int level_;
+    int slot_;         //本实例的环在各线程环数组中的下标
+    std::atomic<int> level_;
     bool isAsync_;
-
-    FILE *fp_;
-    std::unique_ptr <BlockDeque<std::string>> deque_;
+    bool isBinary_;
+    int cpu_;          //写线程绑定的CPU, -1表示不绑定
+    size_t ringSize_;  //新建的环的容量
+
+    int fd_;
+    std::string fileName_;
+    size_t fileBytes_;     //当前文件的有效长度
+    LogFileOptions options_;
+    /* mmap模式下映射的文件区间[mapOff_, mapOff_ + mapLen_),超出有效长度的部分已预分配,关闭文件时截掉 */
+    char *map_;
+    size_t mapOff_;
+    size_t mapLen_;
+    bool mapped_;          //当前文件以mmap方式写入,映射失败后退回writev
+    LogArchiver archiver_;
+    std::mutex fileMtx_;   //保护日志文件及其行数、日期、选项,只有写线程(同步模式下为写日志的线程)和init会持有
+    size_t sitesWritten_;  //当前文件中已写入定义的调用点数
+
+    /* 二进制日志的调用点,只增不减 */
+    struct Site {
+        std::string format;
+        std::string file;
+        int line;
+        std::string signature;
+    };
+    std::mutex siteMtx_;
+    std::vector <Site> sites_;
+    std::atomic <size_t> siteCount_;
+
+    /* 各线程的环,线程退出后由写线程取空并回收 */
+    std::mutex ringMtx_;
+    std::vector <std::shared_ptr<LogRing>> rings_;
+
+    /* 写线程的唤醒与flush的完成通知 */
+    std::mutex waitMtx_;
+    std::condition_variable writerCond_;
+    std::condition_variable flushCond_;
+    std::atomic <uint64_t> flushReq_;
+    uint64_t flushDone_;
+    std::atomic<bool> closing_;
     std::unique_ptr <std::thread> writeThread_;
-    std::mutex mtx_;
 };
 
+//编译期的最低日志级别,低于它的LOG_*调用连同Log::Instance()和参数的求值一起被编译器删除
+//默认保留全部级别;发布构建以-DLOG_MIN_LEVEL=1去掉LOG_DEBUG
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
 #define LOG_BASE(level, format, ...) \
     do {\
-        Log* log = Log::Instance();\
-        if (log->IsOpen() && log->GetLevel() <= level) {\
-            log->write(level, format, ##__VA_ARGS__); \
-            log->flush();\
+        if ((level) >= LOG_MIN_LEVEL) {\
+            Log* log = Log::Instance();\
+            if (log->IsOpen() && log->GetLevel() <= (level)) {\
+                if (log->IsBinary()) {\
+                    static const uint32_t logSite = Log::RegisterSite(format, __FILE__, __LINE__,\
+                            LogFormat::Signature<decltype(LogFormat::Types(__VA_ARGS__))>::value);\
+                    log->WriteBinary(level, logSite, ##__VA_ARGS__);\
+                } else {\
+                    log->write(level, format, ##__VA_ARGS__); \
+                }\
+            }\
         }\
     } while(0);
 
@@ -80,4 +209,4 @@ private:
 #define LOG_WARN(format, ...) do {LOG_BASE(2, format, ##__VA_ARGS__)} while(0);
 #define LOG_ERROR(format, ...) do {LOG_BASE(3, format, ##__VA_ARGS__)} while(0);
 
-#endif //LOG_H
\ No newline at end of file
+#endif //LOG_H
@@ -0,0 +1,215 @@
+#include "logarchiver.h"
+
+#include <zlib.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+extern char **environ;
+
+/**
+ * @brief 由配置中的名称得到压缩方式
+ *
+ * @param name
+ * @param compress
+ * @return bool 名称是否有效
+ */
+bool LogArchiver::ParseCompress(const string &name, Compress *compress) {
+    if (name.empty()) {
+        *compress = NONE;
+    } else if (name == "gzip") {
+        *compress = GZIP;
+    } else if (name == "zstd") {
+        *compress = ZSTD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+LogArchiver::~LogArchiver() {
+    if (thread_) {
+        {
+            lock_guard <mutex> locker(mtx_);
+            closing_ = true;
+        }
+        cond_.notify_one();
+        thread_->join();
+    }
+}
+
+/**
+ * @brief 把切换下来的文件交给归档线程
+ *
+ */
+void LogArchiver::Submit(const string &file, const string &dir, const string &suffix,
+                         const string &current, Compress compress, int keepFiles) {
+    if (compress == NONE && keepFiles <= 0) { return; }
+    lock_guard <mutex> locker(mtx_);
+    jobs_.push_back({file, dir, suffix, current, compress, keepFiles});
+    if (!thread_) {
+        thread_.reset(new thread(&LogArchiver::Loop_, this));
+    }
+    cond_.notify_one();
+}
+
+/**
+ * @brief 等待队列为空且没有正在处理的文件
+ *
+ */
+void LogArchiver::Wait() {
+    unique_lock <mutex> locker(mtx_);
+    idleCond_.wait(locker, [this] { return jobs_.empty() && !busy_; });
+}
+
+/**
+ * @brief 归档线程: 依次压缩提交的文件并清理旧文件,关闭时先处理完队列
+ *
+ */
+void LogArchiver::Loop_() {
+    unique_lock <mutex> locker(mtx_);
+    while (true) {
+        cond_.wait(locker, [this] { return !jobs_.empty() || closing_; });
+        if (jobs_.empty()) { break; }
+        Job job = move(jobs_.front());
+        jobs_.pop_front();
+        busy_ = true;
+        locker.unlock();
+        if (job.compress != NONE) {
+            CompressFile(job.file, job.compress);
+        }
+        if (job.keepFiles > 0) {
+            Prune(job.dir, job.suffix, job.current, job.keepFiles);
+        }
+        locker.lock();
+        busy_ = false;
+        if (jobs_.empty()) { idleCond_.notify_all(); }
+    }
+}
+
+/**
+ * @brief 压缩一个文件,成功后删除原文件
+ *
+ * @param file
+ * @param compress
+ * @return string 压缩后的文件路径,失败时为空串
+ */
+string LogArchiver::CompressFile(const string &file, Compress compress) {
+    if (compress == GZIP) {
+        string out = file + ".gz";
+        if (!Gzip_(file, out)) { return ""; }
+        unlink(file.c_str());
+        return out;
+    }
+    if (compress == ZSTD && Zstd_(file)) {
+        return file + ".zst";
+    }
+    return "";
+}
+
+/**
+ * @brief 用zlib把file压缩为out,先写入临时文件再改名,中途失败时不留下不完整的.gz
+ *
+ * @return bool
+ */
+bool LogArchiver::Gzip_(const string &file, const string &out) {
+    int in = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) { return false; }
+    string tmp = out + ".tmp";
+    gzFile gz = gzopen(tmp.c_str(), "wb6");
+    bool ok = gz != nullptr;
+    char buf[64 << 10];
+    ssize_t len = 0;
+    while (ok && (len = read(in, buf, sizeof(buf))) > 0) {
+        ok = gzwrite(gz, buf, static_cast<unsigned>(len)) == len;
+    }
+    ok = ok && len == 0;
+    close(in);
+    if (gz && gzclose(gz) != Z_OK) { ok = false; }
+    if (ok && rename(tmp.c_str(), out.c_str()) == 0) { return true; }
+    unlink(tmp.c_str());
+    return false;
+}
+
+/**
+ * @brief 调用zstd命令压缩,成功后由zstd删除原文件
+ *
+ * @return bool
+ */
+bool LogArchiver::Zstd_(const string &file) {
+    const char *argv[] = {"zstd", "-q", "-f", "--rm", file.c_str(), nullptr};
+    pid_t pid;
+    if (posix_spawnp(&pid, "zstd", nullptr, nullptr, const_cast<char **>(argv), environ) != 0) {
+        return false;
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+namespace {
+/* 日志文件名"YYYY_MM_DD[-N]<suffix>[.gz|.zst]"的排序键,不匹配时返回false */
+bool ParseLogName(const char *name, const string &suffix, string *date, long *index) {
+    size_t len = strlen(name);
+    if (len < 10) { return false; }
+    for (int i = 0; i < 10; i++) {
+        bool sep = i == 4 || i == 7;
+        if (sep ? name[i] != '_' : !isdigit(static_cast<unsigned char>(name[i]))) { return false; }
+    }
+    const char *p = name + 10;
+    *index = 0;
+    if (*p == '-') {
+        char *end;
+        *index = strtol(p + 1, &end, 10);
+        if (end == p + 1) { return false; }
+        p = end;
+    }
+    if (strncmp(p, suffix.c_str(), suffix.size()) != 0) { return false; }
+    p += suffix.size();
+    if (*p != '\0' && strcmp(p, ".gz") != 0 && strcmp(p, ".zst") != 0) { return false; }
+    date->assign(name, 10);
+    return true;
+}
+}
+
+/**
+ * @brief 只保留最新的keepFiles个旧文件
+ *
+ */
+void LogArchiver::Prune(const string &dir, const string &suffix, const string &current, int keepFiles) {
+    DIR *d = opendir(dir.c_str());
+    if (!d) { return; }
+    struct Entry {
+        string date;
+        long index;
+        string name;
+    };
+    vector <Entry> files;
+    while (struct dirent *entry = readdir(d)) {
+        Entry e;
+        if (entry->d_name != current && ParseLogName(entry->d_name, suffix, &e.date, &e.index)) {
+            e.name = entry->d_name;
+            files.push_back(move(e));
+        }
+    }
+    closedir(d);
+    if (files.size() <= static_cast<size_t>(keepFiles)) { return; }
+    sort(files.begin(), files.end(), [](const Entry &a, const Entry &b) {
+        return a.date != b.date ? a.date < b.date : a.index < b.index;
+    });
+    for (size_t i = 0; i + keepFiles < files.size(); i++) {
+        unlink((dir + "/" + files[i].name).c_str());
+    }
+}
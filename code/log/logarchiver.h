@@ -0,0 +1,84 @@
+#ifndef LOG_ARCHIVER_H
+#define LOG_ARCHIVER_H
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+
+//日志文件的后台归档: 切换下来的旧文件在单独的线程中压缩,再按保留个数删除最旧的文件
+//写日志的路径上只有Submit的一次入队,压缩、扫描目录与删除都不会阻塞写线程
+class LogArchiver {
+public:
+    enum Compress {
+        NONE,
+        GZIP,   //进程内用zlib压缩为.gz
+        ZSTD,   //调用zstd命令压缩为.zst,没有zstd时保留原文件
+    };
+
+    /**
+     * @param name "gzip", "zstd"或空串
+     * @return 名称是否有效
+     */
+    static bool ParseCompress(const std::string &name, Compress *compress);
+
+    LogArchiver() : busy_(false), closing_(false) {}
+
+    /**
+     * 处理完已提交的文件后退出
+     */
+    ~LogArchiver();
+
+    /**
+     * 提交一个刚切换下来的文件
+     * @param file 文件路径
+     * @param dir 日志目录,与suffix一起确定参与保留计数的文件: 日期[-序号]+suffix[.gz|.zst]
+     * @param current 正在写入的文件名,不参与保留计数
+     * @param keepFiles 保留的旧文件个数, 0表示不删除
+     */
+    void Submit(const std::string &file, const std::string &dir, const std::string &suffix,
+                const std::string &current, Compress compress, int keepFiles);
+
+    /**
+     * 等待已提交的文件都处理完毕
+     */
+    void Wait();
+
+    /**
+     * @return 压缩成功后的文件路径,失败时为空串
+     */
+    static std::string CompressFile(const std::string &file, Compress compress);
+
+    /**
+     * 删除dir下除current外最旧的文件,只保留keepFiles个;按文件名中的日期和序号排序
+     */
+    static void Prune(const std::string &dir, const std::string &suffix, const std::string &current, int keepFiles);
+
+private:
+    struct Job {
+        std::string file;
+        std::string dir;
+        std::string suffix;
+        std::string current;
+        Compress compress;
+        int keepFiles;
+    };
+
+    void Loop_();
+
+    static bool Gzip_(const std::string &file, const std::string &out);
+
+    static bool Zstd_(const std::string &file);
+
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::condition_variable idleCond_;
+    std::deque <Job> jobs_;
+    bool busy_;
+    bool closing_;
+    std::unique_ptr <std::thread> thread_;    //首次提交时创建
+};
+
+#endif //LOG_ARCHIVER_H
@@ -0,0 +1,216 @@
+#include "logdecoder.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+using namespace std;
+
+long long LogDecoder::Arg::AsInt() const {
+    return type == 'd' ? static_cast<long long>(d) : i;
+}
+
+double LogDecoder::Arg::AsDouble() const {
+    return type == 'd' ? d : static_cast<double>(i);
+}
+
+/**
+ * @brief 依次解码文件中的各条记录
+ *
+ * @param data 文件内容
+ * @param len 文件长度
+ * @param out 解码出的文本
+ * @return long 解码的记录数,出错时为-1;遇到全为0的尾部时停止
+ */
+long LogDecoder::Decode(const char *data, size_t len, string &out) {
+    if (len < sizeof(LogFormat::MAGIC) || memcmp(data, LogFormat::MAGIC, sizeof(LogFormat::MAGIC)) != 0) {
+        return -1;
+    }
+    long count = 0;
+    size_t pos = sizeof(LogFormat::MAGIC);
+    while (pos < len) {
+        //mmap模式下进程崩溃时文件尾部留有预分配的0,全为0的尾部是已写数据的结尾
+        if (data[pos] == '\0' && IsZero_(data + pos, len - pos)) { break; }
+        LogFormat::RecordHeader head;
+        if (len - pos < sizeof(head)) { return -1; }
+        memcpy(&head, data + pos, sizeof(head));
+        if (head.len < sizeof(head) || head.len > len - pos) { return -1; }
+        const char *body = data + pos + sizeof(head);
+        size_t bodyLen = head.len - sizeof(head);
+        if (head.site == LogFormat::DEF_SITE) {
+            if (!Define_(body, bodyLen)) { return -1; }
+        } else {
+            if (!Format_(head, body, bodyLen, out)) { return -1; }
+            count++;
+        }
+        pos += head.len;
+    }
+    return count;
+}
+
+/**
+ * @brief 判断一段数据是否全为0
+ *
+ * @return bool
+ */
+bool LogDecoder::IsZero_(const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != '\0') { return false; }
+    }
+    return true;
+}
+
+/**
+ * @brief 登记调用点的定义: id, 行号, 文件名, 格式串, 类型串
+ *
+ * @return bool 定义是否完整
+ */
+bool LogDecoder::Define_(const char *data, size_t len) {
+    uint32_t id, line;
+    if (len < sizeof(id) + sizeof(line)) { return false; }
+    memcpy(&id, data, sizeof(id));
+    memcpy(&line, data + sizeof(id), sizeof(line));
+    const char *p = data + sizeof(id) + sizeof(line), *end = data + len;
+    string fields[3];
+    for (string &field : fields) {
+        const char *nul = static_cast<const char *>(memchr(p, '\0', end - p));
+        if (!nul) { return false; }
+        field.assign(p, nul);
+        p = nul + 1;
+    }
+    if (id >= sites_.size()) { sites_.resize(id + 1); }
+    sites_[id] = {fields[1], fields[0], static_cast<int>(line), fields[2]};
+    return true;
+}
+
+/**
+ * @brief 按调用点的类型串取出各参数,格式化为一行日志
+ *
+ * @return bool 调用点已定义且参数完整
+ */
+bool LogDecoder::Format_(const LogFormat::RecordHeader &head, const char *data, size_t len, string &out) {
+    if (head.site >= sites_.size() || sites_[head.site].file.empty()) { return false; }
+    const Site &site = sites_[head.site];
+    vector<Arg> args(site.signature.size());
+    const char *p = data, *end = data + len;
+    for (size_t k = 0; k < args.size(); k++) {
+        Arg &arg = args[k];
+        arg.type = site.signature[k];
+        arg.i = 0;
+        arg.d = 0;
+        size_t size = (arg.type == 'i' || arg.type == 'u') ? 4 : arg.type == 's' ? sizeof(uint16_t) : 8;
+        if (static_cast<size_t>(end - p) < size) { return false; }
+        if (arg.type == 'i') {
+            int32_t v;
+            memcpy(&v, p, size);
+            arg.i = v;
+        } else if (arg.type == 'u') {
+            uint32_t v;
+            memcpy(&v, p, size);
+            arg.i = v;
+        } else if (arg.type == 'd') {
+            memcpy(&arg.d, p, size);
+        } else if (arg.type == 's') {
+            uint16_t n;
+            memcpy(&n, p, size);
+            if (static_cast<size_t>(end - p - size) < n) { return false; }
+            arg.s.assign(p + size, n);
+            p += n;
+        } else {
+            memcpy(&arg.i, p, size);
+        }
+        p += size;
+    }
+
+    /* 与Log::write相同的前缀: 时间 日志级别 */
+    time_t sec = static_cast<time_t>(head.ns / 1000000000);
+    struct tm t;
+    localtime_r(&sec, &t);
+    char prefix[64];
+    size_t n = strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &t);
+    snprintf(prefix + n, sizeof(prefix) - n, ".%06ld %s",
+             static_cast<long>(head.ns % 1000000000 / 1000), LogFormat::LevelTitle(head.level));
+    out += prefix;
+    FormatArgs_(site.format, args, out);
+    out += '\n';
+    return true;
+}
+
+/**
+ * @brief 按printf格式串输出参数,参数按转换说明符需要的类型转换,不依赖写入时的实际类型
+ *
+ * @param format 格式串
+ * @param args 参数
+ * @param out
+ */
+void LogDecoder::FormatArgs_(const string &format, const vector<Arg> &args, string &out) {
+    size_t next = 0;
+    auto take = [&args, &next]() -> const Arg * { return next < args.size() ? &args[next++] : nullptr; };
+    auto append = [&out](const char *spec, auto value) {
+        int n = snprintf(nullptr, 0, spec, value);
+        if (n <= 0) { return; }
+        size_t old = out.size();
+        out.resize(old + n + 1);
+        snprintf(&out[old], n + 1, spec, value);
+        out.resize(old + n);
+    };
+    for (size_t i = 0; i < format.size(); i++) {
+        if (format[i] != '%') {
+            out += format[i];
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%') {
+            out += '%';
+            i++;
+            continue;
+        }
+        /* 标志、宽度、精度原样保留('*'替换为参数值),去掉长度修饰符,按转换说明符补上统一的长度 */
+        string spec = "%";
+        size_t j = i + 1;
+        for (; j < format.size(); j++) {
+            char c = format[j];
+            if (c == '*') {
+                const Arg *arg = take();
+                spec += to_string(arg ? arg->AsInt() : 0);
+            } else if (strchr("-+ #0123456789.", c)) {
+                spec += c;
+            } else if (!strchr("hlLqjzt", c)) {
+                break;
+            }
+        }
+        if (j >= format.size()) {
+            out.append(format, i, string::npos);
+            break;
+        }
+        char conv = format[j];
+        i = j;
+        if (conv == 'n') {
+            take();
+            continue;
+        }
+        if (!strchr("diouxXcsfFeEgGaAp", conv)) {
+            out.append(spec).append(1, conv);
+            continue;
+        }
+        const Arg *arg = take();
+        if (!arg) {
+            out += "<missing>";
+            continue;
+        }
+        if (conv == 'd' || conv == 'i') {
+            append((spec + "lld").c_str(), arg->AsInt());
+        } else if (strchr("ouxX", conv)) {
+            append((spec + "ll" + conv).c_str(), static_cast<unsigned long long>(arg->AsInt()));
+        } else if (conv == 'c') {
+            append((spec + conv).c_str(), static_cast<int>(arg->AsInt()));
+        } else if (conv == 's') {
+            string s = arg->type == 's' ? arg->s : to_string(arg->AsInt());
+            append((spec + conv).c_str(), s.c_str());
+        } else if (conv == 'p') {
+            append((spec + conv).c_str(), reinterpret_cast<void *>(static_cast<uintptr_t>(arg->AsInt())));
+        } else {
+            append((spec + conv).c_str(), arg->AsDouble());
+        }
+    }
+}
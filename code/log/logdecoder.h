@@ -0,0 +1,50 @@
+#ifndef LOG_DECODER_H
+#define LOG_DECODER_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include "logformat.h"
+
+//把二进制日志(格式见logformat.h)还原为与文本模式相同的日志行
+//调用点的定义在文件中先于用到它的记录出现;同一id被重新定义时(如服务器重启后追加到同一文件)以后出现的为准
+class LogDecoder {
+public:
+    /**
+     * 解码一个完整的二进制日志文件的内容,文本追加到out
+     * 文件尾部全为0时(mmap模式下崩溃后留下的预分配部分)视为数据结束
+     * @return 成功解码的记录数;文件头不对或遇到损坏的记录时返回-1,此前解码出的行仍保留在out中
+     */
+    long Decode(const char *data, size_t len, std::string &out);
+
+private:
+    struct Site {
+        std::string format;
+        std::string file;
+        int line;
+        std::string signature;
+    };
+
+    struct Arg {
+        char type;
+        int64_t i;
+        double d;
+        std::string s;
+
+        long long AsInt() const;
+
+        double AsDouble() const;
+    };
+
+    static bool IsZero_(const char *data, size_t len);
+
+    bool Define_(const char *data, size_t len);
+
+    bool Format_(const LogFormat::RecordHeader &head, const char *data, size_t len, std::string &out);
+
+    static void FormatArgs_(const std::string &format, const std::vector<Arg> &args, std::string &out);
+
+    std::vector<Site> sites_;
+};
+
+#endif //LOG_DECODER_H
@@ -0,0 +1,171 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <type_traits>
+
+//文本日志的级别前缀与时间字段缓存,以及二进制日志的记录格式,由Log、AccessLog(写入)和LogDecoder(解码)共用
+//
+//二进制日志文件以MAGIC开头,之后是连续的记录,每条记录以RecordHeader开头,len为包含头部在内的长度
+//site为DEF_SITE的记录是调用点的定义: uint32 调用点id, uint32 行号, 之后是以'\0'结尾的文件名、格式串和参数类型串
+//其余记录的site是此前已定义的调用点,头部之后依次是各参数的原始字节,各参数的类型由类型串中对应的字符给出:
+//  i int32  u uint32  l int64  L uint64  d double  p 指针(uint64)  s 字符串(uint16长度 + 内容,不含'\0')
+namespace LogFormat {
+
+const char MAGIC[8] = {'W', 'S', 'B', 'L', 'O', 'G', '1', '\n'};
+const uint32_t DEF_SITE = 0xffffffff;
+
+struct RecordHeader {
+    uint32_t site;
+    uint16_t len;
+    uint8_t level;
+    uint8_t reserved;
+    int64_t ns;         //CLOCK_REALTIME,纳秒
+};
+
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader must stay packed");
+
+/**
+ * 文本日志每行开头的时间"YYYY-MM-DD HH:MM:SS",年份不超过4位时恰好TIME_PREFIX_LEN个字符
+ */
+const char TIME_PREFIX_FORMAT[] = "%Y-%m-%d %H:%M:%S";
+const int TIME_PREFIX_LEN = 19;
+
+/* 每个线程缓存一份格式化好的时间,秒数或格式变化时才调用localtime_r重新格式化 */
+struct TimeCache {
+    time_t sec = -1;
+    const char *format = nullptr;
+    char text[64];
+
+    const char *Get(time_t now, const char *fmt) {
+        if (now != sec || fmt != format) {
+            struct tm t;
+            localtime_r(&now, &t);
+            strftime(text, sizeof(text), fmt, &t);
+            sec = now;
+            format = fmt;
+        }
+        return text;
+    }
+};
+
+/**
+ * 日志级别对应的前缀
+ */
+inline const char *LevelTitle(int level) {
+    switch (level) {
+        case 0:
+            return "[debug]: ";
+        case 2:
+            return "[warn] : ";
+        case 3:
+            return "[error]: ";
+        default:
+            return "[info] : ";
+    }
+}
+
+template<class T>
+struct AlwaysFalse : std::false_type {};
+
+/**
+ * 参数类型对应的类型字符
+ */
+template<class T>
+constexpr char TypeCode() {
+    if constexpr (std::is_same<T, char *>::value || std::is_same<T, const char *>::value) {
+        return 's';
+    } else if constexpr (std::is_pointer<T>::value || std::is_null_pointer<T>::value) {
+        return 'p';
+    } else if constexpr (std::is_floating_point<T>::value) {
+        static_assert(sizeof(T) <= sizeof(double), "long double is not supported by the binary log");
+        return 'd';
+    } else if constexpr (std::is_enum<T>::value) {
+        return 'i';
+    } else if constexpr (std::is_integral<T>::value) {
+        return sizeof(T) <= 4 ? (std::is_signed<T>::value ? 'i' : 'u') : (std::is_signed<T>::value ? 'l' : 'L');
+    } else {
+        static_assert(AlwaysFalse<T>::value, "unsupported binary log argument type");
+        return 0;
+    }
+}
+
+template<class... Args>
+struct TypeList {};
+
+/* 只在decltype中使用,取得LOG_BASE各参数退化后的类型而不对参数求值 */
+template<class... Args>
+TypeList<std::decay_t<Args>...> Types(Args &&...);
+
+template<class List>
+struct Signature;
+
+template<class... Args>
+struct Signature<TypeList<Args...>> {
+    static constexpr char value[sizeof...(Args) + 1] = {TypeCode<Args>()..., '\0'};
+};
+
+/* 除字符串内容外各参数占用的字节数 */
+template<class T>
+constexpr size_t FixedSize() {
+    constexpr char code = TypeCode<T>();
+    return code == 's' ? sizeof(uint16_t) : (code == 'i' || code == 'u') ? 4 : 8;
+}
+
+template<class T>
+inline void Put(char *&p, size_t &strBudget, const T &v) {
+    using D = std::decay_t<T>;
+    constexpr char code = TypeCode<D>();
+    if constexpr (code == 's') {
+        const char *s = "(null)";
+        if constexpr (std::is_array<T>::value) {
+            s = v;
+        } else if (v) {
+            s = v;
+        }
+        uint16_t n = static_cast<uint16_t>(strnlen(s, strBudget));
+        memcpy(p, &n, sizeof(n));
+        memcpy(p + sizeof(n), s, n);
+        p += sizeof(n) + n;
+        strBudget -= n;
+    } else {
+        using Stored = std::conditional_t<code == 'i', int32_t,
+                std::conditional_t<code == 'u', uint32_t,
+                        std::conditional_t<code == 'l', int64_t,
+                                std::conditional_t<code == 'd', double, uint64_t>>>>;
+        Stored x;
+        if constexpr (std::is_null_pointer<D>::value) {
+            x = 0;
+        } else if constexpr (code == 'p') {
+            x = reinterpret_cast<uintptr_t>(v);
+        } else {
+            x = static_cast<Stored>(v);
+        }
+        memcpy(p, &x, sizeof(x));
+        p += sizeof(x);
+    }
+}
+
+/**
+ * 把一条日志编码为二进制记录,字符串参数在cap不够时被截断
+ * @param buf 至少cap字节, cap不超过65535
+ * @return 记录的长度
+ */
+template<class... Args>
+size_t Encode(char *buf, size_t cap, int level, uint32_t site, int64_t ns, const Args &... args) {
+    constexpr size_t fixed = sizeof(RecordHeader) + (FixedSize<std::decay_t<Args>>() + ... + 0);
+    static_assert(fixed <= 1024, "too many binary log arguments");
+    [[maybe_unused]] size_t strBudget = cap - fixed;  //没有参数时不被使用
+    char *p = buf + sizeof(RecordHeader);
+    (Put(p, strBudget, args), ...);
+    RecordHeader head = {site, static_cast<uint16_t>(p - buf), static_cast<uint8_t>(level), 0, ns};
+    memcpy(buf, &head, sizeof(head));
+    return p - buf;
+}
+
+} // namespace LogFormat
+
+#endif //LOG_FORMAT_H
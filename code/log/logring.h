@@ -0,0 +1,91 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <string.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+//单生产者单消费者的字节环形缓冲区,每个写日志的线程各有一个
+//生产者(写日志的线程)整行追加,不加锁;消费者(日志写线程)把可读部分直接作为writev的iovec写入文件,写完再前移读位置
+//日志行以'\n'结尾,环中只是连续的文本,不需要额外的记录头
+class LogRing {
+public:
+    /**
+     * @param capacity 容量(字节),向上取整为2的幂
+     */
+    explicit LogRing(size_t capacity) : closed(false), head_(0), cachedTail_(0), tail_(0) {
+        size_t size = 4096;
+        while (size < capacity) { size <<= 1; }
+        mask_ = size - 1;
+        buf_.reset(new char[size]);
+    }
+
+    LogRing(const LogRing &) = delete;
+
+    LogRing &operator=(const LogRing &) = delete;
+
+    /**
+     * 生产者调用,空间不足时整行放弃
+     * @return 追加后环中的字节数,空间不足时返回0
+     */
+    size_t TryPush(const char *data, size_t len) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head + len - cachedTail_ > Capacity()) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head + len - cachedTail_ > Capacity()) { return 0; }
+        }
+        size_t pos = head & mask_;
+        size_t first = std::min(len, Capacity() - pos);
+        memcpy(&buf_[pos], data, first);
+        memcpy(&buf_[0], data + first, len - first);
+        head_.store(head + len, std::memory_order_release);
+        return head + len - cachedTail_;
+    }
+
+    /**
+     * 消费者调用,取出当前全部可读数据,回绕时分为两段
+     * @param iov 至少两个元素
+     * @param bytes 可读字节数,之后应以此调用Consume
+     * @return 使用的iovec个数
+     */
+    int Peek(struct iovec *iov, size_t &bytes) const {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        bytes = head_.load(std::memory_order_acquire) - tail;
+        if (bytes == 0) { return 0; }
+        size_t pos = tail & mask_;
+        size_t first = std::min(bytes, Capacity() - pos);
+        iov[0].iov_base = &buf_[pos];
+        iov[0].iov_len = first;
+        if (first == bytes) { return 1; }
+        iov[1].iov_base = &buf_[0];
+        iov[1].iov_len = bytes - first;
+        return 2;
+    }
+
+    void Consume(size_t bytes) {
+        tail_.store(tail_.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+    size_t Size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    size_t Capacity() const { return mask_ + 1; }
+
+    std::atomic<bool> closed;   //所属线程已退出,取空后由写线程回收
+
+private:
+    static const size_t CACHE_LINE = 64;
+
+    std::unique_ptr<char[]> buf_;
+    size_t mask_;
+    /* 生产者与消费者的位置放在不同缓存行,避免伪共享 */
+    alignas(CACHE_LINE) std::atomic <size_t> head_;
+    size_t cachedTail_;         //生产者缓存的tail_,只在看起来空间不足时重新读取
+    alignas(CACHE_LINE) std::atomic <size_t> tail_;
+};
+
+#endif //LOG_RING_H
@@ -5,10 +5,14 @@ int main() {
     /* 守护进程 后台运行 */
     //daemon(1, 0); 
 
+    Config config;
+    config.reactorNum = 0;                  /* 子Reactor数量, 0为单Reactor+线程池模式 */
+
     WebServer server(
             1316, 3, 60000, false,             /* 端口 ET模式 timeoutMs 优雅退出  */
             3306, "root", "chen13076167297.", "webserver", /* Mysql配置 */
-            12, 6, true, 1, 1024);             /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+            12, 6, true, 1, 1024,              /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+            config);
     server.Start();
 } 
   
\ No newline at end of file
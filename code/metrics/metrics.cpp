@@ -0,0 +1,153 @@
+#include "metrics.h"
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <stdio.h>
+#include <algorithm>
+
+using namespace std;
+
+const char *Metrics::CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+namespace {
+struct Gauge {
+    string name;
+    string help;
+    function<double()> read;
+};
+
+/* 所有线程的计数块、已退出线程的计数之和,以及登记的gauge */
+struct Registry {
+    mutex mtx;
+    vector <shared_ptr<Metrics::Counters>> live;
+    Metrics::Counters retired;
+    vector <Gauge> gauges;
+};
+
+Registry &Reg() {
+    //不析构,静态对象析构之后退出的线程仍可安全地归还计数块
+    static Registry *reg = new Registry();
+    return *reg;
+}
+
+void Fold(Metrics::Counters &to, const Metrics::Counters &from) {
+    Metrics::Counters::Add(to.accepted, from.accepted.load(memory_order_relaxed));
+    Metrics::Counters::Add(to.bytesOut, from.bytesOut.load(memory_order_relaxed));
+    for (int i = 0; i < Metrics::STATUS_MAX - Metrics::STATUS_MIN; i++) {
+        Metrics::Counters::Add(to.requests[i], from.requests[i].load(memory_order_relaxed));
+    }
+}
+
+/* 线程退出时把计数并入retired并注销自己的块 */
+struct CountersHolder {
+    shared_ptr <Metrics::Counters> counters;
+
+    ~CountersHolder() {
+        if (!counters) { return; }
+        Registry &reg = Reg();
+        lock_guard <mutex> locker(reg.mtx);
+        Fold(reg.retired, *counters);
+        reg.live.erase(find(reg.live.begin(), reg.live.end(), counters));
+    }
+};
+
+thread_local CountersHolder t_counters;
+
+void Header(string &out, const char *name, const char *help, const char *type) {
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void Sample(string &out, const string &name, double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), " %.17g\n", value);
+    out.append(name).append(buf);
+}
+}
+
+/**
+ * @brief 本线程的计数块,首次调用时创建并登记
+ *
+ * @return Metrics::Counters*
+ */
+Metrics::Counters *Metrics::Local() {
+    CountersHolder &holder = t_counters;
+    if (!holder.counters) {
+        holder.counters = make_shared<Counters>();
+        Registry &reg = Reg();
+        lock_guard <mutex> locker(reg.mtx);
+        reg.live.push_back(holder.counters);
+    }
+    return holder.counters.get();
+}
+
+/**
+ * @brief 登记抓取时读取的gauge
+ *
+ * @param name
+ * @param help
+ * @param read
+ */
+void Metrics::AddGauge(const string &name, const string &help, function<double()> read) {
+    Registry &reg = Reg();
+    lock_guard <mutex> locker(reg.mtx);
+    for (Gauge &gauge : reg.gauges) {
+        if (gauge.name == name) {
+            gauge = {name, help, move(read)};
+            return;
+        }
+    }
+    reg.gauges.push_back({name, help, move(read)});
+}
+
+/**
+ * @brief 清除所有登记的gauge
+ *
+ */
+void Metrics::ClearGauges() {
+    Registry &reg = Reg();
+    lock_guard <mutex> locker(reg.mtx);
+    reg.gauges.clear();
+}
+
+/**
+ * @brief 汇总各线程的计数并读取gauge,输出Prometheus文本
+ * 各线程的计数在读取期间可能仍在增加,同一次抓取中的各指标不保证来自同一时刻
+ *
+ * @return string
+ */
+string Metrics::Render() {
+    Registry &reg = Reg();
+    Counters sum;
+    int64_t timers = 0;
+    vector <Gauge> gauges;
+    {
+        lock_guard <mutex> locker(reg.mtx);
+        Fold(sum, reg.retired);
+        for (const shared_ptr <Counters> &counters : reg.live) {
+            Fold(sum, *counters);
+            timers += counters->timers.load(memory_order_relaxed);
+        }
+        gauges = reg.gauges;
+    }
+
+    string out;
+    Header(out, "webserver_connections_accepted_total", "Accepted client connections.", "counter");
+    Sample(out, "webserver_connections_accepted_total", sum.accepted.load(memory_order_relaxed));
+    Header(out, "webserver_http_requests_total", "HTTP responses by status code.", "counter");
+    for (int i = 0; i < STATUS_MAX - STATUS_MIN; i++) {
+        uint64_t n = sum.requests[i].load(memory_order_relaxed);
+        if (n > 0) { Sample(out, "webserver_http_requests_total{code=\"" + to_string(STATUS_MIN + i) + "\"}", n); }
+    }
+    Header(out, "webserver_http_response_bytes_total", "Bytes written to clients.", "counter");
+    Sample(out, "webserver_http_response_bytes_total", sum.bytesOut.load(memory_order_relaxed));
+    Header(out, "webserver_timers", "Pending connection timers in all event loops.", "gauge");
+    Sample(out, "webserver_timers", timers);
+    //回调可能加锁,不在持有reg.mtx时调用
+    for (const Gauge &gauge : gauges) {
+        Header(out, gauge.name.c_str(), gauge.help.c_str(), "gauge");
+        Sample(out, gauge.name, gauge.read());
+    }
+    return out;
+}
@@ -0,0 +1,69 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <stddef.h>
+
+//运行时指标,由HttpConn在Config::metricsPath上以Prometheus文本格式(0.0.4)输出
+//计数器按线程分开: 每个线程只写自己的一块Counters(按缓存行对齐),单写者用relaxed的读加写累加,
+//不需要带lock前缀的原子指令,也不与其他线程共享缓存行;抓取时加锁遍历所有线程的块求和,线程退出时其计数并入retired
+//其他模块维护的量(线程池队列长度、数据库空闲连接数等)在抓取时通过登记的回调读取
+class Metrics {
+public:
+    static const int STATUS_MIN = 100;
+    static const int STATUS_MAX = 600;     //状态码不在[STATUS_MIN, STATUS_MAX)内时计入STATUS_MIN
+
+    /* 一个线程的计数,只由所属线程写入 */
+    struct alignas(64) Counters {
+        std::atomic <uint64_t> accepted{0};    //接受的连接数
+        std::atomic <uint64_t> bytesOut{0};    //发给客户端的字节数
+        std::atomic <uint64_t> requests[STATUS_MAX - STATUS_MIN] = {};  //按状态码的响应数
+        std::atomic <int64_t> timers{0};       //本线程的定时器个数,是gauge,线程退出后不再计入
+
+        static void Add(std::atomic <uint64_t> &counter, uint64_t n) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    };
+
+    static const char *CONTENT_TYPE;
+
+    static void CountAccept() { Counters::Add(Local()->accepted, 1); }
+
+    static void CountBytesOut(size_t bytes) { Counters::Add(Local()->bytesOut, bytes); }
+
+    static void CountRequest(int status) {
+        if (status < STATUS_MIN || status >= STATUS_MAX) { status = STATUS_MIN; }
+        Counters::Add(Local()->requests[status - STATUS_MIN], 1);
+    }
+
+    /**
+     * 由事件循环线程每轮发布自己的定时器个数
+     */
+    static void SetTimers(size_t count) { Local()->timers.store(count, std::memory_order_relaxed); }
+
+    /**
+     * 登记一个抓取时读取的gauge,同名的登记会替换之前的回调
+     * @param name 指标名
+     * @param help HELP说明
+     * @param read 在抓取的线程中调用,需自行保证线程安全
+     */
+    static void AddGauge(const std::string &name, const std::string &help, std::function<double()> read);
+
+    /**
+     * 清除所有登记的gauge,回调引用的对象销毁前调用
+     */
+    static void ClearGauges();
+
+    /**
+     * @return 所有指标的Prometheus文本
+     */
+    static std::string Render();
+
+private:
+    static Counters *Local();
+};
+
+#endif //METRICS_H
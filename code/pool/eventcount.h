@@ -0,0 +1,105 @@
+#ifndef EVENT_COUNT_H
+#define EVENT_COUNT_H
+
+#include <atomic>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+//基于futex的事件计数器,用于无锁队列的消费者在空闲时休眠
+//消费者: key = PrepareWait(); 再检查一次队列; 仍为空则Wait(key), 否则CancelWait(key)
+//生产者: 入队后调用NotifyOne(),没有休眠者时只是一次原子读,不进入内核
+//PrepareWait登记休眠者与生产者入队后检查休眠者都是seq_cst操作,保证二者至少有一方看到对方,不会丢失唤醒
+//休眠者计数由唤醒方减去: 被唤醒的线程真正运行之前,后续的NotifyOne不会为同一个休眠者重复进入内核
+//key在登记之前读取,登记之后发生的唤醒一定会改变seq_,等待方据此判断自己的登记是否已被认领
+class EventCount {
+public:
+    EventCount() : seq_(0), waiters_(0) {}
+
+    uint32_t PrepareWait() {
+        uint32_t key = seq_.load(std::memory_order_seq_cst);
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return key;
+    }
+
+    /**
+     * 不再休眠;期间已有唤醒发生时登记视为已被认领,不再重复减去
+     * @param key PrepareWait的返回值
+     */
+    void CancelWait(uint32_t key) {
+        if (seq_.load(std::memory_order_seq_cst) == key) {
+            waiters_.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
+    /**
+     * 休眠直到有人在PrepareWait之后调用了Notify
+     * @param key PrepareWait的返回值
+     */
+    void Wait(uint32_t key) {
+        while (seq_.load(std::memory_order_acquire) == key) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(&seq_), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+        }
+        //休眠者计数已由唤醒方减去
+    }
+
+    /**
+     * 调用者需先执行seq_cst栅栏,用于在多个EventCount中挑选有休眠者的一个
+     * @return
+     */
+    bool HasWaiters() const {
+        return waiters_.load(std::memory_order_seq_cst) > 0;
+    }
+
+    /**
+     * @return 是否认领并唤醒了一个休眠者
+     */
+    bool NotifyOne() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int waiters = waiters_.load(std::memory_order_seq_cst);
+        if (waiters <= 0) { return false; }
+        //先改变seq_再认领,认领之前仍在登记中的线程都能看到seq_已变,不会再自行减去计数
+        seq_.fetch_add(1, std::memory_order_seq_cst);
+        while (waiters > 0) {
+            if (waiters_.compare_exchange_weak(waiters, waiters - 1, std::memory_order_seq_cst)) {
+                Wake_(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void NotifyAll() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) <= 0) { return; }
+        seq_.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters_.exchange(0, std::memory_order_seq_cst) > 0) {
+            Wake_(INT_MAX);
+        }
+    }
+
+    /**
+     * 忙等循环中使用,提示CPU当前在自旋
+     */
+    static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+private:
+    void Wake_(int count) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&seq_), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+
+    std::atomic <uint32_t> seq_;
+    std::atomic <int> waiters_;
+};
+
+#endif //EVENT_COUNT_H
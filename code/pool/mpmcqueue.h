@@ -0,0 +1,110 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include <assert.h>
+
+//有界无锁多生产者多消费者队列(Dmitry Vyukov的算法)
+//每个槽带一个序号: 序号等于入队位置时可写,等于位置+1时可读;
+//入队、出队各只需在enqueuePos_/dequeuePos_上做一次CAS,不加锁,也不分配内存
+//队列满时TryPush返回false,空时TryPop返回false,由调用者决定等待方式
+template<class T>
+class MpmcQueue {
+public:
+    /**
+     * @param capacity 容量,向上取整为2的幂
+     */
+    explicit MpmcQueue(size_t capacity = 1 << 16) {
+        size_t size = 2;
+        while (size < capacity) { size <<= 1; }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos_.store(0, std::memory_order_relaxed);
+        dequeuePos_.store(0, std::memory_order_relaxed);
+    }
+
+    ~MpmcQueue() {
+        T item;
+        while (TryPop(item)) {}
+    }
+
+    MpmcQueue(const MpmcQueue &) = delete;
+
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    template<class U>
+    bool TryPush(U &&item) {
+        Cell *cell;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            } else if (diff < 0) {
+                return false;   //满
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        new(&cell->storage) T(std::forward<U>(item));
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T &item) {
+        Cell *cell;
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            } else if (diff < 0) {
+                return false;   //空
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        T *ptr = std::launder(reinterpret_cast<T *>(&cell->storage));
+        item = std::move(*ptr);
+        ptr->~T();
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @return 近似的元素个数,并发修改时只作参考
+     */
+    size_t SizeApprox() const {
+        size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+        size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic <size_t> seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    static const size_t CACHE_LINE = 64;
+
+    /* 生产者与消费者的位置放在不同缓存行,避免伪共享 */
+    alignas(CACHE_LINE) std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(CACHE_LINE) std::atomic <size_t> enqueuePos_;
+    alignas(CACHE_LINE) std::atomic <size_t> dequeuePos_;
+};
+
+#endif //MPMC_QUEUE_H
@@ -0,0 +1,125 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+//线程池的任务类型,取代std::function<void()>
+//只能移动不能复制;可调用对象不超过INLINE_SIZE字节时直接构造在对象内部,不分配内存
+//服务器自己的任务(成员函数指针+this+连接指针+代数)都放得下,更大的可调用对象才退回堆上
+//整个对象恰好一个缓存行(64字节);放进MpmcQueue后槽位还带8字节的序号,共72字节,相邻槽位可能共用一个缓存行
+class Task {
+public:
+    static const size_t INLINE_SIZE = 48;
+
+    template<class F>
+    static constexpr bool FitsInline() {
+        typedef typename std::decay<F>::type Fn;
+        return sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    Task() noexcept: invoke_(nullptr), manage_(nullptr) {}
+
+    template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f) {
+        typedef typename std::decay<F>::type Fn;
+        if constexpr (FitsInline<Fn>()) {
+            new(&storage_) Fn(std::forward<F>(f));
+            invoke_ = &InvokeInline_<Fn>;
+            manage_ = &ManageInline_<Fn>;
+        } else {
+            *reinterpret_cast<Fn **>(&storage_) = new Fn(std::forward<F>(f));
+            invoke_ = &InvokeHeap_<Fn>;
+            manage_ = &ManageHeap_<Fn>;
+        }
+    }
+
+    Task(Task &&other) noexcept: invoke_(other.invoke_), manage_(other.manage_) {
+        if (manage_) {
+            manage_(MOVE, &other.storage_, &storage_);
+            other.invoke_ = nullptr;
+            other.manage_ = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            invoke_ = other.invoke_;
+            manage_ = other.manage_;
+            if (manage_) {
+                manage_(MOVE, &other.storage_, &storage_);
+                other.invoke_ = nullptr;
+                other.manage_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+
+    Task &operator=(const Task &) = delete;
+
+    ~Task() { Reset(); }
+
+    void operator()() { invoke_(&storage_); }
+
+    explicit operator bool() const { return invoke_ != nullptr; }
+
+    /**
+     * 销毁持有的可调用对象,变为空任务
+     */
+    void Reset() {
+        if (manage_) {
+            manage_(DESTROY, &storage_, nullptr);
+            invoke_ = nullptr;
+            manage_ = nullptr;
+        }
+    }
+
+private:
+    enum Op {
+        MOVE,       //把src中的对象移动到dst,并销毁src中的对象
+        DESTROY,
+    };
+
+    typedef typename std::aligned_storage<INLINE_SIZE, alignof(std::max_align_t)>::type Storage;
+
+    template<class Fn>
+    static void InvokeInline_(void *storage) {
+        (*std::launder(reinterpret_cast<Fn *>(storage)))();
+    }
+
+    template<class Fn>
+    static void ManageInline_(Op op, void *src, void *dst) {
+        Fn *fn = std::launder(reinterpret_cast<Fn *>(src));
+        if (op == MOVE) { new(dst) Fn(std::move(*fn)); }
+        fn->~Fn();
+    }
+
+    template<class Fn>
+    static void InvokeHeap_(void *storage) {
+        (**reinterpret_cast<Fn **>(storage))();
+    }
+
+    template<class Fn>
+    static void ManageHeap_(Op op, void *src, void *dst) {
+        Fn **fn = reinterpret_cast<Fn **>(src);
+        if (op == MOVE) {
+            *reinterpret_cast<Fn **>(dst) = *fn;
+        } else {
+            delete *fn;
+        }
+    }
+
+    Storage storage_;
+    void (*invoke_)(void *);
+    void (*manage_)(Op, void *, void *);
+};
+
+static_assert(sizeof(Task) == 64, "Task should fill exactly one cache line");
+
+#endif //TASK_H
@@ -1,47 +1,82 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
-#include <mutex>
-#include <condition_variable>
-#include <queue>
 #include <thread>
 #include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <assert.h>
+#include "mpmcqueue.h"
+#include "eventcount.h"
+#include "task.h"
 
 //实现简单的线程池
+//任务队列为有界无锁MPMC队列,添加任务只需一次CAS;任务类型为Task,服务器的任务直接构造在队列槽位中,不分配内存;
+//空闲的工作线程先短暂自旋,仍取不到任务时在futex上休眠,只有存在休眠线程时添加任务才会进入内核唤醒
+//工作窃取模式下每个工作线程另有一个自己的队列: AddTask(key, task)按key固定投递给同一个线程,
+//同一连接连续的读、写任务在同一个核上执行,缓冲区留在该核的缓存中;
+//线程空闲时从积压了至少STEAL_MIN个任务的其他线程窃取,只排了一个任务的线程不会被窃取,以免刚被唤醒的线程扑空
 class ThreadPool {
 public:
     /**
      * @brief 构造函数
      * @param threadCount 指定线程池的线程数量,默认是8个线程
+     * @param queueSize 任务队列容量,队列满时AddTask让出CPU等待工作线程取走任务
+     * @param stealing 是否开启工作窃取模式,关闭时AddTask(key, task)与AddTask(task)相同
+     * @param onStart 每个工作线程启动后首先调用onStart(i),例如绑定CPU;
+     *                之后线程才分配自己的队列,使其位于该线程所在的NUMA节点
      */
-    explicit ThreadPool(size_t threadCount = 8) : pool_(std::make_shared<Pool>()) {
+    explicit ThreadPool(size_t threadCount = 8, size_t queueSize = 1 << 16, bool stealing = false,
+                        std::function<void(size_t)> onStart = nullptr) :
+            pool_(std::make_shared<Pool>(queueSize)) {
         //使用了std::make_shared<Pool>()来创建一个共享指针pool_
-        //Pool结构体中包含一个互斥量mtx、
-        //一个条件变量cond、
-        //一个bool型标志isClosed
-        //和一个std::queue<std::function<void()>>型的tasks队列
+        //Pool结构体中包含一个共享的无锁任务队列tasks、
+        //每个工作线程各自的队列与用于休眠和唤醒的事件计数器workers
+        //和一个原子的isClosed标志
         assert(threadCount > 0);
+        //单核上自旋只会占用生产者的时间片
+        pool_->spinCount = std::thread::hardware_concurrency() > 1 ? SPIN_COUNT : 0;
+        pool_->stealing = stealing;
+        pool_->workers.resize(threadCount);
+        size_t localSize = stealing ? std::max<size_t>(LOCAL_QUEUE_MIN, queueSize / threadCount) : 2;
         //创建threadCount个线程
         for (size_t i = 0; i < threadCount; i++) {
-            //每个线程执行一个Lambda表达式，
-            //Lambda表达式中创建一个std::unique_lockstd::mutex类型的locker对象来锁定互斥量mtx
-            std::thread([pool = pool_] {
-                std::unique_lock <std::mutex> locker(pool->mtx);
+            std::thread([pool = pool_, i, localSize, onStart] {
+                if (onStart) { onStart(i); }
+                //Worker由本线程分配并初始化,物理页按首次访问落在本线程所在的节点
+                pool->workers[i].reset(new Worker(localSize));
+                pool->ready.fetch_add(1, std::memory_order_release);
+                //窃取时会访问其他线程的Worker,等全部线程就绪后再开始
+                while (pool->ready.load(std::memory_order_acquire) < pool->workers.size()) {
+                    std::this_thread::yield();
+                }
+                Worker &self = *pool->workers[i];
+                //非窃取模式下所有线程在同一个事件计数器上休眠,任意一个被唤醒即可
+                EventCount &event = pool->stealing ? self.event : pool->event;
                 while (true) {
-                    //如果tasks队列不为空
-                    if (!pool->tasks.empty()) {
-                        auto task = std::move(pool->tasks.front());
-                        pool->tasks.pop();
-                        locker.unlock();
+                    Task task;
+                    //先自旋尝试取任务
+                    if (pool->Pop(i, task)) {
                         task();
-                        locker.lock();
-                    //如果tasks队列为空且线程池已关闭
-                    } else if (pool->isClosed) break;   //退出循环
-                    //进入条件变量cond的等待状态，等待其他线程的通知
-                    else pool->cond.wait(locker);
+                        continue;
+                    }
+                    //如果队列都为空且线程池已关闭
+                    if (pool->isClosed.load()) { break; }   //退出循环
+                    //登记为休眠者后再检查一次,避免错过登记前刚加入的任务
+                    uint32_t key = event.PrepareWait();
+                    if (self.tasks.SizeApprox() > 0 || pool->tasks.SizeApprox() > 0 || pool->isClosed.load()) {
+                        event.CancelWait(key);
+                        continue;
+                    }
+                    event.Wait(key);
                 }
             }).detach();    //将线程设置为分离状态
         }
+        //AddTask与析构都会访问workers,等所有线程分配好自己的Worker再返回
+        while (pool_->ready.load(std::memory_order_acquire) < threadCount) {
+            std::this_thread::yield();
+        }
     }
 
     ThreadPool() = default;
@@ -54,45 +89,142 @@ public:
     ~ThreadPool() {
         //检查线程池的智能指针是否指向了一个有效的 Pool 对象
         if (static_cast<bool>(pool_)) {
-            {
-                //先用锁保护线程池的互斥锁
-                std::lock_guard <std::mutex> locker(pool_->mtx);
-                //将线程池的 isClosed 标志设置为 true
-                pool_->isClosed = true;
+            //将线程池的 isClosed 标志设置为 true
+            pool_->isClosed.store(true);
+            //唤醒所有休眠的线程,它们处理完剩余任务后退出
+            pool_->event.NotifyAll();
+            for (auto &worker : pool_->workers) {
+                worker->event.NotifyAll();
             }
-            //唤醒所有被等待在条件变量上的线程
-            pool_->cond.notify_all();
         }
         //这样，线程池就能够被安全地销毁，不会有任何线程在后台运行
     }
 
     /**
-     * @brief 用于向线程池中添加一个任务
+     * @brief 用于向线程池中添加一个任务,由任意空闲线程执行
      * @tparam F 可以接受任意可调用对象
      * @param task
      */
     template<class F>
     void AddTask(F &&task) {
-        {
-            //获取了 ThreadPool 类中的共享指针 pool_ 中的互斥锁 mtx
-            //并在其作用域内创建了一个 std::lock_guard 对象 locker
-            std::lock_guard <std::mutex> locker(pool_->mtx);
-            //使用 std::forward 将传递进来的任务转发到线程池的任务队列
-            pool_->tasks.emplace(std::forward<F>(task));
+        //TryPush只在成功时才构造元素,失败重试时task不会被移走
+        while (!pool_->tasks.TryPush(std::forward<F>(task))) {
+            std::this_thread::yield();
+        }
+        //有线程在休眠时唤醒其中一个，使其从等待中醒来并取出任务执行
+        pool_->WakeAny(pool_->nextWake.fetch_add(1, std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief 工作窃取模式下把任务投递给key对应的工作线程
+     * 同一个key的任务总在同一个线程的队列中按顺序排队,该线程忙时可能被其他空闲线程窃取
+     * @param key 例如连接的fd
+     * @param task
+     */
+    template<class F>
+    void AddTask(size_t key, F &&task) {
+        if (!pool_->stealing) {
+            AddTask(std::forward<F>(task));
+            return;
+        }
+        size_t idx = key % pool_->workers.size();
+        Worker &worker = *pool_->workers[idx];
+        if (!worker.tasks.TryPush(std::forward<F>(task))) {
+            //本线程的队列已满,退回共享队列
+            AddTask(std::forward<F>(task));
+            return;
         }
-        //唤醒其中一个等待线程，使其从等待中醒来并取出任务执行
-        pool_->cond.notify_one();
+        if (!worker.event.NotifyOne() && worker.tasks.SizeApprox() >= STEAL_MIN) {
+            //目标线程正忙且已有积压,唤醒一个空闲线程来窃取
+            pool_->WakeAny(idx + 1);
+        }
+    }
+
+    /**
+     * @return 工作窃取模式下被其他线程窃取执行的任务数
+     */
+    uint64_t StealCount() const {
+        return pool_ ? pool_->steals.load(std::memory_order_relaxed) : 0;
+    }
+
+    /**
+     * @return 共享队列与各线程队列中等待执行的任务数,并发修改时只作参考
+     */
+    size_t QueueSize() const {
+        size_t size = pool_->tasks.SizeApprox();
+        for (const auto &worker : pool_->workers) { size += worker->tasks.SizeApprox(); }
+        return size;
     }
 
 private:
+    static const int SPIN_COUNT = 128;
+
+    static const size_t LOCAL_QUEUE_MIN = 1024;
+
+    static const size_t STEAL_MIN = 2;
+
+    struct Worker {
+        explicit Worker(size_t queueSize) : tasks(queueSize) {}
+
+        MpmcQueue <Task> tasks;     //投递给本线程的任务
+        EventCount event;           //窃取模式下本线程在此休眠
+    };
+
     struct Pool {
-        std::mutex mtx;
-        std::condition_variable cond;
-        bool isClosed;
-        std::queue <std::function<void()>> tasks;
+        explicit Pool(size_t queueSize) : isClosed(false), spinCount(0), stealing(false), tasks(queueSize),
+                                          ready(0), nextWake(0), steals(0) {}
+
+        /**
+         * 依次尝试本线程队列、共享队列、窃取其他线程的队列,取不到时自旋重试
+         */
+        bool Pop(size_t self, Task &task) {
+            for (int i = 0; i <= spinCount; i++) {
+                if (TryPop(self, task)) { return true; }
+                EventCount::CpuRelax();
+            }
+            return false;
+        }
+
+        bool TryPop(size_t self, Task &task) {
+            if (workers[self]->tasks.TryPop(task) || tasks.TryPop(task)) { return true; }
+            if (!stealing) { return false; }
+            for (size_t i = 1; i < workers.size(); i++) {
+                Worker &victim = *workers[(self + i) % workers.size()];
+                if (victim.tasks.SizeApprox() >= STEAL_MIN && victim.tasks.TryPop(task)) {
+                    steals.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * 从第start个线程开始找一个休眠的线程唤醒
+         */
+        void WakeAny(size_t start) {
+            if (!stealing) {
+                event.NotifyOne();
+                return;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for (size_t i = 0; i < workers.size(); i++) {
+                EventCount &event = workers[(start + i) % workers.size()]->event;
+                if (event.HasWaiters() && event.NotifyOne()) { return; }
+            }
+        }
+
+        std::atomic<bool> isClosed;
+        int spinCount;
+        bool stealing;
+        MpmcQueue <Task> tasks;
+        EventCount event;           //非窃取模式下所有线程在此休眠
+        std::vector <std::unique_ptr<Worker>> workers;
+        std::atomic <size_t> ready;                //已分配好自己Worker的线程数
+        std::atomic <size_t> nextWake;
+        std::atomic <uint64_t> steals;
     };
     std::shared_ptr <Pool> pool_;
 };
 
 
-#endif //THREADPOOL_H
\ No newline at end of file
+#endif //THREADPOOL_H
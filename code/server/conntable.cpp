@@ -0,0 +1,24 @@
+#include "conntable.h"
+
+using namespace std;
+
+/**
+ * @param maxFd fd上限,槽位数组按此一次分配
+ */
+ConnTable::ConnTable(int maxFd) : maxFd_(maxFd), slots_(new unique_ptr<HttpConn>[maxFd]) {
+    assert(maxFd > 0);
+}
+
+/**
+ * 取fd对应的连接,第一次使用该fd时分配HttpConn
+ * 只由accept新连接的线程调用
+ * @param fd
+ * @return
+ */
+HttpConn *ConnTable::Acquire(int fd) {
+    assert(fd >= 0 && fd < maxFd_);
+    if (!slots_[fd]) {
+        slots_[fd].reset(new HttpConn());
+    }
+    return slots_[fd].get();
+}
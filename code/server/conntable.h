@@ -0,0 +1,48 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <stdint.h>
+#include <memory>
+#include <assert.h>
+
+#include "../http/httpconn.h"
+
+//以fd为下标的连接表,取代unordered_map<int, HttpConn>
+//槽位数组在构造时一次分配好,事件分发时直接按fd下标取连接,不再哈希
+//HttpConn本身在fd第一次出现时才分配,之后常驻,连接关闭不释放,指针在整个表的生命周期内有效
+//配合HttpConn的代数: 注册fd时把代数作为tag交给Poller,取连接时比较代数,丢弃fd复用前残留的事件
+class ConnTable {
+public:
+    explicit ConnTable(int maxFd);
+
+    ~ConnTable() = default;
+
+    HttpConn *Acquire(int fd);
+
+    /**
+     * @param fd
+     * @return fd对应的连接,从未分配过时返回nullptr
+     */
+    HttpConn *Get(int fd) const {
+        assert(fd >= 0 && fd < maxFd_);
+        return slots_[fd].get();
+    }
+
+    /**
+     * @param fd
+     * @param gen 注册事件时的代数
+     * @return 连接已关闭或fd已被新连接复用时返回nullptr
+     */
+    HttpConn *Get(int fd, uint32_t gen) const {
+        HttpConn *conn = Get(fd);
+        return (conn && conn->GetGen() == gen) ? conn : nullptr;
+    }
+
+    int MaxFd() const { return maxFd_; }
+
+private:
+    int maxFd_;
+    std::unique_ptr<std::unique_ptr<HttpConn>[]> slots_;
+};
+
+#endif //CONN_TABLE_H
@@ -20,14 +20,15 @@ Epoller::~Epoller() {
  * 添加一个新的文件描述符到epoll实例中
  * @param fd
  * @param events
+ * @param tag 随事件返回,见Poller::EventData
  * @return
  */
-bool Epoller::AddFd(int fd, uint32_t events) {
+bool Epoller::AddFd(int fd, uint32_t events, uint32_t tag) {
     //检查fd的有效性
     if (fd < 0) return false;
     epoll_event ev = {0};   //声明一个新的epoll_event结构实例
-    //设置ev.data.fd和ev.events属性来确定服务的文件描述符和要监听的事件类型
-    ev.data.fd = fd;        
+    //设置ev.data和ev.events属性来确定服务的文件描述符和要监听的事件类型
+    ev.data.u64 = EventData(fd, tag);
     ev.events = events;
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
 }
@@ -36,13 +37,14 @@ bool Epoller::AddFd(int fd, uint32_t events) {
  * 修改epoll监听的文件描述符fd
  * @param fd
  * @param events
+ * @param tag
  * @return
  */
-bool Epoller::ModFd(int fd, uint32_t events) {
+bool Epoller::ModFd(int fd, uint32_t events, uint32_t tag) {
     if (fd < 0) 
     return false;
     epoll_event ev = {0};
-    ev.data.fd = fd;
+    ev.data.u64 = EventData(fd, tag);
     ev.events = events;
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
 }
@@ -75,7 +77,7 @@ int Epoller::Wait(int timeoutMs) {
  */
 int Epoller::GetEventFd(size_t i) const {
     assert(i < events_.size() && i >= 0);
-    return events_[i].data.fd;
+    return static_cast<int>(events_[i].data.u64 & 0xffffffff);
 }
 
 /**
@@ -86,4 +88,14 @@ int Epoller::GetEventFd(size_t i) const {
 uint32_t Epoller::GetEvents(size_t i) const {
     assert(i < events_.size() && i >= 0);
     return events_[i].events;
+}
+
+/**
+ * 获取索引i指定的事件注册时附带的tag
+ * @param i
+ * @return
+ */
+uint32_t Epoller::GetEventTag(size_t i) const {
+    assert(i < events_.size() && i >= 0);
+    return static_cast<uint32_t>(events_[i].data.u64 >> 32);
 }
\ No newline at end of file
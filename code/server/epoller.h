@@ -8,23 +8,29 @@
 #include <vector>
 #include <errno.h>
 
-class Epoller {
+#include "poller.h"
+
+class Epoller : public Poller {
 public:
     explicit Epoller(int maxEvent = 1024);
 
-    ~Epoller();
+    ~Epoller() override;
+
+    bool AddFd(int fd, uint32_t events, uint32_t tag = 0) override;
+
+    bool ModFd(int fd, uint32_t events, uint32_t tag = 0) override;
 
-    bool AddFd(int fd, uint32_t events);
+    bool DelFd(int fd) override;
 
-    bool ModFd(int fd, uint32_t events);
+    int Wait(int timeoutMs = -1) override;
 
-    bool DelFd(int fd);
+    int GetEventFd(size_t i) const override;
 
-    int Wait(int timeoutMs = -1);
+    uint32_t GetEvents(size_t i) const override;
 
-    int GetEventFd(size_t i) const;
+    uint32_t GetEventTag(size_t i) const override;
 
-    uint32_t GetEvents(size_t i) const;
+    const char *Name() const override { return "epoll"; }
 
 private:
     int epollFd_;
@@ -0,0 +1,70 @@
+#include "poller.h"
+#include "epoller.h"
+#include "uringpoller.h"
+#include "../buffer/buffer.h"
+
+#include <sys/socket.h>
+#include <errno.h>
+
+/**
+ * 默认直接调用accept4
+ * @param listenFd
+ * @param addr
+ * @return
+ */
+int Poller::Accept(int listenFd, struct sockaddr_in *addr) {
+    socklen_t len = sizeof(*addr);
+    return accept4(listenFd, reinterpret_cast<struct sockaddr *>(addr), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+/**
+ * 默认直接从fd读取
+ * @param fd
+ * @param buff
+ * @param saveErrno
+ * @return
+ */
+ssize_t Poller::Recv(int fd, Buffer &buff, int *saveErrno) {
+    return buff.ReadFd(fd, saveErrno);
+}
+
+/**
+ * 默认直接调用writev,之后还有数据时用sendmsg带上MSG_MORE
+ * @param fd
+ * @param iov
+ * @param iovCnt
+ * @param more
+ * @param saveErrno
+ * @return
+ */
+ssize_t Poller::Send(int fd, const struct iovec *iov, int iovCnt, bool more, int *saveErrno) {
+    ssize_t len;
+    if (more) {
+        struct msghdr msg = {};
+        msg.msg_iov = const_cast<struct iovec *>(iov);
+        msg.msg_iovlen = iovCnt;
+        len = sendmsg(fd, &msg, MSG_MORE);
+    } else {
+        len = writev(fd, iov, iovCnt);
+    }
+    if (len < 0) { *saveErrno = errno; }
+    return len;
+}
+
+/**
+ * 创建IO多路复用后端
+ * 要求使用io_uring但内核不支持时回退到epoll,调用方可通过Name()确认实际使用的后端
+ * @param useUring 是否优先使用io_uring
+ * @param maxEvent 单次Wait最多返回的事件数
+ * @return
+ */
+Poller *Poller::NewPoller(bool useUring, int maxEvent) {
+    if (useUring) {
+        UringPoller *poller = new UringPoller(maxEvent);
+        if (poller->IsValid()) {
+            return poller;
+        }
+        delete poller;
+    }
+    return new Epoller(maxEvent);
+}
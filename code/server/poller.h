@@ -0,0 +1,77 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <sys/epoll.h> // EPOLLIN/EPOLLOUT/EPOLLET...
+#include <sys/types.h>
+#include <sys/uio.h>   // iovec
+#include <netinet/in.h> // sockaddr_in
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+
+//IO多路复用后端的公共接口,WebServer与SubReactor只通过它注册fd和等待事件
+//事件掩码沿用epoll的EPOLLIN/EPOLLOUT/EPOLLET/EPOLLONESHOT等定义
+//目前有两个实现: Epoller(epoll) 与 UringPoller(io_uring)
+//注册时可附带一个32位tag(连接的代数),与fd一起随事件返回,用于识别fd被复用后残留的旧事件
+//监听fd与连接fd可分别用AddListenFd/AddConnFd注册,再通过Accept/Recv取连接和数据:
+//epoll下它们就是accept4/readv,io_uring下由内核提前完成accept和recv,EPOLLIN表示已有连接或数据可取
+//连接fd的响应通过Send发送: epoll下就是writev,io_uring下提交为一串链接的send请求,完成后以EPOLLOUT报告
+class Poller {
+public:
+    virtual ~Poller() = default;
+
+    virtual bool AddFd(int fd, uint32_t events, uint32_t tag = 0) = 0;
+
+    virtual bool ModFd(int fd, uint32_t events, uint32_t tag = 0) = 0;
+
+    virtual bool DelFd(int fd) = 0;
+
+    /**
+     * 注册监听fd,之后用Accept取新连接
+     */
+    virtual bool AddListenFd(int fd, uint32_t events) { return AddFd(fd, events); }
+
+    /**
+     * 注册连接fd,之后用Recv读数据
+     */
+    virtual bool AddConnFd(int fd, uint32_t events, uint32_t tag = 0) { return AddFd(fd, events, tag); }
+
+    /**
+     * 取一个新连接,返回的fd为非阻塞
+     * @return 新连接的fd,没有新连接或出错时返回-1并设置errno
+     */
+    virtual int Accept(int listenFd, struct sockaddr_in *addr);
+
+    /**
+     * 把fd上已到达的数据追加到buff
+     * @return 读到的字节数,对端关闭时为0,没有数据或出错时为-1并把errno存入saveErrno
+     */
+    virtual ssize_t Recv(int fd, Buffer &buff, int *saveErrno);
+
+    /**
+     * 按顺序发送iov中的数据;返回-1且saveErrno为EAGAIN时,注册EPOLLOUT并在其到达后以同样的iov再次调用
+     * 调用者在返回已发送的字节数之前要保证iov指向的内存有效
+     * @param more 之后还有数据要发送(如sendfile的文件),让最后一段与其合并成满的报文段
+     * @return 已发送的字节数,出错时为-1并把errno存入saveErrno
+     */
+    virtual ssize_t Send(int fd, const struct iovec *iov, int iovCnt, bool more, int *saveErrno);
+
+    virtual int Wait(int timeoutMs = -1) = 0;
+
+    virtual int GetEventFd(size_t i) const = 0;
+
+    virtual uint32_t GetEvents(size_t i) const = 0;
+
+    virtual uint32_t GetEventTag(size_t i) const = 0;
+
+    static uint64_t EventData(int fd, uint32_t tag) {
+        return (static_cast<uint64_t>(tag) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    virtual const char *Name() const = 0;
+
+    static Poller *NewPoller(bool useUring, int maxEvent = 1024);
+};
+
+#endif //POLLER_H
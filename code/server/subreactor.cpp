@@ -0,0 +1,316 @@
+#include "subreactor.h"
+
+using namespace std;
+
+/**
+ * @brief 构造函数,创建本loop的Poller、Timer和用于唤醒的eventfd
+ *
+ * @param id 子Reactor编号
+ * @param timeoutMS 连接超时时间
+ * @param connEvent 连接事件设置,会去掉EPOLLONESHOT
+ * @param config 使用其中的IO后端、定时器与CPU亲和性配置
+ */
+SubReactor::SubReactor(int id, int timeoutMS, uint32_t connEvent, const Config &config) :
+        id_(id), cpu_(CpuAffinity::Pick(CpuAffinity::ParseList(config.workerCpus), id)), lazyTimeout_(config.lazyTimeout), nowMs_(Timer::CoarseMs()), timeoutMS_(timeoutMS), connEvent_(connEvent & ~EPOLLONESHOT), isClose_(false),
+        listenFd_(-1), listenEvent_(0), acceptCount_(0),
+        timer_(Timer::NewTimer(config.useTimingWheel, config.wheelTickMs)), epoller_(Poller::NewPoller(config.useUring)),
+        users_(MAX_FD) {
+    //连接只由本线程处理,不存在多个线程同时处理同一连接的问题,因此不需要EPOLLONESHOT
+    wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(wakeupFd_ >= 0);
+    epoller_->AddFd(wakeupFd_, EPOLLIN);
+}
+
+/**
+ * @brief 析构函数,停止loop线程并关闭eventfd
+ *
+ */
+SubReactor::~SubReactor() {
+    Stop();
+    close(wakeupFd_);
+    if (listenFd_ >= 0) { close(listenFd_); }
+}
+
+/**
+ * @brief 启动loop线程
+ *
+ */
+void SubReactor::Start() {
+    assert(!thread_.joinable());
+    thread_ = thread(&SubReactor::Loop_, this);
+}
+
+/**
+ * @brief 通知loop线程退出并等待其结束
+ *
+ */
+void SubReactor::Stop() {
+    isClose_ = true;
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        ::write(wakeupFd_, &one, sizeof(one));
+        thread_.join();
+    }
+}
+
+/**
+ * @brief 由主Reactor线程调用,把新连接投递给本loop
+ * 只在pending_上加锁,随后写eventfd唤醒epoll_wait
+ *
+ * @param fd 客户端连接的文件描述符
+ * @param addr 客户端连接的地址信息
+ */
+void SubReactor::AddClient(int fd, const sockaddr_in &addr) {
+    {
+        lock_guard <mutex> locker(mtx_);
+        pending_.emplace_back(fd, addr);
+    }
+    uint64_t one = 1;
+    ::write(wakeupFd_, &one, sizeof(one));
+}
+
+/**
+ * @brief 分片模式下设置本loop独占的监听fd,需在Start之前调用
+ *
+ * @param listenFd 已设置SO_REUSEPORT并处于listen状态的非阻塞fd
+ * @param listenEvent 监听事件设置
+ */
+void SubReactor::SetListenFd(int listenFd, uint32_t listenEvent) {
+    assert(listenFd > 0 && listenFd_ < 0);
+    listenFd_ = listenFd;
+    listenEvent_ = listenEvent;
+    epoller_->AddListenFd(listenFd_, listenEvent_ | EPOLLIN);
+}
+
+/**
+ * @brief 子Reactor的事件循环,与WebServer::Start()的结构一致
+ *
+ */
+void SubReactor::Loop_() {
+    int timeMS = -1;
+    //连接在本线程中创建,绑定后其HttpConn与读写缓冲区都分配在本线程所在的NUMA节点
+    if (cpu_ >= 0 && !CpuAffinity::PinThread(cpu_)) {
+        LOG_WARN("SubReactor[%d] bind cpu %d failed", id_, cpu_);
+    }
+    LOG_INFO("SubReactor[%d] start, cpu %d", id_, cpu_);
+    while (!isClose_) {
+        if (timeoutMS_ > 0) {
+            timeMS = timer_->GetNextTick();
+            Metrics::SetTimers(timer_->size());
+        }
+        int eventCnt = epoller_->Wait(timeMS);
+        nowMs_ = Timer::CoarseMs();     //本轮事件共用一个时间
+        for (int i = 0; i < eventCnt; i++) {
+            int fd = epoller_->GetEventFd(i);
+            uint32_t events = epoller_->GetEvents(i);
+            if (fd == listenFd_) {                                      //分片模式下自行accept
+                DealListen_();
+            } else if (fd == wakeupFd_) {                               //处理主Reactor投递的新连接
+                HandleWakeup_();
+            } else {
+                //代数与注册时不符说明是已关闭连接残留的事件
+                HttpConn *client = users_.Get(fd, epoller_->GetEventTag(i));
+                if (!client) { continue; }
+                if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {      //处理关闭事件
+                    CloseConn_(client);
+                } else if (events & EPOLLIN) {                          //处理读取请求
+                    ExtentTime_(client);
+                    OnRead_(client);
+                } else if (events & EPOLLOUT) {                         //处理写入请求
+                    ExtentTime_(client);
+                    OnWrite_(client, true);
+                } else {
+                    LOG_ERROR("Unexpected event");
+                }
+            }
+        }
+    }
+    LOG_INFO("SubReactor[%d] quit", id_);
+}
+
+/**
+ * @brief 处理本loop监听fd上的新连接,逻辑与WebServer::DealListen_一致
+ *
+ */
+void SubReactor::DealListen_() {
+    struct sockaddr_in addr;
+    do {
+        int fd = epoller_->Accept(listenFd_, &addr);
+        if (fd <= 0) { return; }
+        else if (HttpConn::userCount >= MAX_FD || fd >= users_.MaxFd()) {
+            SendError_(fd, "Server busy!");
+            LOG_WARN("Clients is full!");
+            return;
+        }
+        acceptCount_++;
+        AddClient_(fd, addr);
+    } while (listenEvent_ & EPOLLET);
+}
+
+/**
+ * @brief 将错误信息发送给客户端并关闭连接
+ *
+ * @param fd
+ * @param info
+ */
+void SubReactor::SendError_(int fd, const char *info) {
+    assert(fd > 0);
+    int ret = send(fd, info, strlen(info), 0);
+    if (ret < 0) {
+        LOG_WARN("send error to client[%d] error!", fd);
+    }
+    close(fd);
+}
+
+/**
+ * @brief eventfd可读,取出主Reactor投递过来的全部新连接
+ *
+ */
+void SubReactor::HandleWakeup_() {
+    uint64_t cnt = 0;
+    ::read(wakeupFd_, &cnt, sizeof(cnt));
+    vector <pair<int, sockaddr_in>> clients;
+    {
+        lock_guard <mutex> locker(mtx_);
+        clients.swap(pending_);
+    }
+    for (auto &item: clients) {
+        AddClient_(item.first, item.second);
+    }
+}
+
+/**
+ * @brief 在本loop中注册一个新的客户端连接
+ *
+ * @param fd 客户端连接的文件描述符
+ * @param addr 客户端连接的地址信息
+ */
+void SubReactor::AddClient_(int fd, const sockaddr_in &addr) {
+    assert(fd > 0);
+    if (fd >= users_.MaxFd()) {
+        SendError_(fd, "Server busy!");
+        return;
+    }
+    HttpConn *client = users_.Acquire(fd);
+    client->init(fd, addr);
+    client->Touch(nowMs_);
+    if (timeoutMS_ > 0) {
+        timer_->add(fd, timeoutMS_, std::bind(&SubReactor::CloseExpired_, this, client, client->GetGen()));
+    }
+    epoller_->AddConnFd(fd, EPOLLIN | connEvent_, client->GetGen());
+    LOG_INFO("Client[%d] in SubReactor[%d]!", fd, id_);
+}
+
+/**
+ * @brief 关闭客户端连接
+ *
+ * @param client
+ */
+void SubReactor::CloseConn_(HttpConn *client) {
+    assert(client);
+    LOG_INFO("Client[%d] quit!", client->GetFd());
+    epoller_->DelFd(client->GetFd());
+    client->Close();
+}
+
+/**
+ * @brief 定时器到期时关闭连接;连接已关闭或fd已被复用时忽略
+ *
+ * @param client
+ * @param gen 添加定时器时连接的代数
+ */
+void SubReactor::CloseExpired_(HttpConn *client, uint32_t gen) {
+    if (client->GetGen() != gen) { return; }
+    if (lazyTimeout_) {
+        int64_t idle = nowMs_ - client->LastActive();
+        if (idle < timeoutMS_) {
+            /* 期间有过活动,按剩余时间重新添加,真正空闲满timeoutMS_才关闭 */
+            timer_->add(client->GetFd(), timeoutMS_ - static_cast<int>(idle),
+                        std::bind(&SubReactor::CloseExpired_, this, client, gen));
+            return;
+        }
+    }
+    CloseConn_(client);
+}
+
+/**
+ * @brief 更新客户端连接的超时时间
+ *
+ * @param client
+ */
+void SubReactor::ExtentTime_(HttpConn *client) {
+    assert(client);
+    if (lazyTimeout_) {
+        client->Touch(nowMs_);
+    } else if (timeoutMS_ > 0) {
+        timer_->adjust(client->GetFd(), timeoutMS_);
+    }
+}
+
+/**
+ * @brief 读取请求数据并直接在本线程中处理
+ *
+ * @param client
+ */
+void SubReactor::OnRead_(HttpConn *client) {
+    assert(client);
+    int readErrno = 0;
+    ssize_t ret = client->read(&readErrno, [this](int fd, Buffer &buff, int *err) {
+        return epoller_->Recv(fd, buff, err);
+    });
+    if (ret <= 0 && readErrno != EAGAIN) {
+        CloseConn_(client);
+        return;
+    }
+    OnProcess_(client);
+}
+
+/**
+ * @brief 解析请求,有完整的请求时直接在本线程中发送响应
+ * 读事件到达时EPOLLOUT一定未注册,请求不完整时保持监听EPOLLIN即可,不需要ModFd
+ *
+ * @param client
+ */
+void SubReactor::OnProcess_(HttpConn *client) {
+    if (client->process()) {
+        OnWrite_(client, false);
+    }
+}
+
+/**
+ * @brief 发送响应数据,保持连接时接着处理读缓冲区中已有的请求
+ * 只在发送遇到EAGAIN时注册EPOLLOUT,之后也只有注册过EPOLLOUT才改回EPOLLIN,
+ * 一次请求通常不需要任何epoll_ctl
+ *
+ * @param client
+ * @param outArmed 当前是否监听EPOLLOUT(即由写事件触发)
+ */
+void SubReactor::OnWrite_(HttpConn *client, bool outArmed) {
+    assert(client);
+    int writeErrno = 0;
+    ssize_t ret;
+    do {
+        ret = client->write(&writeErrno, [this](int fd, const struct iovec *iov, int iovCnt, bool more, int *err) {
+            return epoller_->Send(fd, iov, iovCnt, more, err);
+        });
+        if (client->ToWriteBytes() != 0) { break; }
+        /* 传输完成 */
+        client->LogAccess();
+        if (!client->IsKeepAlive()) {
+            CloseConn_(client);
+            return;
+        }
+    } while (client->process());
+
+    if (client->ToWriteBytes() == 0) {
+        /* 等待下一个请求 */
+        if (outArmed) { epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN, client->GetGen()); }
+        return;
+    }
+    if (ret < 0 && writeErrno == EAGAIN) {
+        /* 继续传输 */
+        if (!outArmed) { epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, client->GetGen()); }
+        return;
+    }
+    CloseConn_(client);
+}
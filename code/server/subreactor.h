@@ -0,0 +1,97 @@
+#ifndef SUBREACTOR_H
+#define SUBREACTOR_H
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <unistd.h>        // close()
+#include <assert.h>
+#include <errno.h>
+#include <sys/eventfd.h>   // eventfd()
+#include <sys/socket.h>    // accept4()
+#include <netinet/in.h>
+
+#include "poller.h"
+#include "conntable.h"
+#include "../log/log.h"
+#include "../config/config.h"
+#include "../affinity/cpuaffinity.h"
+#include "../timer/timer.h"
+#include "../http/httpconn.h"
+
+//子Reactor,即one loop per thread中的一个loop
+//每个子Reactor独占一个线程、一个Poller(epoll或io_uring)、一个Timer以及属于自己的那部分连接,
+//连接上的读、解析、写全部在本线程内完成,不再经过线程池,也不需要EPOLLONESHOT重新注册;
+//响应在解析后直接发送,只有发送遇到EAGAIN时才注册EPOLLOUT
+//主Reactor accept到新连接后调用AddClient,通过eventfd唤醒对应的子Reactor接管该连接;
+//SO_REUSEPORT分片模式下则由SetListenFd交给本loop一个独立的监听fd,由本loop自己accept
+class SubReactor {
+public:
+    SubReactor(int id, int timeoutMS, uint32_t connEvent, const Config &config = Config());
+
+    ~SubReactor();
+
+    void Start();
+
+    void Stop();
+
+    void AddClient(int fd, const sockaddr_in &addr);
+
+    void SetListenFd(int listenFd, uint32_t listenEvent);
+
+    int GetId() const { return id_; }
+
+    int GetCpu() const { return cpu_; }
+
+    uint64_t AcceptCount() const { return acceptCount_; }
+
+private:
+    void Loop_();
+
+    void DealListen_();
+
+    void SendError_(int fd, const char *info);
+
+    void HandleWakeup_();
+
+    void AddClient_(int fd, const sockaddr_in &addr);
+
+    void CloseConn_(HttpConn *client);
+
+    void CloseExpired_(HttpConn *client, uint32_t gen);
+
+    void ExtentTime_(HttpConn *client);
+
+    void OnRead_(HttpConn *client);
+
+    void OnWrite_(HttpConn *client, bool outArmed);
+
+    void OnProcess_(HttpConn *client);
+
+    static const int MAX_FD = 65536;
+
+    int id_;
+    int cpu_;              //loop线程绑定的CPU, -1表示不绑定
+    bool lazyTimeout_;     //见Config::lazyTimeout
+    int64_t nowMs_;        //每轮Wait返回后缓存的Timer::CoarseMs()
+    int timeoutMS_;    /* 毫秒MS */
+    uint32_t connEvent_;
+    int wakeupFd_;     //主Reactor投递新连接时写入,唤醒本loop
+    std::atomic<bool> isClose_;
+
+    int listenFd_;     //分片模式下本loop独占的SO_REUSEPORT监听fd,否则为-1
+    uint32_t listenEvent_;
+    std::atomic <uint64_t> acceptCount_;
+
+    std::unique_ptr <Timer> timer_;
+    std::unique_ptr <Poller> epoller_;
+    ConnTable users_;
+
+    std::mutex mtx_;   //只保护pending_
+    std::vector <std::pair<int, sockaddr_in>> pending_;
+    std::thread thread_;
+};
+
+#endif //SUBREACTOR_H
@@ -0,0 +1,941 @@
+#include "uringpoller.h"
+#include "../buffer/buffer.h"
+
+#include <sys/socket.h>
+
+using namespace std;
+
+/**
+ * 构造函数,创建io_uring实例并映射SQ/CQ环形队列
+ * 内核不支持io_uring或缺少IORING_FEAT_EXT_ARG(5.11+)时IsValid()返回false,由调用方回退到epoll
+ * @param maxEvent 单次Wait最多返回的事件数,同时决定SQ的大小
+ */
+UringPoller::UringPoller(int maxEvent) :
+        ringFd_(-1), multishot_(true), acceptMulti_(true), recvMulti_(true), sqPtr_(MAP_FAILED), cqPtr_(MAP_FAILED),
+        sqSize_(0), cqSize_(0), sqes_(static_cast<io_uring_sqe *>(MAP_FAILED)), sqesSize_(0), sqPending_(0),
+        waitSeq_(0), bufRing_(nullptr), bufBase_(nullptr), bufRingSize_(0), bufTail_(0), held_(0),
+        events_(maxEvent) {
+    assert(maxEvent > 0);
+    if (!Setup_(static_cast<unsigned>(maxEvent))) {
+        if (ringFd_ >= 0) {
+            close(ringFd_);
+            ringFd_ = -1;
+        }
+    }
+}
+
+/**
+ * 析构函数,关闭已接受但未取走的连接,解除映射并关闭io_uring实例
+ */
+UringPoller::~UringPoller() {
+    for (FdState &st : fds_) {
+        for (int fd : st.accepted) { close(fd); }
+    }
+    if (sqes_ != MAP_FAILED) { munmap(sqes_, sqesSize_); }
+    if (cqPtr_ != MAP_FAILED && cqPtr_ != sqPtr_) { munmap(cqPtr_, cqSize_); }
+    if (sqPtr_ != MAP_FAILED) { munmap(sqPtr_, sqSize_); }
+    if (ringFd_ >= 0) { close(ringFd_); }
+    //实例关闭后内核不再使用提供缓冲区
+    if (bufRing_) { munmap(bufRing_, bufRingSize_ + BUF_COUNT * BUF_SIZE); }
+}
+
+/**
+ * 调用io_uring_setup并映射三块共享内存: SQ环、CQ环、SQE数组
+ * @param entries SQ大小,CQ为其4倍以容纳multishot产生的事件
+ * @return
+ */
+bool UringPoller::Setup_(unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 4;
+    ringFd_ = static_cast<int>(syscall(SYS_io_uring_setup, entries, &p));
+    if (ringFd_ < 0) { return false; }
+    //带超时的等待依赖IORING_ENTER_EXT_ARG
+    if (!(p.features & IORING_FEAT_EXT_ARG)) { return false; }
+
+    sqSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        sqSize_ = cqSize_ = max(sqSize_, cqSize_);
+    }
+    sqPtr_ = mmap(nullptr, sqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqPtr_ == MAP_FAILED) { return false; }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        cqPtr_ = sqPtr_;
+    } else {
+        cqPtr_ = mmap(nullptr, cqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqPtr_ == MAP_FAILED) { return false; }
+    }
+    sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) { return false; }
+
+    char *sq = static_cast<char *>(sqPtr_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    char *cq = static_cast<char *>(cqPtr_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+    sqPending_ = *sqTail_;
+    return true;
+}
+
+/**
+ * 注册提供缓冲区环: 环与BUF_COUNT个缓冲区放在同一块匿名映射中,全部缓冲区一开始就交给内核
+ * @return 内核不支持IORING_REGISTER_PBUF_RING(5.19+)时返回false
+ */
+bool UringPoller::SetupBufRing_() {
+    bufRingSize_ = BUF_COUNT * sizeof(io_uring_buf);
+    void *mem = mmap(nullptr, bufRingSize_ + BUF_COUNT * BUF_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) { return false; }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(mem);
+    reg.ring_entries = BUF_COUNT;
+    reg.bgid = BUF_GROUP;
+    if (syscall(SYS_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(mem, bufRingSize_ + BUF_COUNT * BUF_SIZE);
+        return false;
+    }
+    bufRing_ = static_cast<io_uring_buf_ring *>(mem);
+    bufBase_ = static_cast<char *>(mem) + bufRingSize_;
+    for (unsigned i = 0; i < BUF_COUNT; i++) { RecycleBuf_(static_cast<uint16_t>(i)); }
+    CommitBufs_();
+    return true;
+}
+
+/**
+ * 把缓冲区放回环尾,CommitBufs_之后内核才能看到
+ * 环的tail与第一个槽位的保留字段重叠,只能逐个字段赋值;
+ * 头文件中的bufs在C++下前面多了一个空结构体的成员,偏移不为0,因此直接按io_uring_buf数组访问
+ * @param bid
+ */
+void UringPoller::RecycleBuf_(uint16_t bid) {
+    io_uring_buf *buf = reinterpret_cast<io_uring_buf *>(bufRing_) + (bufTail_ & (BUF_COUNT - 1));
+    buf->addr = reinterpret_cast<uint64_t>(bufBase_ + static_cast<size_t>(bid) * BUF_SIZE);
+    buf->len = BUF_SIZE;
+    buf->bid = bid;
+    bufTail_++;
+}
+
+/**
+ * 发布环尾,归还的缓冲区对内核可见
+ */
+void UringPoller::CommitBufs_() {
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+}
+
+/**
+ * 取得fd对应的状态,必要时扩容
+ * @param fd
+ * @return
+ */
+UringPoller::FdState &UringPoller::State_(int fd) {
+    if (static_cast<size_t>(fd) >= fds_.size()) {
+        fds_.resize(max(static_cast<size_t>(fd) + 1, fds_.size() * 2));
+    }
+    return fds_[fd];
+}
+
+/**
+ * 在本地尾指针处取一个空闲的SQE,SQ已满时先发布并提交一次
+ * 取出的SQE在CommitSqe_之前对内核不可见,调用者填完全部字段后再发布
+ * @return
+ */
+io_uring_sqe *UringPoller::GetSqe_() {
+    if (sqPending_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        CommitSqe_();
+        Enter_(sqEntries_, 0, 0);
+    }
+    unsigned idx = sqPending_ & sqMask_;
+    io_uring_sqe *sqe = &sqes_[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    sqPending_++;
+    return sqe;
+}
+
+/**
+ * 发布已填好的SQE: release写tail,之后任何线程的io_uring_enter都能提交它们
+ */
+void UringPoller::CommitSqe_() {
+    __atomic_store_n(sqTail_, sqPending_, __ATOMIC_RELEASE);
+}
+
+/**
+ * 需要由POLL_ADD监听的事件: accept/recv模式下EPOLLIN与EPOLLRDHUP由请求的结果给出
+ * @param st
+ * @return 不需要poll时为0
+ */
+uint32_t UringPoller::PollMask_(const FdState &st) const {
+    if (st.mode == MODE_POLL) { return st.events; }
+    uint32_t mask = st.events & ~(EPOLLIN | EPOLLRDHUP);
+    return (mask & ~(EPOLLET | EPOLLONESHOT)) ? mask : 0;
+}
+
+/**
+ * 按fd当前注册的事件追加一个POLL_ADD请求
+ * @param fd
+ */
+void UringPoller::PrepPoll_(int fd) {
+    FdState &st = fds_[fd];
+    bool multi = multishot_ && (st.events & EPOLLET) && !(st.events & EPOLLONESHOT);
+    io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = PollMask_(st) & ~(EPOLLONESHOT | (multi ? 0 : EPOLLET));
+    sqe->len = multi ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = UserData_(fd, st.gen);
+    st.armed = true;
+    CommitSqe_();
+}
+
+/**
+ * 追加一个POLL_REMOVE请求,撤销fd当前这一代的poll
+ * @param fd
+ */
+void UringPoller::PrepRemove_(int fd) {
+    FdState &st = fds_[fd];
+    io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = UserData_(fd, st.gen);
+    sqe->user_data = REMOVE_TAG;
+    st.armed = false;
+    CommitSqe_();
+}
+
+/**
+ * 追加一个multishot accept请求,接受的连接直接设为非阻塞
+ * @param fd 监听fd
+ */
+void UringPoller::PrepAccept_(int fd) {
+    FdState &st = fds_[fd];
+    io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = UserData_(fd, st.regGen, OP_ACCEPT);
+    st.opArmed = true;
+    CommitSqe_();
+}
+
+/**
+ * 追加一个multishot recv请求,每次收到的数据放在从提供缓冲区环中取出的一个缓冲区里
+ * @param fd 连接fd
+ */
+void UringPoller::PrepRecv_(int fd) {
+    FdState &st = fds_[fd];
+    io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->user_data = UserData_(fd, st.regGen, OP_RECV);
+    st.opArmed = true;
+    st.stalled = false;
+    CommitSqe_();
+}
+
+/**
+ * 追加一个ASYNC_CANCEL请求,撤销fd这一代的accept/recv或整串send
+ * @param fd
+ * @param op
+ */
+void UringPoller::PrepCancel_(int fd, Op op) {
+    FdState &st = fds_[fd];
+    io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = UserData_(fd, st.regGen, op);
+    sqe->user_data = REMOVE_TAG;
+    if (op == OP_SEND) {
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+    } else {
+        st.opArmed = false;
+    }
+    CommitSqe_();
+}
+
+/**
+ * 把每段iov追加为一个send请求,以IOSQE_IO_LINK串成一条链;MSG_WAITALL使每段发完才开始下一段,
+ * 某段出错或未发完时其后的请求以-ECANCELED结束
+ * 整串填完才一起发布,以免另一线程的io_uring_enter只提交了前半串、把链截断
+ * @param fd 连接fd
+ * @param iov
+ * @param iovCnt 不超过SQ大小
+ * @param more 链之后还有数据要发送
+ */
+void UringPoller::PrepSend_(int fd, const struct iovec *iov, int iovCnt, bool more) {
+    FdState &st = fds_[fd];
+    if (sqPending_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) + iovCnt > sqEntries_) {
+        CommitSqe_();
+        Enter_(sqEntries_, 0, 0);
+    }
+    for (int i = 0; i < iovCnt; i++) {
+        bool last = i + 1 == iovCnt;
+        io_uring_sqe *sqe = GetSqe_();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(iov[i].iov_base);
+        sqe->len = static_cast<uint32_t>(iov[i].iov_len);
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL | ((!last || more) ? MSG_MORE : 0);
+        sqe->flags = last ? 0 : IOSQE_IO_LINK;
+        sqe->user_data = UserData_(fd, st.regGen, OP_SEND);
+    }
+    CommitSqe_();
+    st.sending = true;
+    st.sendLeft = static_cast<unsigned>(iovCnt);
+    st.sent = 0;
+    st.sendErr = 0;
+}
+
+/**
+ * 追加一个NOP,它的完成事件让阻塞在Wait中的线程返回
+ */
+void UringPoller::PrepWake_() {
+    io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = WAKE_TAG;
+    CommitSqe_();
+}
+
+/**
+ * 调用io_uring_enter,提交请求并可选地等待完成事件
+ * @param toSubmit 提交数量,大于SQ中实际待提交数时内核只提交实际数量
+ * @param minComplete 至少等待的完成事件数
+ * @param timeoutMs 等待超时,-1表示一直等待
+ * @return
+ */
+int UringPoller::Enter_(unsigned toSubmit, unsigned minComplete, int timeoutMs) {
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    memset(&arg, 0, sizeof(arg));
+    if (minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        arg.sigmask_sz = _NSIG / 8;
+        if (timeoutMs >= 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+    }
+    return static_cast<int>(syscall(SYS_io_uring_enter, ringFd_, toSubmit, minComplete, flags,
+                                    minComplete > 0 ? &arg : nullptr, minComplete > 0 ? sizeof(arg) : 0));
+}
+
+/**
+ * 非Wait线程修改了SQ时立即提交,否则Wait线程阻塞期间该请求无法生效
+ */
+void UringPoller::SubmitIfForeign_() {
+    if (owner_ != std::thread::id() && owner_ != this_thread::get_id() &&
+        __atomic_load_n(sqTail_, __ATOMIC_RELAXED) != __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE)) {
+        Enter_(sqEntries_, 0, 0);
+    }
+}
+
+/**
+ * 撤销fd在内核中的请求,归还未取走的数据占用的缓冲区,关闭未取走的连接
+ * 代数加一,之后旧请求的完成事件都会因代数不匹配而被丢弃
+ * 在途的send引用调用者的内存,注销之后这些内存随连接关闭而释放或复用:
+ * 链上尚未开始的请求要等前一个完成才发出,ASYNC_CANCEL找不到它们,因此先shutdown(SHUT_WR),
+ * 之后发出的send在读取内存之前就以-EPIPE失败;等待套接字可写的send再由撤销请求立即结束
+ * 注销时还有send在途说明连接正被关闭,调用者随后会close
+ * @param fd
+ */
+void UringPoller::Reset_(int fd) {
+    FdState &st = fds_[fd];
+    if (st.armed) { PrepRemove_(fd); }
+    if (st.opArmed) { PrepCancel_(fd, st.mode == MODE_ACCEPT ? OP_ACCEPT : OP_RECV); }
+    if (st.sending) {
+        shutdown(fd, SHUT_WR);
+        PrepCancel_(fd, OP_SEND);
+        Enter_(sqEntries_, 0, 0);
+    }
+    if (!st.chunks.empty()) {
+        for (const Chunk &chunk : st.chunks) { RecycleBuf_(chunk.bid); }
+        held_ -= st.chunks.size();
+        st.chunks.clear();
+        CommitBufs_();
+    }
+    for (int accepted : st.accepted) { close(accepted); }
+    st.accepted.clear();
+    st.events = 0;
+    st.gen++;
+    st.regGen++;
+    st.mode = MODE_POLL;
+    st.stalled = st.capped = st.cancelling = st.eof = st.fresh = st.reported = false;
+    st.sending = st.sendDone = st.outFresh = false;
+    st.sendLeft = 0;
+    st.sent = 0;
+    st.sendErr = 0;
+    st.err = 0;
+}
+
+/**
+ * 按模式注册fd并追加对应的请求
+ * @param fd
+ * @param events
+ * @param tag
+ * @param mode
+ */
+void UringPoller::Register_(int fd, uint32_t events, uint32_t tag, Mode mode) {
+    assert(fd < (1 << 24));     //user_data中fd占低24位
+    FdState &st = State_(fd);
+    Reset_(fd);
+    st.events = events;
+    st.tag = tag;
+    st.mode = mode;
+    if (mode == MODE_ACCEPT) { PrepAccept_(fd); }
+    if (mode == MODE_RECV) { PrepRecv_(fd); }
+    if (PollMask_(st)) { PrepPoll_(fd); }
+    SubmitIfForeign_();
+}
+
+/**
+ * 注册一个新的fd
+ * @param fd
+ * @param events
+ * @param tag
+ * @return
+ */
+bool UringPoller::AddFd(int fd, uint32_t events, uint32_t tag) {
+    if (fd < 0) return false;
+    lock_guard <mutex> locker(mtx_);
+    Register_(fd, events, tag, MODE_POLL);
+    return true;
+}
+
+/**
+ * 注册监听fd,内核支持时用multishot accept
+ * @param fd
+ * @param events
+ * @return
+ */
+bool UringPoller::AddListenFd(int fd, uint32_t events) {
+    if (fd < 0) return false;
+    lock_guard <mutex> locker(mtx_);
+    Register_(fd, events, 0, acceptMulti_ ? MODE_ACCEPT : MODE_POLL);
+    return true;
+}
+
+/**
+ * 注册连接fd,内核支持时用multishot recv,首次调用时注册提供缓冲区环
+ * @param fd
+ * @param events
+ * @param tag
+ * @return
+ */
+bool UringPoller::AddConnFd(int fd, uint32_t events, uint32_t tag) {
+    if (fd < 0) return false;
+    lock_guard <mutex> locker(mtx_);
+    if (recvMulti_ && !bufRing_) { recvMulti_ = SetupBufRing_(); }
+    Register_(fd, events, tag, recvMulti_ ? MODE_RECV : MODE_POLL);
+    return true;
+}
+
+/**
+ * 修改fd监听的事件;旧的poll仍在内核中时先撤销再重新注册
+ * accept/recv请求不受影响;已有未取走的连接、数据或send的结果时与EPOLL_CTL_MOD一样重新报告EPOLLIN/EPOLLOUT
+ * @param fd
+ * @param events
+ * @param tag
+ * @return
+ */
+bool UringPoller::ModFd(int fd, uint32_t events, uint32_t tag) {
+    if (fd < 0) return false;
+    lock_guard <mutex> locker(mtx_);
+    FdState &st = State_(fd);
+    if (st.events == 0) return false;
+    if (st.armed) { PrepRemove_(fd); }
+    st.events = events;
+    st.tag = tag;
+    st.gen++;
+    st.reported = false;
+    if (PollMask_(st)) { PrepPoll_(fd); }
+    if (events & EPOLLIN) { RearmCapped_(fd); }
+    if (HasPending_(st)) { st.fresh = true; }
+    if (st.sendDone) { st.outFresh = true; }
+    Notify_(fd);
+    SubmitIfForeign_();
+    return true;
+}
+
+/**
+ * 注销fd,之后该fd旧请求的完成事件都会因代数不匹配而被丢弃
+ * @param fd
+ * @return
+ */
+bool UringPoller::DelFd(int fd) {
+    if (fd < 0) return false;
+    lock_guard <mutex> locker(mtx_);
+    FdState &st = State_(fd);
+    if (st.events == 0) return false;
+    Reset_(fd);
+    SubmitIfForeign_();
+    return true;
+}
+
+/**
+ * 取出一个multishot accept已接受的连接
+ * @param listenFd
+ * @param addr
+ * @return
+ */
+int UringPoller::Accept(int listenFd, struct sockaddr_in *addr) {
+    int fd = -1;
+    {
+        lock_guard <mutex> locker(mtx_);
+        if (listenFd < 0 || static_cast<size_t>(listenFd) >= fds_.size() || fds_[listenFd].mode != MODE_ACCEPT) {
+            fd = -2;
+        } else {
+            FdState &st = fds_[listenFd];
+            if (st.accepted.empty()) {
+                errno = st.err ? st.err : EAGAIN;
+                st.err = 0;
+                return -1;
+            }
+            fd = st.accepted.front();
+            st.accepted.erase(st.accepted.begin());
+        }
+    }
+    if (fd == -2) { return Poller::Accept(listenFd, addr); }
+    socklen_t len = sizeof(*addr);
+    if (getpeername(fd, reinterpret_cast<struct sockaddr *>(addr), &len) < 0) { memset(addr, 0, sizeof(*addr)); }
+    return fd;
+}
+
+/**
+ * 把multishot recv收到的数据复制到buff并归还缓冲区;数据取完之后才返回对端关闭或错误
+ * @param fd
+ * @param buff
+ * @param saveErrno
+ * @return
+ */
+ssize_t UringPoller::Recv(int fd, Buffer &buff, int *saveErrno) {
+    {
+        lock_guard <mutex> locker(mtx_);
+        if (fd >= 0 && static_cast<size_t>(fd) < fds_.size() && fds_[fd].mode == MODE_RECV) {
+            FdState &st = fds_[fd];
+            if (st.chunks.empty()) {
+                if (st.eof) { return 0; }
+                *saveErrno = st.err ? st.err : EAGAIN;
+                return -1;
+            }
+            size_t len = 0;
+            for (const Chunk &chunk : st.chunks) {
+                buff.Append(bufBase_ + static_cast<size_t>(chunk.bid) * BUF_SIZE, chunk.len);
+                len += chunk.len;
+                RecycleBuf_(chunk.bid);
+            }
+            held_ -= st.chunks.size();
+            st.chunks.clear();
+            CommitBufs_();
+            RearmCapped_(fd);
+            RearmStalled_();
+            SubmitIfForeign_();
+            return static_cast<ssize_t>(len);
+        }
+    }
+    return Poller::Recv(fd, buff, saveErrno);
+}
+
+/**
+ * recv模式的连接fd上把iov提交为一串链接的send,返回EAGAIN;全部完成后报告EPOLLOUT,再次调用时返回结果
+ * 链只完成了一部分(出错或对端不再接收)时返回已发送的字节数,剩余部分由下一次调用重新提交
+ * @param fd
+ * @param iov
+ * @param iovCnt
+ * @param more
+ * @param saveErrno
+ * @return
+ */
+ssize_t UringPoller::Send(int fd, const struct iovec *iov, int iovCnt, bool more, int *saveErrno) {
+    {
+        lock_guard <mutex> locker(mtx_);
+        if (fd >= 0 && static_cast<size_t>(fd) < fds_.size()) {
+            FdState &st = fds_[fd];
+            if (st.sending) {
+                *saveErrno = EAGAIN;
+                return -1;
+            }
+            if (st.sendDone) {
+                st.sendDone = false;
+                size_t len = st.sent;
+                int err = st.sendErr;
+                st.sent = 0;
+                st.sendErr = 0;
+                if (len > 0) { return static_cast<ssize_t>(len); }
+                *saveErrno = err ? err : EIO;
+                return -1;
+            }
+            if (st.mode == MODE_RECV && st.events != 0 && static_cast<unsigned>(iovCnt) <= sqEntries_) {
+                PrepSend_(fd, iov, iovCnt, more);
+                SubmitIfForeign_();
+                *saveErrno = EAGAIN;
+                return -1;
+            }
+        }
+    }
+    return Poller::Send(fd, iov, iovCnt, more, saveErrno);
+}
+
+/**
+ * 缓冲区耗尽而停止的recv在有缓冲区归还后重新提交
+ */
+void UringPoller::RearmStalled_() {
+    if (stalled_.empty() || held_ >= BUF_COUNT) { return; }
+    for (int fd : stalled_) {
+        FdState &st = fds_[fd];
+        //达到单fd上限的由RearmCapped_恢复
+        if (st.stalled && !st.capped && st.mode == MODE_RECV && st.events != 0 && !st.opArmed) { PrepRecv_(fd); }
+    }
+    stalled_.clear();
+}
+
+/**
+ * 达到单fd上限而撤销的recv在数据被取走、且撤销已完成后重新提交
+ * @param fd
+ */
+void UringPoller::RearmCapped_(int fd) {
+    FdState &st = fds_[fd];
+    if (!st.capped || st.cancelling || st.chunks.size() >= FD_CHUNK_LIMIT) { return; }
+    st.capped = false;
+    if (st.mode == MODE_RECV && st.events != 0 && !st.opArmed && !st.eof && st.err == 0) { PrepRecv_(fd); }
+}
+
+/**
+ * @return fd是否有未取走的连接或数据,或者有待返回的对端关闭、错误
+ */
+bool UringPoller::HasPending_(const FdState &st) const {
+    if (st.mode == MODE_ACCEPT) { return !st.accepted.empty() || st.err != 0; }
+    if (st.mode == MODE_RECV) { return !st.chunks.empty() || st.eof || st.err != 0; }
+    return false;
+}
+
+/**
+ * 由ready_报告的事件,EPOLLONESHOT下报告过之后为0:
+ * EPOLLIN: 有待取走的连接或数据,边沿触发时要有新到达的数据
+ * EPOLLOUT: 有已完成、结果尚未被Send取走的send,边沿触发时要是新完成的或ModFd之后
+ * @param st
+ * @return
+ */
+uint32_t UringPoller::ReadyMask_(const FdState &st) const {
+    if (st.events == 0 || ((st.events & EPOLLONESHOT) && st.reported)) { return 0; }
+    bool et = st.events & EPOLLET;
+    uint32_t mask = 0;
+    if ((st.events & EPOLLIN) && HasPending_(st) && (!et || st.fresh)) { mask |= EPOLLIN; }
+    if ((st.events & EPOLLOUT) && st.sendDone && (!et || st.outFresh)) { mask |= EPOLLOUT; }
+    return mask;
+}
+
+/**
+ * 有可报告的事件时把fd放入ready_;Wait所在线程可能正阻塞着,由其他线程调用时用一个NOP把它唤醒
+ * @param fd
+ */
+void UringPoller::Notify_(int fd) {
+    if (!ReadyMask_(fds_[fd])) { return; }
+    Ready_(fd);
+    if (owner_ != std::thread::id() && owner_ != this_thread::get_id()) { PrepWake_(); }
+}
+
+/**
+ * 把fd放入ready_,由Wait报告
+ * @param fd
+ */
+void UringPoller::Ready_(int fd) {
+    FdState &st = fds_[fd];
+    if (!st.inReady) {
+        st.inReady = true;
+        ready_.push_back(fd);
+    }
+}
+
+/**
+ * 把事件写入events_,同一轮中同一fd的多个事件合并成一个
+ * @param fd
+ * @param mask
+ * @param n 本轮已有的事件数
+ */
+void UringPoller::AddEvent_(int fd, uint32_t mask, int &n) {
+    FdState &st = fds_[fd];
+    if (st.waitSeq == waitSeq_) {
+        events_[st.slot].events |= mask;
+    } else {
+        st.waitSeq = waitSeq_;
+        st.slot = n;
+        events_[n].events = mask;
+        events_[n].data.u64 = EventData(fd, st.tag);
+        n++;
+    }
+    if (st.events & EPOLLONESHOT) { st.reported = true; }
+}
+
+/**
+ * 处理一个完成事件: poll的结果直接作为事件;accept/recv的结果先存起来,由ready_统一报告
+ * 带缓冲区的完成事件不论是否过期,缓冲区都要么存入chunks要么归还
+ * @param cqe
+ * @param n 本轮已有的事件数
+ */
+void UringPoller::HandleCqe_(const io_uring_cqe *cqe, int &n) {
+    if (cqe->user_data == REMOVE_TAG || cqe->user_data == WAKE_TAG) { return; }
+    int fd = static_cast<int>(cqe->user_data & 0xffffff);
+    Op op = static_cast<Op>((cqe->user_data >> 24) & 0xff);
+    uint32_t gen = static_cast<uint32_t>(cqe->user_data >> 32);
+    bool hasBuf = cqe->flags & IORING_CQE_F_BUFFER;
+    uint16_t bid = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+    FdState *st = static_cast<size_t>(fd) < fds_.size() ? &fds_[fd] : nullptr;
+
+    if (op == OP_POLL) {
+        if (!st || st->gen != gen || st->events == 0) { return; }   /* 已被Mod/Del替换的旧请求 */
+        if (!more) { st->armed = false; }
+        uint32_t mask;
+        if (cqe->res == -EINVAL && multishot_ && (st->events & EPOLLET) && !(st->events & EPOLLONESHOT)) {
+            /* 内核不支持multishot poll,退化为每次触发后重新提交 */
+            multishot_ = false;
+            PrepPoll_(fd);
+            return;
+        } else if (cqe->res == -ECANCELED) {
+            mask = 0;
+        } else if (cqe->res < 0) {
+            mask = EPOLLERR;
+        } else {
+            mask = static_cast<uint32_t>(cqe->res);
+        }
+        /* send在途时套接字可写不代表可以再发,EPOLLOUT在整串完成后由ready_报告 */
+        if (st->sending) { mask &= ~EPOLLOUT; }
+        /* 水平触发或multishot被内核终止时重新注册,EPOLLONESHOT则等待ModFd;send在途时等它完成再注册,以免反复触发 */
+        if (!st->armed && !(st->events & EPOLLONESHOT) && PollMask_(*st) && !st->sending) { PrepPoll_(fd); }
+        if (mask == 0 || ((st->events & EPOLLONESHOT) && st->reported)) { return; }
+        AddEvent_(fd, mask, n);
+        return;
+    }
+
+    if (op == OP_SEND) {
+        if (!st || st->regGen != gen || !st->sending) { return; }
+        if (cqe->res > 0) {
+            st->sent += cqe->res;
+        } else if (cqe->res < 0 && cqe->res != -ECANCELED && st->sendErr == 0) {
+            st->sendErr = -cqe->res;
+        }
+        /* 链上每个请求都有完成事件,被前面的失败取消的以-ECANCELED结束 */
+        if (--st->sendLeft == 0) {
+            st->sending = false;
+            st->sendDone = true;
+            st->outFresh = true;
+            Ready_(fd);
+            if (!st->armed && !(st->events & EPOLLONESHOT) && PollMask_(*st)) { PrepPoll_(fd); }
+        }
+        return;
+    }
+
+    Mode mode = op == OP_ACCEPT ? MODE_ACCEPT : MODE_RECV;
+    if (!st || st->regGen != gen || st->events == 0 || st->mode != mode) {
+        /* 已注销的fd残留的完成事件 */
+        if (hasBuf) {
+            RecycleBuf_(bid);
+            CommitBufs_();
+        }
+        if (op == OP_ACCEPT && cqe->res >= 0) { close(cqe->res); }
+        return;
+    }
+    if (!more) {
+        st->opArmed = false;
+        st->cancelling = false;
+    }
+    if (cqe->res == -ECANCELED) {
+        RearmCapped_(fd);
+        return;
+    }
+    if (op == OP_ACCEPT) {
+        if (cqe->res >= 0) {
+            st->accepted.push_back(cqe->res);
+        } else if (cqe->res == -EINVAL && st->accepted.empty()) {
+            /* 内核不支持multishot accept,改为poll监听fd,由调用者自己accept */
+            acceptMulti_ = false;
+            st->mode = MODE_POLL;
+            PrepPoll_(fd);
+            return;
+        } else {
+            st->err = -cqe->res;
+        }
+        if (!st->opArmed) { PrepAccept_(fd); }
+    } else {
+        if (cqe->res > 0 && hasBuf) {
+            st->chunks.push_back({bid, static_cast<uint16_t>(cqe->res)});
+            held_++;
+            hasBuf = false;
+            if (st->chunks.size() >= FD_CHUNK_LIMIT && !st->capped) {
+                /* 调用者不取数据时停止接收,已在途的完成事件仍会到达 */
+                st->capped = true;
+                if (st->opArmed) {
+                    PrepCancel_(fd, OP_RECV);
+                    st->cancelling = true;
+                }
+            }
+        } else if (cqe->res == 0) {
+            st->eof = true;
+        } else if (cqe->res == -ENOBUFS) {
+            /* 缓冲区耗尽,等Recv归还后再收 */
+            st->stalled = true;
+            stalled_.push_back(fd);
+        } else if (cqe->res == -EINVAL && st->chunks.empty() && !st->eof) {
+            /* 内核不支持multishot recv,改为poll连接fd,由调用者自己读 */
+            recvMulti_ = false;
+            st->mode = MODE_POLL;
+            if (st->armed) { PrepRemove_(fd); }
+            st->gen++;
+            PrepPoll_(fd);
+        } else if (cqe->res < 0) {
+            st->err = -cqe->res;
+        }
+        if (hasBuf) {
+            RecycleBuf_(bid);
+            CommitBufs_();
+        }
+        if (st->mode != MODE_RECV || cqe->res == -ENOBUFS) { return; }
+        /* multishot被内核提前结束(如CQ溢出)而连接仍正常时重新提交 */
+        if (!st->opArmed && !st->capped && cqe->res > 0) { PrepRecv_(fd); }
+    }
+    st->fresh = true;
+    Ready_(fd);
+}
+
+/**
+ * 报告ready_中的fd: 水平触发的fd留在ready_中,数据未取完或仍可发送时下一轮继续报告;
+ * 边沿触发与EPOLLONESHOT的fd移出,由新的完成事件或ModFd重新加入
+ * @param n 本轮已有的事件数
+ */
+void UringPoller::ReportReady_(int &n) {
+    size_t keep = 0;
+    for (int fd : ready_) {
+        FdState &st = fds_[fd];
+        uint32_t mask = ReadyMask_(st);
+        if (!mask) {
+            st.inReady = false;
+            continue;
+        }
+        if (n >= static_cast<int>(events_.size())) {
+            ready_[keep++] = fd;
+            continue;
+        }
+        if (mask & EPOLLIN) {
+            if (st.eof) { mask |= st.events & EPOLLRDHUP; }
+            if (st.err != 0 && st.mode == MODE_RECV) { mask |= EPOLLERR; }
+            st.fresh = false;
+        }
+        if (mask & EPOLLOUT) { st.outFresh = false; }
+        AddEvent_(fd, mask, n);
+        if (st.events & (EPOLLET | EPOLLONESHOT)) {
+            st.inReady = false;
+        } else {
+            ready_[keep++] = fd;
+        }
+    }
+    ready_.resize(keep);
+}
+
+/**
+ * @return ready_中是否有本轮就要报告的fd,有则Wait不阻塞
+ */
+bool UringPoller::HasReady_() const {
+    for (int fd : ready_) {
+        if (ReadyMask_(fds_[fd])) { return true; }
+    }
+    return false;
+}
+
+/**
+ * 等待事件;只收到撤销、唤醒等内部完成事件时继续等待,与epoll_wait一样有事件或超时才返回
+ * @param timeoutMs
+ * @return 就绪的fd数量,出错返回-1
+ */
+int UringPoller::Wait(int timeoutMs) {
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(max(timeoutMs, 0));
+    for (;;) {
+        int n = WaitOnce_(timeoutMs);
+        if (n != 0 || timeoutMs == 0) { return n; }
+        if (timeoutMs > 0) {
+            auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+            if (left <= 0) { return 0; }
+            timeoutMs = static_cast<int>(left);
+        }
+    }
+}
+
+/**
+ * 提交所有积压的请求并等待一轮,一次io_uring_enter完成"提交+等待"
+ * 提交数按SQ大小传入,由内核在进入时按当时已发布的tail截取;释放锁之后其他线程可能已提交过
+ * 或又发布了新的请求,事先算好的数量会与之不符
+ * 同一轮中同一fd的多个完成事件会被合并成一个
+ * @param timeoutMs
+ * @return 就绪的fd数量,出错返回-1
+ */
+int UringPoller::WaitOnce_(int timeoutMs) {
+    bool ready = false;
+    {
+        lock_guard <mutex> locker(mtx_);
+        owner_ = this_thread::get_id();
+        ready = *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) || HasReady_();
+    }
+    int ret = Enter_(sqEntries_, (ready || timeoutMs == 0) ? 0 : 1, timeoutMs);
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+        return -1;
+    }
+
+    lock_guard <mutex> locker(mtx_);
+    waitSeq_++;
+    int n = 0;
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    while (head != tail && n < static_cast<int>(events_.size())) {
+        HandleCqe_(&cqes_[head & cqMask_], n);
+        head++;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    RearmStalled_();
+    ReportReady_(n);
+    return n;
+}
+
+/**
+ * 获取第i个事件的fd
+ * @param i
+ * @return
+ */
+int UringPoller::GetEventFd(size_t i) const {
+    assert(i < events_.size());
+    return static_cast<int>(events_[i].data.u64 & 0xffffffff);
+}
+
+/**
+ * 获取第i个事件的掩码
+ * @param i
+ * @return
+ */
+uint32_t UringPoller::GetEvents(size_t i) const {
+    assert(i < events_.size());
+    return events_[i].events;
+}
+
+/**
+ * 获取第i个事件对应fd注册时附带的tag
+ * @param i
+ * @return
+ */
+uint32_t UringPoller::GetEventTag(size_t i) const {
+    assert(i < events_.size());
+    return static_cast<uint32_t>(events_[i].data.u64 >> 32);
+}
@@ -0,0 +1,231 @@
+#ifndef URING_POLLER_H
+#define URING_POLLER_H
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>   // EPOLLIN/EPOLLET...
+#include <sys/mman.h>    // mmap()
+#include <sys/syscall.h> // SYS_io_uring_setup
+#include <unistd.h>      // close()
+#include <signal.h>      // _NSIG
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+#include "poller.h"
+
+//基于io_uring的IO多路复用后端,对外提供与Epoller相同的接口
+//每个fd对应一个IORING_OP_POLL_ADD请求:
+//  EPOLLET且无EPOLLONESHOT -> multishot poll, 一次注册持续产生事件
+//  EPOLLONESHOT            -> 单次poll, 触发后需要ModFd重新注册
+//  水平触发                -> 单次poll, 每次触发后自动重新提交,从而得到LT语义
+//Add/Mod/Del只往SQ中追加请求,在下一次Wait时与等待合并为一次io_uring_enter,
+//从而省去epoll_ctl的系统调用;若由非Wait所在线程调用(线程池模式),则立即提交以免请求滞留
+//SQE先在本地尾指针处填好,再以release写SQ的tail发布,另一线程的io_uring_enter不会读到未填完的SQE
+//AddListenFd注册的fd使用multishot accept(5.19+): 一个请求持续接受连接,新fd在Accept中直接取出,不再调用accept
+//AddConnFd注册的fd使用multishot recv + 提供缓冲区环(6.0+): 内核把数据收进环中的缓冲区,Recv只做一次内存复制;
+//  EPOLLIN/EPOLLRDHUP由recv的结果给出,其余事件(EPOLLOUT)仍用POLL_ADD;缓冲区耗尽时recv暂停,Recv归还缓冲区后恢复;
+//  单个fd未取走的数据达到FD_CHUNK_LIMIT个缓冲区时撤销它的recv,剩余数据留在套接字中,由TCP流控限制对端,
+//  以免一个不读响应却持续发送的客户端占满缓冲区、让同一循环中的其他连接都收不到数据
+//  Send把每段iov提交为一个带MSG_WAITALL的IORING_OP_SEND,以IOSQE_IO_LINK串成一条链按序发送,整串一起发布;
+//  不用IORING_OP_WRITEV是因为它对O_NONBLOCK的套接字直接返回-EAGAIN,而send会等套接字可写后继续;
+//  链在途时Send返回EAGAIN且poll得到的EPOLLOUT不报告,整串完成后报告EPOLLOUT,下一次Send取走结果
+//内核不支持时这两类fd退回POLL_ADD,Accept/Recv退回accept4/readv
+//仅依赖内核头文件,不需要liburing
+class UringPoller : public Poller {
+public:
+    explicit UringPoller(int maxEvent = 1024);
+
+    ~UringPoller() override;
+
+    bool IsValid() const { return ringFd_ >= 0; }
+
+    bool AddFd(int fd, uint32_t events, uint32_t tag = 0) override;
+
+    bool ModFd(int fd, uint32_t events, uint32_t tag = 0) override;
+
+    bool DelFd(int fd) override;
+
+    bool AddListenFd(int fd, uint32_t events) override;
+
+    bool AddConnFd(int fd, uint32_t events, uint32_t tag = 0) override;
+
+    int Accept(int listenFd, struct sockaddr_in *addr) override;
+
+    ssize_t Recv(int fd, Buffer &buff, int *saveErrno) override;
+
+    ssize_t Send(int fd, const struct iovec *iov, int iovCnt, bool more, int *saveErrno) override;
+
+    int Wait(int timeoutMs = -1) override;
+
+    int GetEventFd(size_t i) const override;
+
+    uint32_t GetEvents(size_t i) const override;
+
+    uint32_t GetEventTag(size_t i) const override;
+
+    const char *Name() const override { return "io_uring"; }
+
+private:
+    enum Mode : uint8_t {
+        MODE_POLL,      //POLL_ADD
+        MODE_ACCEPT,    //multishot accept
+        MODE_RECV,      //multishot recv + 链接的send,EPOLLOUT等仍用POLL_ADD
+    };
+
+    enum Op : uint8_t {
+        OP_POLL,
+        OP_ACCEPT,
+        OP_RECV,
+        OP_SEND,
+    };
+
+    /* recv收到的一段数据,位于提供缓冲区bid中 */
+    struct Chunk {
+        uint16_t bid;
+        uint16_t len;
+    };
+
+    struct FdState {
+        uint32_t events = 0;   //注册的事件掩码,0表示未注册
+        uint32_t gen = 0;      //poll请求的代数,写入user_data高32位,用于丢弃已失效请求的完成事件
+        uint32_t regGen = 0;   //accept/recv请求的代数,只在Add/Del时变化,ModFd不打断持续的multishot请求
+        uint32_t tag = 0;      //调用者注册时附带的tag,随事件返回
+        Mode mode = MODE_POLL;
+        bool armed = false;    //内核中是否还有一个有效的poll请求
+        bool opArmed = false;  //内核中是否还有一个有效的accept/recv请求
+        bool stalled = false;  //recv因缓冲区耗尽而停止
+        bool capped = false;   //未取走的数据达到FD_CHUNK_LIMIT,recv已撤销
+        bool cancelling = false; //撤销的recv尚未收到最后一个完成事件,此前不能重新提交
+        bool eof = false;      //recv读到了对端关闭
+        bool fresh = false;    //有尚未报告的新连接/数据,边沿触发时据此报告
+        bool reported = false; //EPOLLONESHOT下已报告过,ModFd之前不再报告
+        bool inReady = false;  //是否在ready_中
+        bool sending = false;  //一串send请求尚未全部完成
+        bool sendDone = false; //一串send已完成,结果尚未被Send取走
+        bool outFresh = false; //有尚未报告的可写状态,边沿触发时据此报告
+        unsigned sendLeft = 0; //本串send尚未收到的完成事件数
+        size_t sent = 0;       //本串已发送的字节数
+        int sendErr = 0;       //本串send的错误码
+        int err = 0;           //accept/recv的错误码
+        uint32_t waitSeq = 0;  //本fd最后一次出现在哪一轮Wait中,用于合并同一轮的多个事件
+        int slot = 0;          //本fd在events_中的下标
+        std::vector <Chunk> chunks;   //已收到、尚未被Recv取走的数据
+        std::vector<int> accepted;    //已接受、尚未被Accept取走的连接
+    };
+
+    static const unsigned BUF_SIZE = 4096;   //每个提供缓冲区的大小
+    static const unsigned BUF_COUNT = 512;   //缓冲区个数,2的幂
+    static const unsigned FD_CHUNK_LIMIT = BUF_COUNT / 8;  //单个fd最多占用的缓冲区数
+    static const uint16_t BUF_GROUP = 0;
+
+    bool Setup_(unsigned entries);
+
+    bool SetupBufRing_();
+
+    io_uring_sqe *GetSqe_();
+
+    void CommitSqe_();
+
+    uint32_t PollMask_(const FdState &st) const;
+
+    void PrepPoll_(int fd);
+
+    void PrepRemove_(int fd);
+
+    void PrepAccept_(int fd);
+
+    void PrepRecv_(int fd);
+
+    void PrepCancel_(int fd, Op op);
+
+    void PrepSend_(int fd, const struct iovec *iov, int iovCnt, bool more);
+
+    void PrepWake_();
+
+    void Reset_(int fd);
+
+    void Register_(int fd, uint32_t events, uint32_t tag, Mode mode);
+
+    void RecycleBuf_(uint16_t bid);
+
+    void CommitBufs_();
+
+    void RearmStalled_();
+
+    void RearmCapped_(int fd);
+
+    void Ready_(int fd);
+
+    void ReportReady_(int &n);
+
+    bool HasReady_() const;
+
+    uint32_t ReadyMask_(const FdState &st) const;
+
+    void Notify_(int fd);
+
+    bool HasPending_(const FdState &st) const;
+
+    void AddEvent_(int fd, uint32_t mask, int &n);
+
+    void HandleCqe_(const io_uring_cqe *cqe, int &n);
+
+    int WaitOnce_(int timeoutMs);
+
+    int Enter_(unsigned toSubmit, unsigned minComplete, int timeoutMs);
+
+    void SubmitIfForeign_();
+
+    FdState &State_(int fd);
+
+    static uint64_t UserData_(int fd, uint32_t gen, Op op = OP_POLL) {
+        return (static_cast<uint64_t>(gen) << 32) | (static_cast<uint64_t>(op) << 24) | static_cast<uint32_t>(fd);
+    }
+
+    static const uint64_t REMOVE_TAG = ~0ULL;
+    static const uint64_t WAKE_TAG = ~1ULL;
+
+    int ringFd_;
+    bool multishot_;   //内核是否支持IORING_POLL_ADD_MULTI(5.13+)
+    bool acceptMulti_; //内核是否支持IORING_ACCEPT_MULTISHOT(5.19+)
+    bool recvMulti_;   //内核是否支持提供缓冲区环(5.19+)与IORING_RECV_MULTISHOT(6.0+)
+
+    void *sqPtr_;
+    void *cqPtr_;
+    size_t sqSize_;
+    size_t cqSize_;
+    io_uring_sqe *sqes_;
+    size_t sqesSize_;
+
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned *sqArray_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe *cqes_;
+
+    unsigned sqPending_; //本地的SQ尾: 已填好但尚未发布的SQE在[*sqTail_, sqPending_)中
+    uint32_t waitSeq_;
+    std::thread::id owner_;
+
+    io_uring_buf_ring *bufRing_;  //首次AddConnFd时注册
+    char *bufBase_;
+    size_t bufRingSize_;
+    uint16_t bufTail_;
+    unsigned held_;               //存放在chunks中尚未归还的缓冲区数
+
+    std::mutex mtx_;
+    std::vector <FdState> fds_;
+    std::vector<int> ready_;      //有待报告的新连接/数据或send结果的fd
+    std::vector<int> stalled_;    //recv因缓冲区耗尽而停止的fd
+    std::vector <struct epoll_event> events_;
+};
+
+#endif //URING_POLLER_H
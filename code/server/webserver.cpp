@@ -18,39 +18,110 @@ using namespace std;
  * @param openLog 是否打开日志系统
  * @param logLevel 日志等级
  * @param logQueSize 日志缓存长度
+ * @param config 其余可选配置,见config.h
  */
 WebServer::WebServer(
         int port, int trigMode, int timeoutMS, bool OptLinger,
         int sqlPort, const char *sqlUser, const char *sqlPwd,
         const char *dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize) :
-        port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-        timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller()) {
+        bool openLog, int logLevel, int logQueSize, const Config &config) :
+        port_(port), openLinger_(OptLinger), lazyTimeout_(config.lazyTimeout), nowMs_(Timer::CoarseMs()),
+        timeoutMS_(timeoutMS), isClose_(false),
+        listenFd_(-1), timer_(Timer::NewTimer(config.useTimingWheel, config.wheelTickMs)), epoller_(Poller::NewPoller(config.useUring)), users_(MAX_FD),
+        reusePort_(config.reusePort && config.reactorNum > 0),
+        incomingCpu_(config.incomingCpu && config.reusePort && config.reactorNum > 0), nextReactor_(0) {
     srcDir_ = getcwd(nullptr, 256);
     //srcDir_保存资源文件的路径,使用getcwd()函数获取当前工作目录
     assert(srcDir_);
     strncat(srcDir_, "/resources/", 16);
     HttpConn::userCount = 0;
     HttpConn::srcDir = srcDir_;
+    HttpConn::metricsPath = config.metricsPath;
+    HttpRequest::maxHeaderSize = config.maxHeaderSize;
+    HttpResponse::sendfileThreshold = config.sendfileThreshold;
+    Deflater::level = config.compressLevel;
+    Deflater::minSize = config.compressMinSize;
+    FileCache::Instance()->Init(config.fileCacheBytes, config.fileCacheMaxFile);
     SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
 
     InitEventMode_(trigMode);               //初始化触发模式
+
+    if (config.reactorNum > 0) {
+        //one loop per thread: 每个子Reactor在自己的线程中完成读写,不再需要线程池
+        for (int i = 0; i < config.reactorNum; i++) {
+            reactors_.emplace_back(new SubReactor(i, timeoutMS_, connEvent_, config));
+        }
+    } else {
+        //每个工作线程启动后先绑定CPU,再分配自己的任务队列
+        vector<int> cpus = CpuAffinity::ParseList(config.workerCpus);
+        threadpool_.reset(new ThreadPool(threadNum, 1 << 16, config.workStealing, [cpus](size_t i) {
+            CpuAffinity::PinThread(CpuAffinity::Pick(cpus, i));
+        }));
+    }
     if (!InitSocket_()) { isClose_ = true; }//初始化套接字连接
 
+    //文件选项需在打开日志之前设置,对普通日志和访问日志相同
+    LogFileOptions logFile;
+    logFile.maxFileBytes = config.logFileBytes;
+    logFile.keepFiles = config.logKeepFiles;
+    logFile.useMmap = config.logMmap;
+    bool compressValid = LogArchiver::ParseCompress(config.logCompress, &logFile.compress);
+    Log::Instance()->SetFileOptions(logFile);
+    AccessLog::SetFileOptions(logFile);
     if (openLog) {
-        Log::Instance()->init(logLevel, "./log", ".log", logQueSize);
+        Log::Instance()->init(logLevel, "./log", config.logBinary ? ".blog" : ".log", logQueSize, config.logCpu,
+                              config.logBinary);
         if (isClose_) { LOG_ERROR("========== Server init error!=========="); }
         else {
             LOG_INFO("========== Server init ==========");
             LOG_INFO("Port:%d, OpenLinger: %s", port_, OptLinger ? "true" : "false");
-            LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
+            LOG_INFO("Listen Mode: %s, OpenConn Mode: %s, ReusePort: %s",
                      (listenEvent_ & EPOLLET ? "ET" : "LT"),
-                     (connEvent_ & EPOLLET ? "ET" : "LT"));
+                     (connEvent_ & EPOLLET ? "ET" : "LT"),
+                     reusePort_ ? "true" : "false");
+            LOG_INFO("IO Backend: %s%s", epoller_->Name(),
+                     (config.useUring && string(epoller_->Name()) != "io_uring") ? " (io_uring unavailable)" : "");
+            LOG_INFO("Timer: %s%s%s", timer_->Name(),
+                     config.useTimingWheel ? (", tick " + to_string(config.wheelTickMs) + "ms").c_str() : "",
+                     lazyTimeout_ ? ", lazy refresh" : "");
+            LOG_INFO("FileCache: %zuMB, max file %zuKB, sendfile threshold: %zuKB", config.fileCacheBytes >> 20,
+                     config.fileCacheMaxFile >> 10, config.sendfileThreshold >> 10);
             LOG_INFO("LogSys level: %d", logLevel);
+            if (config.logFileBytes > 0 || config.logKeepFiles > 0 || !config.logCompress.empty() || config.logMmap) {
+                LOG_INFO("LogFile: max %zuKB, keep %d, compress %s%s, mmap: %s", config.logFileBytes >> 10,
+                         config.logKeepFiles, config.logCompress.empty() ? "none" : config.logCompress.c_str(),
+                         compressValid ? "" : " (unknown)", config.logMmap ? "true" : "false");
+            }
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            if (reactors_.empty()) {
+                LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, WorkStealing: %s", connPoolNum, threadNum,
+                         config.workStealing ? "true" : "false");
+            } else {
+                LOG_INFO("SqlConnPool num: %d, SubReactor num: %d", connPoolNum, (int) reactors_.size());
+            }
         }
     }
+    if (!config.metricsPath.empty()) {
+        InitMetrics_();
+        LOG_INFO("Metrics: %s", config.metricsPath.c_str());
+    }
+    //访问日志与普通日志相互独立,沿用日志的环容量与写线程CPU
+    AccessLog::Format accessFormat;
+    if (AccessLog::ParseFormat(config.accessLog, &accessFormat)) {
+        AccessLog::Init(accessFormat, config.accessLogSample, "./log", ".access.log", logQueSize, config.logCpu);
+        LOG_INFO("AccessLog: %s, sample 1/%d", config.accessLog.c_str(), max(config.accessLogSample, 1));
+    } else if (!config.accessLog.empty()) {
+        LOG_WARN("AccessLog: unknown format %s", config.accessLog.c_str());
+    }
+    //新线程继承创建者的CPU掩码,主线程要等其他线程(工作线程、子Reactor、日志写线程、文件监视线程)都创建之后再绑定,
+    //否则未指定CPU的线程也会被限制在mainCpu上
+    bool mainPinned = CpuAffinity::PinThread(config.mainCpu);
+    if (config.mainCpu >= 0 || !config.workerCpus.empty() || config.logCpu >= 0) {
+        LOG_INFO("CPU affinity: main %d%s (node %d), workers [%s], log %d, SO_INCOMING_CPU: %s",
+                 config.mainCpu, (config.mainCpu >= 0 && !mainPinned) ? " failed" : "",
+                 CpuAffinity::NodeOf(config.mainCpu), config.workerCpus.c_str(), config.logCpu,
+                 incomingCpu_ ? "true" : "false");
+    }
 }
 
 /**
@@ -58,8 +129,10 @@ WebServer::WebServer(
  * 
  */
 WebServer::~WebServer() {
-    close(listenFd_);       //关闭服务器监听文件描述符
     isClose_ = true;        //标记服务器已经关闭
+    Metrics::ClearGauges(); //gauge的回调引用了本对象的成员
+    reactors_.clear();      //停止并回收所有子Reactor线程
+    close(listenFd_);       //关闭服务器监听文件描述符
     free(srcDir_);    //释放资源文件路径
     SqlConnPool::Instance()->ClosePool();   //关闭数据库连接池
 }
@@ -106,29 +179,42 @@ void WebServer::Start() {
     //循环检测是否关闭服务器
     if (!isClose_) {
         LOG_INFO("========== Server start ==========");
+        for (auto &reactor: reactors_) {
+            reactor->Start();
+        }
+    }
+    //分片模式下各子Reactor自行accept,主线程只定期输出各分片的accept计数
+    while (!isClose_ && reusePort_) {
+        epoller_->Wait(SHARD_STAT_MS);
+        LogShardStat_();
     }
     while (!isClose_) {
         if (timeoutMS_ > 0) {
             //设置Epoll的超时时间
             timeMS = timer_->GetNextTick();
+            Metrics::SetTimers(timer_->size());
         }
         //调用Epoll的Wait函数等待事件
         int eventCnt = epoller_->Wait(timeMS);
+        nowMs_ = Timer::CoarseMs();     //本轮事件共用一个时间
         for (int i = 0; i < eventCnt; i++) {
             /* 处理事件 */
             int fd = epoller_->GetEventFd(i);
             uint32_t events = epoller_->GetEvents(i);
             if (fd == listenFd_) {      //处理监听事件
                 DealListen_();
+                continue;
+            }
+            //按fd直接取连接,代数与注册时不符说明是已关闭连接残留的事件
+            HttpConn *client = users_.Get(fd, epoller_->GetEventTag(i));
+            if (!client) {
+                continue;
             } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {   //处理关闭事件
-                assert(users_.count(fd) > 0);
-                CloseConn_(&users_[fd]);
+                CloseConn_(client);
             } else if (events & EPOLLIN) {  //处理读取请求
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
+                DealRead_(client);
             } else if (events & EPOLLOUT) { //处理写入请求
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
+                DealWrite_(client);
             } else {
                 LOG_ERROR("Unexpected event");
             }
@@ -136,6 +222,38 @@ void WebServer::Start() {
     }
 }
 
+/**
+ * @brief 登记抓取时读取的gauge;计数器与定时器个数由各线程自己累加,不在这里登记
+ *
+ */
+void WebServer::InitMetrics_() {
+    Metrics::AddGauge("webserver_connections_active", "Open client connections (HttpConn::userCount).",
+                      [] { return HttpConn::userCount.load(); });
+    if (threadpool_) {
+        ThreadPool *pool = threadpool_.get();
+        Metrics::AddGauge("webserver_threadpool_queue_depth", "Tasks waiting in the thread pool queues.",
+                          [pool] { return pool->QueueSize(); });
+    }
+    Metrics::AddGauge("webserver_sqlconnpool_free_connections", "Idle connections in the MySQL pool.",
+                      [] { return SqlConnPool::Instance()->GetFreeConnCount(); });
+    Metrics::AddGauge("webserver_log_queue_bytes", "Bytes waiting in the log rings for the writer thread.",
+                      [] { return Log::Instance()->QueueBytes(); });
+    Metrics::AddGauge("webserver_access_log_queue_bytes", "Bytes waiting in the access log rings.",
+                      [] { return AccessLog::QueueBytes(); });
+}
+
+/**
+ * @brief 输出每个SO_REUSEPORT分片累计accept的连接数,用于观察内核分发是否均匀
+ * 
+ */
+void WebServer::LogShardStat_() {
+    string stat;
+    for (auto &reactor: reactors_) {
+        stat += " [" + to_string(reactor->GetId()) + "]:" + to_string(reactor->AcceptCount());
+    }
+    LOG_INFO("Shard accept count:%s", stat.c_str());
+}
+
 /**
  * @brief 将指定的错误信息info发送给客户端
  * 
@@ -166,6 +284,26 @@ void WebServer::CloseConn_(HttpConn *client) {
     client->Close();
 }
 
+/**
+ * @brief 定时器到期时关闭连接;连接已关闭或fd已被复用时忽略
+ * 
+ * @param client 
+ * @param gen 添加定时器时连接的代数
+ */
+void WebServer::CloseExpired_(HttpConn *client, uint32_t gen) {
+    if (client->GetGen() != gen) { return; }
+    if (lazyTimeout_) {
+        int64_t idle = nowMs_ - client->LastActive();
+        if (idle < timeoutMS_) {
+            /* 期间有过活动,按剩余时间重新添加,真正空闲满timeoutMS_才关闭 */
+            timer_->add(client->GetFd(), timeoutMS_ - static_cast<int>(idle),
+                        std::bind(&WebServer::CloseExpired_, this, client, gen));
+            return;
+        }
+    }
+    CloseConn_(client);
+}
+
 /**
  * @brief 向服务器添加一个新的客户端连接
  * 将新的客户端连接添加到Web服务器的事件循环中，
@@ -176,16 +314,19 @@ void WebServer::CloseConn_(HttpConn *client) {
  */
 void WebServer::AddClient_(int fd, sockaddr_in addr) {
     assert(fd > 0);
-    users_[fd].init(fd, addr);  //初始化客户端连接
+    HttpConn *client = users_.Acquire(fd);
+    client->init(fd, addr);  //初始化客户端连接
+    client->Touch(nowMs_);
     if (timeoutMS_ > 0) {     
         //添加一个定时器，定时器会在指定的超时时间后关闭该客户端连接  
-        //使用std::bind绑定WebServer对象和HttpConn对象的引用，以便在CloseConn_函数中可以访问HttpConn对象的成员
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+        //同时绑定连接当前的代数,fd被复用后旧定时器不会误关新连接
+        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseExpired_, this, client, client->GetGen()));
     }
     //添加到epoll实例中，注册EPOLLIN事件，即可读事件，并将事件类型(connEvent_)加入到epoll事件表中
-    epoller_->AddFd(fd, EPOLLIN | connEvent_);  
+    //连接的代数作为tag一并注册,随事件返回
+    epoller_->AddConnFd(fd, EPOLLIN | connEvent_, client->GetGen());  
     SetFdNonblock(fd);  //设置为非阻塞模式，以便异步IO操作
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
 /**
@@ -194,20 +335,25 @@ void WebServer::AddClient_(int fd, sockaddr_in addr) {
  */
 void WebServer::DealListen_() {
     struct sockaddr_in addr;     //存储新连接的地址信息
-    socklen_t len = sizeof(addr);//存储addr变量的长度
-    //监听新的客户端连接
+    //监听新的客户端连接,io_uring后端下连接已由内核接受,这里只是取出
     do {
-        int fd = accept(listenFd_, (struct sockaddr *) &addr, &len);
+        int fd = epoller_->Accept(listenFd_, &addr);
         //如果accept函数返回的文件描述符fd小于等于0，就直接返回，表示没有新的连接到来
         if (fd <= 0) { return; }
         //如果当前连接的数量(HttpConn::userCount)已经超过了Web服务器可以处理的最大连接数(MAX_FD)，
         //就调用SendError_函数向新的连接返回错误信息，然后记录一个日志表示连接已满，
         //然后直接返回，不再处理该连接
-        else if (HttpConn::userCount >= MAX_FD) {
+        else if (HttpConn::userCount >= MAX_FD || fd >= users_.MaxFd()) {
             SendError_(fd, "Server busy!");
             LOG_WARN("Clients is full!");
             return;
         }
+        //one loop per thread模式下,通过eventfd把新连接轮询分发给子Reactor
+        if (!reactors_.empty()) {
+            SetFdNonblock(fd);
+            reactors_[nextReactor_++ % reactors_.size()]->AddClient(fd, addr);
+            continue;
+        }
         //如果当前连接数量还没有达到最大值，
         //就调用WebServer类的AddClient_函数，
         //将新的连接添加到Web服务器中，处理该连接
@@ -226,9 +372,13 @@ void WebServer::DealRead_(HttpConn *client) {
     assert(client);         //检查client指针是否为空
     ExtentTime_(client);    //更新客户端连接的超时时间
     //将一个任务添加到线程池中,该任务是一个绑定到OnRead_函数上的函数对象
-    //绑定的对象是WebServer对象本身和client指针
-    //以便在OnRead_函数中可以访问到HttpConn对象的成员
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client));
+    //绑定的对象是WebServer对象本身、client指针和连接当前的代数
+    //任务执行前连接若已关闭或fd已被复用,OnRead_会据代数丢弃该任务
+    //以fd为key,工作窃取模式下同一连接的任务优先由同一个线程执行
+    auto task = std::bind(&WebServer::OnRead_, this, client, client->GetGen());
+    //任务直接构造在线程池队列的槽位中,放不下时编译失败,而不是每个请求分配一次内存
+    static_assert(Task::FitsInline<decltype(task)>(), "read task must fit in Task's inline storage");
+    threadpool_->AddTask(client->GetFd(), std::move(task));
 }
 
 /**
@@ -240,9 +390,11 @@ void WebServer::DealWrite_(HttpConn *client) {
     assert(client);     //检查client指针是否为空
     ExtentTime_(client);//更新客户端连接的超时时间
     //将一个任务添加到线程池中,该任务是一个绑定到OnWrite_函数上的函数对象
-    //绑定的对象是WebServer对象本身和client指针
-    //以便在OnWrite_函数中可以访问到HttpConn对象的成员
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+    //绑定的对象是WebServer对象本身、client指针和连接当前的代数
+    auto task = std::bind(&WebServer::OnWrite_, this, client, client->GetGen());
+    //任务直接构造在线程池队列的槽位中,放不下时编译失败,而不是每个请求分配一次内存
+    static_assert(Task::FitsInline<decltype(task)>(), "write task must fit in Task's inline storage");
+    threadpool_->AddTask(client->GetFd(), std::move(task));
 }
 
 /**
@@ -252,7 +404,10 @@ void WebServer::DealWrite_(HttpConn *client) {
  */
 void WebServer::ExtentTime_(HttpConn *client) {
     assert(client);
-    if (timeoutMS_ > 0) {
+    if (lazyTimeout_) {
+        //惰性模式只记录最后活跃时间,定时任务到期时再检查
+        client->Touch(nowMs_);
+    } else if (timeoutMS_ > 0) {
         //将client对象的文件描述符和timeoutMS_变量作为参数传递给Timer类的adjust函数
         timer_->adjust(client->GetFd(), timeoutMS_);
     }
@@ -262,13 +417,17 @@ void WebServer::ExtentTime_(HttpConn *client) {
  * @brief 处理客户端连接的读事件
  * 
  * @param client 需要处理的客户端连接
+ * @param gen 任务入队时连接的代数
  */
-void WebServer::OnRead_(HttpConn *client) {
+void WebServer::OnRead_(HttpConn *client, uint32_t gen) {
     assert(client);
+    if (client->GetGen() != gen) { return; }   //连接已关闭,任务过期
     int ret = -1;
     int readErrno = 0;
     //将读取到的数据保存到client对象的inBuf_成员变量中
-    ret = client->read(&readErrno);
+    ret = client->read(&readErrno, [this](int fd, Buffer &buff, int *err) {
+        return epoller_->Recv(fd, buff, err);
+    });
     if (ret <= 0 && readErrno != EAGAIN) {
         CloseConn_(client);
         return;
@@ -285,10 +444,10 @@ void WebServer::OnRead_(HttpConn *client) {
 void WebServer::OnProcess(HttpConn *client) {
     if (client->process()) {    //如果client对象的process函数返回值为true，表示该客户端连接需要进行写操作
         //修改客户端连接的文件描述符的事件类型为可写，从而让Epoll监控该客户端连接的可写事件
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, client->GetGen());
     } else {                    //如果process函数返回值为false，表示该客户端连接需要进行读操作
         //修改客户端连接的文件描述符的事件类型为可读，从而让Epoll监控该客户端连接的可读事件
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN, client->GetGen());
     }
 }
 
@@ -296,15 +455,20 @@ void WebServer::OnProcess(HttpConn *client) {
  * @brief 处理客户端连接的写操作
  * 
  * @param client 表示需要进行写操作的客户端连接
+ * @param gen 任务入队时连接的代数
  */
-void WebServer::OnWrite_(HttpConn *client) {
+void WebServer::OnWrite_(HttpConn *client, uint32_t gen) {
     assert(client);
+    if (client->GetGen() != gen) { return; }   //连接已关闭,任务过期
     int ret = -1;
     int writeErrno = 0;
-    ret = client->write(&writeErrno);
+    ret = client->write(&writeErrno, [this](int fd, const struct iovec *iov, int iovCnt, bool more, int *err) {
+        return epoller_->Send(fd, iov, iovCnt, more, err);
+    });
     //检查客户端连接还有没有未发送完的数据
     if (client->ToWriteBytes() == 0) {  //所有数据都已经发送完毕
         /* 传输完成 */
+        client->LogAccess();
         //客户端连接的HTTP协议版本和是否支持持久连接
         if (client->IsKeepAlive()) {
             //继续处理该客户端连接的下一个请求
@@ -315,7 +479,7 @@ void WebServer::OnWrite_(HttpConn *client) {
         if (writeErrno == EAGAIN) { //当前写缓冲区已满
             /* 继续传输 */
             //修改客户端连接的文件描述符的事件类型为可写，从而让Epoll监控该客户端连接的可写事件
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, client->GetGen());
             return;
         }
     }
@@ -325,17 +489,56 @@ void WebServer::OnWrite_(HttpConn *client) {
 
 /**
  * @brief 初始化服务器的Soccket
+ * 普通模式下创建一个监听fd并注册到主Reactor;
+ * SO_REUSEPORT分片模式下为每个子Reactor各创建一个绑定同一端口的监听fd,由内核做负载均衡
  * 
  */
 /* Create listenFd */
 bool WebServer::InitSocket_() {
-    int ret;
-    struct sockaddr_in addr;
     //1.检查指定的端口是否合法
     if (port_ > 65535 || port_ < 1024) {
         LOG_ERROR("Port:%d error!", port_);
         return false;
     }
+
+    if (reusePort_) {
+        for (auto &reactor: reactors_) {
+            int fd = CreateListenFd_(true);
+            if (fd < 0) { return false; }
+            int cpu = reactor->GetCpu();
+            if (incomingCpu_ && cpu >= 0 && setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0) {
+                LOG_WARN("SO_INCOMING_CPU %d error: %d", cpu, errno);
+            }
+            reactor->SetListenFd(fd, listenEvent_);
+        }
+        LOG_INFO("Server port:%d, SO_REUSEPORT shards:%d", port_, (int) reactors_.size());
+        return true;
+    }
+
+    listenFd_ = CreateListenFd_(false);
+    if (listenFd_ < 0) { return false; }
+
+    //8.开始监听该套接字
+    int ret = epoller_->AddListenFd(listenFd_, listenEvent_ | EPOLLIN);
+    if (ret == 0) {
+        LOG_ERROR("Add listen error!");
+        close(listenFd_);
+        return false;
+    }
+    //9.记录服务器启动的信息,并返回 true
+    LOG_INFO("Server port:%d", port_);
+    return true;
+}
+
+/**
+ * @brief 创建、绑定并监听一个非阻塞的监听套接字
+ * 
+ * @param reusePort 是否设置SO_REUSEPORT,使多个监听fd可以绑定同一端口
+ * @return int 监听fd,失败返回-1
+ */
+int WebServer::CreateListenFd_(bool reusePort) {
+    int ret;
+    struct sockaddr_in addr;
     //2.初始化 sockaddr_in 结构体变量
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -349,59 +552,57 @@ bool WebServer::InitSocket_() {
     }
 
     //4.创建一个 SOCK_STREAM
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (listenFd_ < 0) {
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
         LOG_ERROR("Create socket error!", port_);
-        return false;
+        return -1;
     }
 
-    
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if (ret < 0) {
-        close(listenFd_);
+        close(listenFd);
         LOG_ERROR("Init linger error!", port_);
-        return false;
+        return -1;
     }
 
     int optval = 1;
     //5.设置 SO_REUSEADDR 套接字选项
     /* 端口复用 */
     /* 只有最后一个套接字会正常接收数据。 */
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void *) &optval, sizeof(int));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void *) &optval, sizeof(int));
     if (ret == -1) {
         LOG_ERROR("set socket setsockopt error !");
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
+    }
+    /* 分片监听: 每个监听fd有独立的accept队列,内核按四元组哈希分发新连接 */
+    if (reusePort) {
+        ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, (const void *) &optval, sizeof(int));
+        if (ret == -1) {
+            LOG_ERROR("set SO_REUSEPORT error !");
+            close(listenFd);
+            return -1;
+        }
     }
 
     //6.将套接字绑定到指定的地址
-    ret = bind(listenFd_, (struct sockaddr *) &addr, sizeof(addr));
+    ret = bind(listenFd, (struct sockaddr *) &addr, sizeof(addr));
     if (ret < 0) {
         LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
     }
 
     //7.开始监听该套接字
-    ret = listen(listenFd_, 6);
+    ret = listen(listenFd, 6);
     if (ret < 0) {
         LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
-        return false;
-    }
-
-    //8.开始监听该套接字
-    ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
-    if (ret == 0) {
-        LOG_ERROR("Add listen error!");
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
     }
-    //9.将套接字设置为非阻塞模式
-    SetFdNonblock(listenFd_);
-    //10.记录服务器启动的信息,并返回 true
-    LOG_INFO("Server port:%d", port_);
-    return true;
+    //将套接字设置为非阻塞模式
+    SetFdNonblock(listenFd);
+    return listenFd;
 }
 
 /**
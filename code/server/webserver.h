@@ -1,7 +1,6 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
-#include <unordered_map>
 #include <fcntl.h>       // fcntl()
 #include <unistd.h>      // close()
 #include <assert.h>
@@ -10,9 +9,13 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#include "epoller.h"
+#include "poller.h"
+#include "subreactor.h"
+#include "conntable.h"
+#include "../config/config.h"
+#include "../affinity/cpuaffinity.h"
 #include "../log/log.h"
-#include "../timer/heaptimer.h"
+#include "../timer/timer.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
 #include "../pool/sqlconnRAII.h"
@@ -27,7 +30,8 @@ public:
             int port, int trigMode, int timeoutMS, bool OptLinger,
             int sqlPort, const char *sqlUser, const char *sqlPwd,
             const char *dbName, int connPoolNum, int threadNum,
-            bool openLog, int logLevel, int logQueSize);
+            bool openLog, int logLevel, int logQueSize,
+            const Config &config = Config());
 
     ~WebServer();
 
@@ -36,6 +40,12 @@ public:
 private:
     bool InitSocket_();
 
+    int CreateListenFd_(bool reusePort);
+
+    void LogShardStat_();
+
+    void InitMetrics_();
+
     void InitEventMode_(int trigMode);
 
     void AddClient_(int fd, sockaddr_in addr);
@@ -46,24 +56,30 @@ private:
 
     void DealRead_(HttpConn *client);
 
+    void CloseExpired_(HttpConn *client, uint32_t gen);
+
     void SendError_(int fd, const char *info);
 
     void ExtentTime_(HttpConn *client);
 
     void CloseConn_(HttpConn *client);
 
-    void OnRead_(HttpConn *client);
+    void OnRead_(HttpConn *client, uint32_t gen);
 
-    void OnWrite_(HttpConn *client);
+    void OnWrite_(HttpConn *client, uint32_t gen);
 
     void OnProcess(HttpConn *client);
 
     static const int MAX_FD = 65536;
 
+    static const int SHARD_STAT_MS = 60000;
+
     static int SetFdNonblock(int fd);
 
     int port_;
     bool openLinger_;
+    bool lazyTimeout_;     //见Config::lazyTimeout
+    int64_t nowMs_;        //每轮Wait返回后缓存的Timer::CoarseMs()
     int timeoutMS_;  /* 毫秒MS */
     bool isClose_;
     int listenFd_;
@@ -72,10 +88,17 @@ private:
     uint32_t listenEvent_;
     uint32_t connEvent_;
 
-    std::unique_ptr <HeapTimer> timer_;
+    std::unique_ptr <Timer> timer_;
     std::unique_ptr <ThreadPool> threadpool_;
-    std::unique_ptr <Epoller> epoller_;
-    std::unordered_map<int, HttpConn> users_;
+    std::unique_ptr <Poller> epoller_;
+    ConnTable users_;
+
+    /* one loop per thread模式: 主Reactor只负责accept,连接轮询分发给子Reactor */
+    /* reusePort_为true时每个子Reactor持有自己的SO_REUSEPORT监听fd,主Reactor不再accept */
+    std::vector <std::unique_ptr<SubReactor>> reactors_;
+    bool reusePort_;
+    bool incomingCpu_;     //见Config::incomingCpu
+    size_t nextReactor_;
 };
 
 
@@ -14,12 +14,12 @@
  */
 void HeapTimer::siftup_(size_t i) {
     assert(i >= 0 && i < heap_.size());
-    size_t j = (i - 1) / 2;
-    while (j >= 0) {
+    //i为堆顶时没有父节点;size_t无符号,不能用j >= 0判断
+    while (i > 0) {
+        size_t j = (i - 1) / 2;
         if (heap_[j] < heap_[i]) { break; }
         SwapNode_(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -113,8 +113,20 @@ void HeapTimer::doWork(int id) {
     }
     size_t i = ref_[id];        //从ref_中获取该id对应的定时器堆索引
     TimerNode node = heap_[i];  //从heap_中取出对应的定时器结点
+    del_(i);    //先删除该定时器结点,回调函数中可能再次添加同一id
     node.cb();  //触发回调函数
-    del_(i);    //删除该定时器结点
+}
+
+/**
+ * @brief 删除指定id的结点,不触发回调函数
+ * @param id
+ */
+void HeapTimer::cancel(int id) {
+    auto it = ref_.find(id);
+    if (it == ref_.end()) {
+        return;
+    }
+    del_(it->second);
 }
 
 /**
@@ -172,8 +184,9 @@ void HeapTimer::tick() {
         if (std::chrono::duration_cast<MS>(node.expires - Clock::now()).count() > 0) {
             break;
         }
-        node.cb();
+        //先弹出再回调:回调函数可能重新添加定时任务,之后堆顶就不再是这个结点
         pop();
+        node.cb();
     }
 }
 
@@ -9,13 +9,9 @@
 #include <functional>
 #include <assert.h>
 #include <chrono>
+#include "timer.h"
 #include "../log/log.h"
 
-typedef std::function<void()> TimeoutCallBack;
-typedef std::chrono::high_resolution_clock Clock;
-typedef std::chrono::milliseconds MS;
-typedef Clock::time_point TimeStamp;
-
 //用于存储定时任务的ID、到期时间、回调函数
 struct TimerNode {
     int id;
@@ -30,25 +26,31 @@ struct TimerNode {
 //堆定时器
 //实现事实任务的管理
 //可以添加和移除任务、调整任务的到期时间
-class HeapTimer {
+class HeapTimer : public Timer {
 public:
     HeapTimer() { heap_.reserve(64); }
 
-    ~HeapTimer() { clear(); }
+    ~HeapTimer() override { clear(); }
+
+    void adjust(int id, int newExpires) override;
 
-    void adjust(int id, int newExpires);
+    void add(int id, int timeOut, const TimeoutCallBack &cb) override;
 
-    void add(int id, int timeOut, const TimeoutCallBack &cb);
+    void cancel(int id) override;
 
-    void doWork(int id);
+    void doWork(int id) override;
 
-    void clear();
+    void clear() override;
 
-    void tick();
+    void tick() override;
 
     void pop();
 
-    int GetNextTick();
+    int GetNextTick() override;
+
+    size_t size() const override { return heap_.size(); }
+
+    const char *Name() const override { return "heap"; }
 
 private:
     void del_(size_t i);
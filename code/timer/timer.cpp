@@ -0,0 +1,16 @@
+#include "timer.h"
+#include "heaptimer.h"
+#include "timingwheel.h"
+
+/**
+ * 创建定时器
+ * @param useWheel 是否使用分层时间轮代替小根堆
+ * @param tickMs 时间轮的刻度(毫秒),只对时间轮有效
+ * @return
+ */
+Timer *Timer::NewTimer(bool useWheel, int tickMs) {
+    if (useWheel) {
+        return new TimingWheel(tickMs);
+    }
+    return new HeapTimer();
+}
@@ -0,0 +1,52 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <functional>
+#include <chrono>
+#include <stdint.h>
+#include <time.h>
+
+typedef std::function<void()> TimeoutCallBack;
+typedef std::chrono::high_resolution_clock Clock;
+typedef std::chrono::milliseconds MS;
+typedef Clock::time_point TimeStamp;
+
+//连接超时定时器的公共接口,WebServer与SubReactor只通过它管理定时任务
+//id为连接的fd,同一id同时只有一个定时任务
+//目前有两个实现: HeapTimer(小根堆) 与 TimingWheel(分层时间轮)
+class Timer {
+public:
+    virtual ~Timer() = default;
+
+    virtual void add(int id, int timeout, const TimeoutCallBack &cb) = 0;
+
+    virtual void adjust(int id, int timeout) = 0;
+
+    virtual void cancel(int id) = 0;
+
+    virtual void doWork(int id) = 0;
+
+    virtual void clear() = 0;
+
+    virtual void tick() = 0;
+
+    virtual int GetNextTick() = 0;
+
+    virtual size_t size() const = 0;
+
+    virtual const char *Name() const = 0;
+
+    static Timer *NewTimer(bool useWheel, int tickMs = 10);
+
+    /**
+     * CLOCK_MONOTONIC_COARSE的毫秒值,精度为一个jiffy(通常1~4ms),开销远小于Clock::now()
+     * 供事件循环每轮缓存一次,作为连接的最后活跃时间
+     */
+    static int64_t CoarseMs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+    }
+};
+
+#endif //TIMER_H
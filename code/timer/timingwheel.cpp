@@ -0,0 +1,227 @@
+#include "timingwheel.h"
+
+using namespace std;
+
+/**
+ * @param tickMs 刻度(毫秒),即到期时间的精度
+ */
+TimingWheel::TimingWheel(int tickMs) : tickMs_(tickMs > 0 ? tickMs : 1), start_(Clock::now()), current_(0),
+                                       count_(0) {
+    fill(heads_, heads_ + SLOT_NUM, -1);
+}
+
+/**
+ * @return 构造以来经过的毫秒数
+ */
+int64_t TimingWheel::ElapsedMs_() const {
+    return chrono::duration_cast<MS>(Clock::now() - start_).count();
+}
+
+/**
+ * 把超时毫秒数换算为到期刻度,向上取整,至少为下一个刻度
+ * @param timeout
+ * @return
+ */
+uint64_t TimingWheel::Expires_(int timeout) {
+    uint64_t now = ElapsedMs_() / tickMs_;
+    if (count_ == 0 && now > current_) {
+        /* 轮上没有任务,直接跳到当前刻度,不必逐格空转 */
+        current_ = now;
+    }
+    uint64_t expires = now + (max(timeout, 0) + tickMs_ - 1) / tickMs_;
+    return max(expires, current_ + 1);
+}
+
+/**
+ * @param id
+ * @return id对应的结点,数组按需扩容
+ */
+TimingWheel::Node &TimingWheel::Node_(int id) {
+    assert(id >= 0);
+    if (static_cast<size_t>(id) >= nodes_.size()) {
+        nodes_.resize(max(static_cast<size_t>(id) + 1, nodes_.size() * 2), Node{-1, -1, -1, 0, nullptr});
+    }
+    return nodes_[id];
+}
+
+/**
+ * 按到期刻度与当前刻度的距离选择层和槽
+ * @param id
+ */
+void TimingWheel::Place_(int id) {
+    Node &node = nodes_[id];
+    if (node.expires <= current_) {
+        /* 只在cascade时出现,放入当前槽,随后立即执行 */
+        Link_(id, static_cast<int>(current_ & (ROOT_SIZE - 1)));
+        return;
+    }
+    uint64_t delta = node.expires - current_;
+    if (delta < ROOT_SIZE) {
+        Link_(id, static_cast<int>(node.expires & (ROOT_SIZE - 1)));
+        return;
+    }
+    if (delta > MAX_SPAN) {
+        node.expires = current_ + MAX_SPAN;
+        delta = MAX_SPAN;
+    }
+    int level = 1;
+    while (level < LEVELS - 1 && delta >= (1ULL << (Shift_(level) + LEVEL_BITS))) {
+        level++;
+    }
+    Link_(id, Slot_(level, node.expires));
+}
+
+/**
+ * 挂到槽的链表头部
+ * @param id
+ * @param slot
+ */
+void TimingWheel::Link_(int id, int slot) {
+    Node &node = nodes_[id];
+    node.slot = slot;
+    node.prev = -1;
+    node.next = heads_[slot];
+    if (node.next >= 0) { nodes_[node.next].prev = id; }
+    heads_[slot] = id;
+    count_++;
+}
+
+/**
+ * 从所在槽的链表中摘下
+ * @param id
+ */
+void TimingWheel::Unlink_(int id) {
+    Node &node = nodes_[id];
+    assert(node.slot >= 0);
+    if (node.prev >= 0) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        heads_[node.slot] = node.next;
+    }
+    if (node.next >= 0) { nodes_[node.next].prev = node.prev; }
+    node.slot = -1;
+    count_--;
+}
+
+/**
+ * 向时间轮中添加定时任务,id已存在时更新其到期时间和回调函数
+ * @param id
+ * @param timeout 毫秒
+ * @param cb
+ */
+void TimingWheel::add(int id, int timeout, const TimeoutCallBack &cb) {
+    Node &node = Node_(id);
+    if (node.slot >= 0) { Unlink_(id); }
+    node.cb = cb;
+    node.expires = Expires_(timeout);
+    Place_(id);
+}
+
+/**
+ * 刷新定时任务的到期时间
+ * @param id
+ * @param timeout 毫秒
+ */
+void TimingWheel::adjust(int id, int timeout) {
+    assert(static_cast<size_t>(id) < nodes_.size() && nodes_[id].slot >= 0);
+    Unlink_(id);
+    nodes_[id].expires = Expires_(timeout);
+    Place_(id);
+}
+
+/**
+ * 取消定时任务,不触发回调函数
+ * @param id
+ */
+void TimingWheel::cancel(int id) {
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].slot < 0) { return; }
+    Unlink_(id);
+    nodes_[id].cb = nullptr;
+}
+
+/**
+ * 立即触发并删除定时任务
+ * @param id
+ */
+void TimingWheel::doWork(int id) {
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].slot < 0) { return; }
+    Unlink_(id);
+    TimeoutCallBack cb;
+    cb.swap(nodes_[id].cb);
+    cb();
+}
+
+/**
+ *
+ */
+void TimingWheel::clear() {
+    nodes_.clear();
+    fill(heads_, heads_ + SLOT_NUM, -1);
+    count_ = 0;
+}
+
+/**
+ * 把第level层当前槽的任务重新分配到更低的层
+ * 该层也转完一圈时先从更高一层下移
+ * @param level
+ */
+void TimingWheel::Cascade_(int level) {
+    if (level >= LEVELS) { return; }
+    if (((current_ >> Shift_(level)) & (LEVEL_SIZE - 1)) == 0) {
+        Cascade_(level + 1);
+    }
+    int slot = Slot_(level, current_);
+    while (heads_[slot] >= 0) {
+        int id = heads_[slot];
+        Unlink_(id);
+        Place_(id);
+    }
+}
+
+/**
+ * 执行第0层某个槽上的全部任务
+ * 先摘下结点再调用回调函数,回调函数中可以安全地添加或取消定时任务
+ * @param slot
+ */
+void TimingWheel::RunSlot_(int slot) {
+    while (heads_[slot] >= 0) {
+        int id = heads_[slot];
+        Unlink_(id);
+        TimeoutCallBack cb;
+        cb.swap(nodes_[id].cb);
+        cb();
+    }
+}
+
+/**
+ * 逐个刻度推进到当前时间,执行到期的任务
+ */
+void TimingWheel::tick() {
+    uint64_t now = ElapsedMs_() / tickMs_;
+    while (current_ < now) {
+        if (count_ == 0) {
+            current_ = now;
+            break;
+        }
+        current_++;
+        int slot = static_cast<int>(current_ & (ROOT_SIZE - 1));
+        if (slot == 0) { Cascade_(1); }
+        RunSlot_(slot);
+    }
+}
+
+/**
+ * 获取距下一次需要推进时间轮的毫秒数
+ * 只扫描第0层到下一次cascade为止,cascade时刻也作为一次唤醒
+ * @return 没有任务时返回-1
+ */
+int TimingWheel::GetNextTick() {
+    tick();
+    if (count_ == 0) { return -1; }
+    uint64_t next = current_ + 1;
+    while ((next & (ROOT_SIZE - 1)) != 0 && heads_[next & (ROOT_SIZE - 1)] < 0) {
+        next++;
+    }
+    int64_t res = static_cast<int64_t>(next) * tickMs_ - ElapsedMs_();
+    return res < 0 ? 0 : static_cast<int>(res);
+}
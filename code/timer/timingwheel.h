@@ -0,0 +1,87 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <vector>
+#include <stdint.h>
+#include <assert.h>
+#include "timer.h"
+
+//分层时间轮定时器
+//第0层256个槽,每槽一个刻度;第1~3层各64个槽,每槽分别覆盖256、256*64、256*64*64个刻度
+//刻度为10ms时第0层覆盖2.56秒,总跨度约7.7天,超出的到期时间截断到最大跨度
+//定时任务按id(fd)存放在数组中,以双向链表挂在槽上,添加、刷新、取消都是O(1),不再需要哈希表
+//高层槽在第0层转完一圈时整体下移一层(cascade),到期精度为一个刻度
+class TimingWheel : public Timer {
+public:
+    explicit TimingWheel(int tickMs = 10);
+
+    ~TimingWheel() override { clear(); }
+
+    void add(int id, int timeout, const TimeoutCallBack &cb) override;
+
+    void adjust(int id, int timeout) override;
+
+    void cancel(int id) override;
+
+    void doWork(int id) override;
+
+    void clear() override;
+
+    void tick() override;
+
+    int GetNextTick() override;
+
+    size_t size() const override { return count_; }
+
+    const char *Name() const override { return "wheel"; }
+
+    int TickMs() const { return tickMs_; }
+
+private:
+    struct Node {
+        int prev;           //同一槽上的前一个结点id, -1表示为表头
+        int next;
+        int slot;           //所在槽位, -1表示该id当前没有定时任务
+        uint64_t expires;   //到期刻度
+        TimeoutCallBack cb;
+    };
+
+    static const int LEVELS = 4;
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int ROOT_SIZE = 1 << ROOT_BITS;
+    static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+    static const int SLOT_NUM = ROOT_SIZE + (LEVELS - 1) * LEVEL_SIZE;
+    static const uint64_t MAX_SPAN = (1ULL << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS)) - 1;
+
+    static int Shift_(int level) { return ROOT_BITS + (level - 1) * LEVEL_BITS; }
+
+    static int Slot_(int level, uint64_t expires) {
+        return ROOT_SIZE + (level - 1) * LEVEL_SIZE + static_cast<int>((expires >> Shift_(level)) & (LEVEL_SIZE - 1));
+    }
+
+    int64_t ElapsedMs_() const;
+
+    uint64_t Expires_(int timeout);
+
+    Node &Node_(int id);
+
+    void Place_(int id);
+
+    void Link_(int id, int slot);
+
+    void Unlink_(int id);
+
+    void Cascade_(int level);
+
+    void RunSlot_(int slot);
+
+    int tickMs_;
+    TimeStamp start_;
+    uint64_t current_;   //已处理到的刻度
+    size_t count_;
+    std::vector <Node> nodes_;
+    int heads_[SLOT_NUM];
+};
+
+#endif //TIMING_WHEEL_H
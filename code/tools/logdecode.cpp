@@ -0,0 +1,44 @@
+/* 二进制日志解码工具: ./logdecode 文件... ,按顺序把各文件还原为文本输出到标准输出 */
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include "../log/logdecoder.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s file...\n", argv[0]);
+        return 2;
+    }
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        int fd = open(argv[i], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            perror(argv[i]);
+            if (fd >= 0) { close(fd); }
+            status = 1;
+            continue;
+        }
+        void *data = st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        close(fd);
+        if (data == MAP_FAILED) {
+            perror(argv[i]);
+            status = 1;
+            continue;
+        }
+        /* 每个文件单独解码,调用点的定义在每个文件中都是完整的 */
+        LogDecoder decoder;
+        std::string text;
+        long count = decoder.Decode(static_cast<const char *>(data), st.st_size, text);
+        fwrite(text.data(), 1, text.size(), stdout);
+        if (data) { munmap(data, st.st_size); }
+        if (count < 0) {
+            fprintf(stderr, "%s: not a binary log or truncated record\n", argv[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
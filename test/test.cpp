@@ -4,14 +4,52 @@
  * @copyleft Apache 2.0
  */ 
 #include "../code/log/log.h"
+#include "../code/log/logdecoder.h"
+#include "../code/log/accesslog.h"
+#include "../code/http/httpconn.h"
 #include "../code/pool/threadpool.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/filecache.h"
+#include "../code/http/httpresponse.h"
+#include "../code/http/deflater.h"
+#include "../code/server/conntable.h"
+#include "../code/server/subreactor.h"
+#include "../code/server/uringpoller.h"
+#include "../code/timer/heaptimer.h"
+#include "../code/timer/timingwheel.h"
+#include "../code/affinity/cpuaffinity.h"
+#include "../code/metrics/metrics.h"
 #include <features.h>
+#include <chrono>
+#include <regex>
+#include <queue>
+#include <condition_variable>
+#include <dirent.h>
+#include <zlib.h>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <poll.h>
 
 #if __GLIBC__ == 2 && __GLIBC_MINOR__ < 30
 #include <sys/syscall.h>
 #define gettid() syscall(SYS_gettid)
 #endif
 
+/* 替换全局operator new,统计所有线程的堆分配次数,供TestTask检查任务路径不分配内存 */
+static std::atomic<long long> g_allocs(0);
+
+void *operator new(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) { return p; }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { free(p); }
+
 void TestLog() {
     int cnt = 0, level = 0;
     Log::Instance()->init(level, "./testlog1", ".log", 0);
@@ -35,12 +73,798 @@ void TestLog() {
     }
 }
 
+/**
+ * 读出目录下所有日志文件的行
+ */
+std::vector <std::string> ReadLogLines(const char *dir) {
+    std::vector <std::string> lines;
+    DIR *d = opendir(dir);
+    if (!d) { return lines; }
+    while (struct dirent *entry = readdir(d)) {
+        if (entry->d_name[0] == '.') { continue; }
+        std::ifstream in(std::string(dir) + "/" + entry->d_name);
+        std::string line;
+        while (std::getline(in, line)) { lines.push_back(line); }
+    }
+    closedir(d);
+    return lines;
+}
+
+void WriteFile(const std::string &path, const std::string &content) {
+    FILE *fp = fopen(path.data(), "w");
+    assert(fp);
+    fwrite(content.data(), 1, content.size(), fp);
+    fclose(fp);
+}
+
+/**
+ * 从fd读取,直到读到的内容包含until(为空时直到对端关闭)或超时
+ */
+std::string RecvUntil(int fd, const std::string &until, int timeoutMs = 2000) {
+    std::string data;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (until.empty() || data.find(until) == std::string::npos) {
+        int left = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (left <= 0 || poll(&pfd, 1, left) <= 0) { break; }
+        char buf[4096];
+        ssize_t len = ::read(fd, buf, sizeof(buf));
+        if (len <= 0) { break; }
+        data.append(buf, len);
+    }
+    return data;
+}
+
+void RemoveLogDir(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) { return; }
+    while (struct dirent *entry = readdir(d)) {
+        if (entry->d_name[0] != '.') { unlink((std::string(dir) + "/" + entry->d_name).c_str()); }
+    }
+    closedir(d);
+}
+
+void TestLogRing() {
+    /* 多个线程各自写入,flush后每一行恰好出现一次且完整 */
+    const int THREADS = 4, PER = 30000;
+    RemoveLogDir("./testlog3");
+    Log::Instance()->init(1, "./testlog3", ".log", 1024);
+    std::vector <std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < PER; i++) { LOG_INFO("ring %d %d end", t, i); }
+        });
+    }
+    for (auto &th : threads) { th.join(); }
+    Log::Instance()->flush();
+    std::vector<char> seen(THREADS * PER, 0);
+    int count = 0;
+    for (const std::string &line : ReadLogLines("./testlog3")) {
+        int t, i;
+        if (sscanf(line.c_str() + 27, "[info] : ring %d %d end", &t, &i) == 2) {
+            assert(t >= 0 && t < THREADS && i >= 0 && i < PER && !seen[t * PER + i]);
+            seen[t * PER + i] = 1;
+            count++;
+        }
+    }
+    assert(count == THREADS * PER);
+
+    /* 单行的开销: 异步模式只追加到本线程的环,同步模式每行一次write */
+    const int N = 200000;
+    for (int queue : {1024, 0}) {
+        RemoveLogDir("./testlog3");
+        Log::Instance()->init(1, "./testlog3", ".log", queue);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < N; i++) { LOG_INFO("%s bench line %d", "Test", i); }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+        Log::Instance()->flush();
+        printf("Log %s: %.0f ns/line\n", queue ? "async ring" : "sync write", ns);
+    }
+    RemoveLogDir("./testlog3");
+}
+
+void TestLogLevel() {
+    /* 级别不够时参数不求值;同一秒内的行共用缓存的时间前缀,且与localtime一致 */
+    RemoveLogDir("./testlog3");
+    Log::Instance()->init(2, "./testlog3", ".log", 1024);
+    int evaluated = 0;
+    LOG_INFO("skipped %d", ++evaluated);
+    LOG_DEBUG("skipped %d", ++evaluated);
+    assert(evaluated == 0);
+    time_t before = time(nullptr);
+    for (int i = 0; i < 1000; i++) { LOG_WARN("level %d", ++evaluated); }
+    time_t after = time(nullptr);
+    assert(evaluated == 1000);
+    Log::Instance()->flush();
+    int count = 0;
+    for (const std::string &line : ReadLogLines("./testlog3")) {
+        struct tm t = {};
+        assert(line.size() > 27 && strptime(line.c_str(), "%Y-%m-%d %H:%M:%S", &t) == line.c_str() + 19);
+        t.tm_isdst = -1;
+        time_t sec = mktime(&t);
+        assert(sec >= before && sec <= after && line[19] == '.' && line.compare(26, 9, " [warn] :") == 0);
+        count++;
+    }
+    assert(count == 1000);
+
+    /* 被级别过滤掉的调用只剩一次原子读 */
+    const int N = 10000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) { LOG_INFO("filtered %d", i); }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+    printf("Log filtered call: %.2f ns\n", ns);
+    RemoveLogDir("./testlog3");
+
+    /* 低于LOG_MIN_LEVEL的调用在编译期删除,不会调用Log::Instance();用局部的Log遮住全局的Log来计数 */
+    static int instanceCalls = 0;
+    struct Log {
+        static Log *Instance() { static Log log; instanceCalls++; return &log; }
+        static uint32_t RegisterSite(const char *, const char *, int, const char *) { return 0; }
+        bool IsOpen() { return true; }
+        int GetLevel() { return 0; }
+        bool IsBinary() { return false; }
+        void WriteBinary(int, uint32_t, int) {}
+        void write(int, const char *, int) {}
+    };
+#pragma push_macro("LOG_MIN_LEVEL")
+#undef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 2
+    evaluated = 0;
+    LOG_DEBUG("stripped %d", ++evaluated);
+    LOG_INFO("stripped %d", ++evaluated);
+    assert(instanceCalls == 0 && evaluated == 0);
+    LOG_WARN("kept %d", ++evaluated);
+    assert(instanceCalls == 1 && evaluated == 1);
+#pragma pop_macro("LOG_MIN_LEVEL")
+}
+
+void TestLogBinary() {
+    /* 二进制日志解码后与文本模式的内容一致 */
+    RemoveLogDir("./testlog4");
+    Log::Instance()->init(0, "./testlog4", ".blog", 1024, -1, true);
+    const int THREADS = 4, PER = 20000;
+    std::vector <std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < PER; i++) { LOG_INFO("bin %d %u %s end", t, (unsigned) i, "x"); }
+        });
+    }
+    for (auto &th : threads) { th.join(); }
+    std::string longStr(5000, 'a');
+    size_t bytes = 123456789012ULL;
+    LOG_WARN("mixed %s|%5.2f|%lu|%-4d|%c|%x|%%|%.*s|%s", "str", 3.14159, bytes, -7, 'Z', 255u, 3, "abcdef",
+             (const char *) nullptr);
+    LOG_ERROR("long %s", longStr.c_str());
+    LOG_DEBUG("no args");
+    Log::Instance()->flush();
+
+    std::string text;
+    DIR *d = opendir("./testlog4");
+    assert(d);
+    while (struct dirent *entry = readdir(d)) {
+        if (entry->d_name[0] == '.') { continue; }
+        std::ifstream in(std::string("./testlog4/") + entry->d_name, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        LogDecoder decoder;
+        assert(decoder.Decode(data.data(), data.size(), text) == THREADS * PER + 3);
+
+        /* 崩溃后留下的全0尾部在已写数据处正常结束,尾部之外的损坏仍然报错 */
+        std::string padded = data + std::string(4096 + 5, '\0'), ignored;
+        assert(LogDecoder().Decode(padded.data(), padded.size(), ignored) == THREADS * PER + 3);
+        assert(ignored == text);
+        padded.back() = 1;
+        assert(LogDecoder().Decode(padded.data(), padded.size(), ignored) == -1);
+        std::string truncated = data.substr(0, data.size() - 1);
+        assert(LogDecoder().Decode(truncated.data(), truncated.size(), ignored) == -1);
+    }
+    closedir(d);
+    std::vector<char> seen(THREADS * PER, 0);
+    int count = 0, extra = 0;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        int t, i;
+        unsigned u;
+        if (sscanf(line.c_str() + 27, "[info] : bin %d %u x end", &t, &u) == 2) {
+            i = u;
+            assert(t >= 0 && t < THREADS && i >= 0 && i < PER && !seen[t * PER + i]);
+            seen[t * PER + i] = 1;
+            count++;
+        } else if (line.compare(27, 14, "[warn] : mixed") == 0) {
+            assert(line.substr(36) == "mixed str| 3.14|123456789012|-7  |Z|ff|%|abc|(null)");
+            extra++;
+        } else if (line.compare(27, 13, "[error]: long") == 0) {
+            assert(line.size() > 27 + 14 + 3000 && line.size() < 27 + 14 + 4096);
+            extra++;
+        } else {
+            assert(line.substr(27) == "[debug]: no args");
+            extra++;
+        }
+    }
+    assert(count == THREADS * PER && extra == 3);
+
+    /* 单行的开销: 二进制记录 vs 文本格式化 */
+    const int N = 200000;
+    for (bool binary : {true, false}) {
+        RemoveLogDir("./testlog4");
+        Log::Instance()->init(1, "./testlog4", ".blog", 1024, -1, binary);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < N; i++) { LOG_INFO("%s bench line %d %s", "Test", i, "GET /index.html"); }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+        Log::Instance()->flush();
+        printf("Log %s: %.0f ns/line\n", binary ? "binary" : "text  ", ns);
+    }
+    RemoveLogDir("./testlog4");
+}
+
+void TestAccessLog() {
+    sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    AccessLog::Entry entry;
+    entry.method = "GET";
+    entry.target = "/a?b=\"c";
+    entry.version = "1.1";
+    entry.userAgent = "curl/8 \\";
+    entry.status = 200;
+    entry.bytes = 1234;
+    entry.startNs = 1000000;
+
+    /* Combined: 引号与反斜杠转义为\xHH,空的Referer写作"-",末尾是首字节时间与总时间(微秒) */
+    RemoveLogDir("./testlog5");
+    AccessLog::Init(AccessLog::COMBINED, 1, "./testlog5", ".access.log", 1024);
+    AccessLog::Write(addr, entry, 1150000, 1300000);
+    AccessLog::Flush();
+    std::vector <std::string> lines = ReadLogLines("./testlog5");
+    assert(lines.size() == 1);
+    size_t bracket = lines[0].find("] ");
+    assert(lines[0].compare(0, 15, "127.0.0.1 - - [") == 0 && bracket != std::string::npos);
+    assert(lines[0].substr(bracket + 2) == "\"GET /a?b=\\x22c HTTP/1.1\" 200 1234 \"-\" \"curl/8 \\x5C\" 150 300");
+
+    /* JSON */
+    RemoveLogDir("./testlog5");
+    AccessLog::Init(AccessLog::JSON, 1, "./testlog5", ".access.log", 1024);
+    AccessLog::Write(addr, entry, 0, 1300000);
+    AccessLog::Flush();
+    lines = ReadLogLines("./testlog5");
+    assert(lines.size() == 1);
+    size_t rest = lines[0].find("\",\"remote_addr\"");
+    assert(lines[0].compare(0, 9, "{\"time\":\"") == 0 && rest != std::string::npos);
+    assert(lines[0].substr(rest) == "\",\"remote_addr\":\"127.0.0.1\",\"method\":\"GET\",\"target\":\"/a?b=\\\"c\","
+                                    "\"protocol\":\"HTTP/1.1\",\"status\":200,\"bytes\":1234,\"referer\":\"\","
+                                    "\"user_agent\":\"curl/8 \\\\\",\"ttfb_us\":-1,\"total_us\":300}");
+
+    /* 1/10抽样 */
+    AccessLog::Init(AccessLog::COMMON, 10, "./testlog5", ".access.log", 1024);
+    int sampled = 0;
+    for (int i = 0; i < 1000; i++) { sampled += AccessLog::Sample(); }
+    assert(sampled == 100);
+
+    /* 流水线的两个请求在一批发送完后各写一行 */
+    RemoveLogDir("./testlog5");
+    AccessLog::Init(AccessLog::COMMON, 1, "./testlog5", ".access.log", 1024);
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    HttpConn::srcDir = "./no-such-dir";
+    HttpConn conn;
+    conn.init(fds[0], addr);
+    const char req[] = "GET /x?1 HTTP/1.1\r\nConnection: keep-alive\r\n\r\n"
+                       "GET /y HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+    assert(::write(fds[1], req, sizeof(req) - 1) == (ssize_t) sizeof(req) - 1);
+    int err = 0;
+    assert(conn.read(&err) > 0 && conn.process());
+    size_t total = conn.ToWriteBytes();
+    while (conn.ToWriteBytes() > 0) { assert(conn.write(&err) > 0); }
+    conn.LogAccess();
+    AccessLog::Flush();
+    lines = ReadLogLines("./testlog5");
+    assert(lines.size() == 2);
+    size_t bytes = 0;
+    for (int i = 0; i < 2; i++) {
+        const std::string &line = lines[i];
+        std::string expect = i == 0 ? "\"GET /x?1 HTTP/1.1\" 404 " : "\"GET /y HTTP/1.1\" 404 ";
+        size_t pos = line.find("] ");
+        assert(line.compare(pos + 2, expect.size(), expect) == 0);
+        long long b, ttfb, us;
+        assert(sscanf(line.c_str() + pos + 2 + expect.size(), "%lld %lld %lld", &b, &ttfb, &us) == 3);
+        assert(ttfb >= 0 && us >= ttfb);
+        bytes += b;
+    }
+    assert(bytes == total);
+    conn.Close();
+    close(fds[1]);
+    HttpConn::userCount = 0;
+
+    /* 每行的开销: 格式化后追加到本线程的环,环满时包括等待写线程的时间 */
+    const int N = 200000;
+    entry.referer = "http://localhost/index.html";
+    entry.userAgent = "Mozilla/5.0 (X11; Linux x86_64)";
+    for (AccessLog::Format format : {AccessLog::COMBINED, AccessLog::JSON}) {
+        RemoveLogDir("./testlog5");
+        AccessLog::Init(format, 1, "./testlog5", ".access.log", 1024);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < N; i++) { AccessLog::Write(addr, entry, 1150000, 1300000); }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+        AccessLog::Flush();
+        printf("AccessLog %s: %.0f ns/line\n", format == AccessLog::JSON ? "json    " : "combined", ns);
+    }
+    RemoveLogDir("./testlog5");
+}
+
+/**
+ * 目录下的文件名及其大小
+ */
+std::map <std::string, off_t> ListLogFiles(const char *dir) {
+    std::map <std::string, off_t> files;
+    DIR *d = opendir(dir);
+    if (!d) { return files; }
+    while (struct dirent *entry = readdir(d)) {
+        struct stat st;
+        if (entry->d_name[0] != '.' && stat((std::string(dir) + "/" + entry->d_name).c_str(), &st) == 0) {
+            files[entry->d_name] = st.st_size;
+        }
+    }
+    closedir(d);
+    return files;
+}
+
+void TestLogRotate() {
+    /* 按大小切换: 同步模式下每个文件不超过maxFileBytes,所有行恰好出现一次 */
+    const int N = 5000;
+    LogFileOptions options;
+    options.maxFileBytes = 32 << 10;
+    RemoveLogDir("./testlog6");
+    Log::Instance()->SetFileOptions(options);
+    Log::Instance()->init(1, "./testlog6", ".log", 0);
+    for (int i = 0; i < N; i++) { LOG_INFO("rotate %d end", i); }
+    std::map <std::string, off_t> files = ListLogFiles("./testlog6");
+    assert(files.size() > 4);
+    for (auto &file : files) { assert(file.second > 0 && file.second <= (off_t) options.maxFileBytes); }
+    std::vector<char> seen(N, 0);
+    for (const std::string &line : ReadLogLines("./testlog6")) {
+        int i;
+        assert(sscanf(line.c_str() + 27, "[info] : rotate %d end", &i) == 1 && i >= 0 && i < N && !seen[i]);
+        seen[i] = 1;
+    }
+    assert(std::count(seen.begin(), seen.end(), 1) == N);
+
+    /* writev与mmap两种写法: 关闭文件后截掉预分配的部分,文件中没有多余的零字节 */
+    const int M = 100000;
+    for (bool useMmap : {false, true}) {
+        options.maxFileBytes = 1 << 20;
+        options.useMmap = useMmap;
+        RemoveLogDir("./testlog6");
+        Log::Instance()->SetFileOptions(options);
+        Log::Instance()->init(1, "./testlog6", ".log", 1024);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < M; i++) { LOG_INFO("rotate %d end", i); }
+        Log::Instance()->flush();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("Log %s append with 1MB rotation: %d lines in %.1f ms\n", useMmap ? "mmap  " : "writev", M, ms);
+        //换回默认选项并打开另一个目录,当前文件随之关闭
+        Log::Instance()->SetFileOptions(LogFileOptions());
+        Log::Instance()->init(1, "./testlog3", ".log", 1024);
+        files = ListLogFiles("./testlog6");
+        assert(files.size() > 1);
+        seen.assign(M, 0);
+        for (const std::string &line : ReadLogLines("./testlog6")) {
+            int i;
+            assert(line.find('\0') == std::string::npos);
+            assert(sscanf(line.c_str() + 27, "[info] : rotate %d end", &i) == 1 && i >= 0 && i < M && !seen[i]);
+            seen[i] = 1;
+        }
+        assert(std::count(seen.begin(), seen.end(), 1) == M);
+    }
+    RemoveLogDir("./testlog6");
+    RemoveLogDir("./testlog3");
+}
+
+void TestLogArchiver() {
+    /* 压缩后删除原文件,.gz解压后与原内容一致;只保留最新的keepFiles个旧文件,正在写入的文件不计入 */
+    RemoveLogDir("./testlog7");
+    mkdir("./testlog7", 0777);
+    std::string content;
+    for (int i = 0; i < 20000; i++) { content += "archive line " + std::to_string(i) + "\n"; }
+    const char *names[] = {"2024_01_02-1.log", "2024_01_01-2.log", "2024_01_01.log", "2024_01_02.log",
+                           "2024_01_02-2.log", "2024_01_02.access.log"};
+    for (const char *name : names) { WriteFile(std::string("./testlog7/") + name, content); }
+    {
+        LogArchiver archiver;
+        archiver.Submit("./testlog7/2024_01_02-1.log", "./testlog7", ".log", "2024_01_02-2.log",
+                        LogArchiver::GZIP, 2);
+        archiver.Wait();
+    }
+    std::map <std::string, off_t> files = ListLogFiles("./testlog7");
+    assert(files.size() == 4);
+    assert(files.count("2024_01_02.log") && files.count("2024_01_02-1.log.gz"));
+    assert(files.count("2024_01_02-2.log") && files.count("2024_01_02.access.log"));
+    assert(files["2024_01_02-1.log.gz"] < (off_t) content.size() / 4);
+    gzFile gz = gzopen("./testlog7/2024_01_02-1.log.gz", "rb");
+    assert(gz);
+    std::string plain(content.size() + 1, '\0');
+    assert(gzread(gz, &plain[0], plain.size()) == (int) content.size());
+    gzclose(gz);
+    plain.resize(content.size());
+    assert(plain == content);
+    RemoveLogDir("./testlog7");
+}
+
+/**
+ * 取Prometheus文本中一个样本的值,不存在时返回-1
+ */
+double MetricValue(const std::string &text, const std::string &sample) {
+    size_t pos = text.find("\n" + sample + " ");
+    return pos == std::string::npos ? -1 : atof(text.c_str() + pos + sample.size() + 2);
+}
+
+void TestMetrics() {
+    /* 各线程的计数在抓取时求和,已退出线程的计数不丢失 */
+    std::string before = Metrics::Render();
+    double accepted = std::max(MetricValue(before, "webserver_connections_accepted_total"), 0.0);
+    double ok = std::max(MetricValue(before, "webserver_http_requests_total{code=\"200\"}"), 0.0);
+    const int THREADS = 4, PER = 100000;
+    std::vector <std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([] {
+            for (int i = 0; i < PER; i++) {
+                Metrics::CountAccept();
+                Metrics::CountRequest(200);
+            }
+            Metrics::CountRequest(404);
+            Metrics::CountRequest(999);
+        });
+    }
+    for (auto &th : threads) { th.join(); }
+    Metrics::SetTimers(7);
+    Metrics::AddGauge("test_gauge", "Test gauge.", [] { return 42; });
+    std::string text = Metrics::Render();
+    assert(MetricValue(text, "webserver_connections_accepted_total") == accepted + THREADS * PER);
+    assert(MetricValue(text, "webserver_http_requests_total{code=\"200\"}") == ok + THREADS * PER);
+    assert(MetricValue(text, "webserver_http_requests_total{code=\"404\"}") >= THREADS);
+    assert(MetricValue(text, "webserver_http_requests_total{code=\"100\"}") >= THREADS);
+    assert(MetricValue(text, "webserver_timers") == 7);
+    assert(MetricValue(text, "test_gauge") == 42);
+    assert(text.find("# TYPE webserver_http_requests_total counter\n") != std::string::npos);
+    assert(text.find("# TYPE test_gauge gauge\n") != std::string::npos);
+    Metrics::ClearGauges();
+    assert(Metrics::Render().find("test_gauge") == std::string::npos);
+
+    /* 在metricsPath上输出指标,其他路径照常按文件处理 */
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    sockaddr_in addr = {0};
+    HttpConn::srcDir = "./no-such-dir";
+    HttpConn::metricsPath = "/metrics";
+    HttpConn conn;
+    conn.init(fds[0], addr);
+    const char req[] = "GET /metrics HTTP/1.1\r\nConnection: keep-alive\r\n\r\n"
+                       "GET /x HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+    assert(::write(fds[1], req, sizeof(req) - 1) == (ssize_t) sizeof(req) - 1);
+    int err = 0;
+    assert(conn.read(&err) > 0 && conn.process());
+    size_t total = conn.ToWriteBytes();
+    while (conn.ToWriteBytes() > 0) { assert(conn.write(&err) > 0); }
+    std::string resp(total, '\0');
+    assert(::read(fds[1], &resp[0], total) == (ssize_t) total);
+    assert(resp.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    assert(resp.find("Content-type: text/plain; version=0.0.4") != std::string::npos);
+    size_t body = resp.find("\r\n\r\n") + 4;
+    assert(resp.compare(body, 7, "# HELP ") == 0);
+    assert(resp.find("HTTP/1.1 404 Not Found\r\n", body) != std::string::npos);
+    text = Metrics::Render();
+    assert(MetricValue(text, "webserver_http_response_bytes_total") >= total);
+    conn.Close();
+    close(fds[1]);
+    HttpConn::userCount = 0;
+    HttpConn::metricsPath.clear();
+
+    /* 热路径上一次计数的开销 */
+    const int N = 100000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) { Metrics::CountBytesOut(i); }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+    printf("Metrics per-thread counter: %.2f ns\n", ns);
+}
+
 void ThreadLogTask(int i, int cnt) {
     for(int j = 0; j < 10000; j++ ){
         LOG_BASE(i,"PID:[%04d]======= %05d ========= ", gettid(), cnt++);
     }
 }
 
+/* 原先基于mutex+condition_variable+std::queue的线程池,作为TestThreadPoolBench的对照 */
+class LockedPool {
+public:
+    explicit LockedPool(size_t threadCount) : pool_(std::make_shared<Pool>()) {
+        for (size_t i = 0; i < threadCount; i++) {
+            std::thread([pool = pool_] {
+                std::unique_lock <std::mutex> locker(pool->mtx);
+                while (true) {
+                    if (!pool->tasks.empty()) {
+                        auto task = std::move(pool->tasks.front());
+                        pool->tasks.pop();
+                        locker.unlock();
+                        task();
+                        locker.lock();
+                    } else if (pool->isClosed) break;
+                    else pool->cond.wait(locker);
+                }
+            }).detach();
+        }
+    }
+
+    ~LockedPool() {
+        {
+            std::lock_guard <std::mutex> locker(pool_->mtx);
+            pool_->isClosed = true;
+        }
+        pool_->cond.notify_all();
+    }
+
+    template<class F>
+    void AddTask(F &&task) {
+        {
+            std::lock_guard <std::mutex> locker(pool_->mtx);
+            pool_->tasks.emplace(std::forward<F>(task));
+        }
+        pool_->cond.notify_one();
+    }
+
+private:
+    struct Pool {
+        std::mutex mtx;
+        std::condition_variable cond;
+        bool isClosed = false;
+        std::queue <std::function<void()>> tasks;
+    };
+    std::shared_ptr <Pool> pool_;
+};
+
+/**
+ * producers个线程共提交total个空任务,返回全部执行完的耗时(秒)
+ */
+template<class P>
+double PoolThroughput(P &pool, int producers, int total) {
+    std::atomic<int> done(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector <std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&pool, &done, n = total / producers] {
+            for (int i = 0; i < n; i++) {
+                pool.AddTask([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+    for (auto &t : threads) { t.join(); }
+    while (done.load() < total / producers * producers) { std::this_thread::yield(); }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* 与WebServer::OnRead_形状相同的任务: 成员函数指针+this+连接指针+代数 */
+struct FakeServer {
+    std::atomic<int> done{0};
+
+    void OnRead(int *client, uint32_t gen) {
+        if (*client == static_cast<int>(gen)) { done.fetch_add(1, std::memory_order_relaxed); }
+    }
+};
+
+void TestTask() {
+    FakeServer server;
+    int client = 7;
+    auto bound = std::bind(&FakeServer::OnRead, &server, &client, 7u);
+    static_assert(Task::FitsInline<decltype(bound)>(), "server task must not allocate");
+
+    /* 小对象内联存放,移动后原对象为空 */
+    long long before = g_allocs.load();
+    Task a(bound);
+    Task b(std::move(a));
+    assert(!a && b);
+    b();
+    a = std::move(b);
+    a();
+    assert(server.done.load() == 2 && g_allocs.load() == before);
+
+    /* 超出内联容量时退回堆上,只在构造时分配一次,移动不分配,析构时释放 */
+    struct Big {
+        char pad[128];
+    } big{};
+    std::shared_ptr<int> alive = std::make_shared<int>(0);
+    before = g_allocs.load();
+    {
+        Task heap([big, alive] { (*alive) += big.pad[0] + 1; });
+        assert(g_allocs.load() == before + 1 && alive.use_count() == 2);
+        Task moved(std::move(heap));
+        moved();
+        assert(*alive == 1 && g_allocs.load() == before + 1);
+    }
+    assert(alive.use_count() == 1);
+
+    /* 只能移动的可调用对象同样可以作为任务 */
+    std::unique_ptr<int> owned(new int(5));
+    Task move_only([p = std::move(owned)] { assert(*p == 5); });
+    move_only();
+
+    /* 稳态下提交并执行服务器任务不分配内存;std::function放不下同样的bind对象,每个任务一次分配 */
+    const int N = 100000;
+    for (bool stealing : {false, true}) {
+        ThreadPool pool(4, 1 << 16, stealing);
+        server.done = 0;
+        before = g_allocs.load();
+        for (int i = 0; i < N; i++) {
+            pool.AddTask(i, std::bind(&FakeServer::OnRead, &server, &client, 7u));
+        }
+        while (server.done.load() < N) { std::this_thread::yield(); }
+        long long allocs = g_allocs.load() - before;
+        printf("Task %s: %lld allocations for %d tasks\n", stealing ? "work-stealing" : "shared FIFO  ", allocs, N);
+        assert(allocs == 0);
+    }
+    before = g_allocs.load();
+    for (int i = 0; i < N; i++) {
+        std::function<void()> fn(std::bind(&FakeServer::OnRead, &server, &client, 7u));
+        fn();
+    }
+    printf("std::function: %.2f allocations per task\n", double(g_allocs.load() - before) / N);
+}
+
+void TestCpuAffinity() {
+    assert(CpuAffinity::ParseList("").empty());
+    assert((CpuAffinity::ParseList("0-3,8") == std::vector<int>{0, 1, 2, 3, 8}));
+    assert((CpuAffinity::ParseList(" 5, 2-2,x,7-6") == std::vector<int>{5, 2}));
+    std::vector<int> cpus{4, 6};
+    assert(CpuAffinity::Pick(cpus, 0) == 4 && CpuAffinity::Pick(cpus, 3) == 6);
+    assert(CpuAffinity::Pick({}, 1) == -1);
+    assert(!CpuAffinity::PinThread(-1));
+
+    /* 只绑定到当前允许运行的CPU,容器中不一定能使用CPU 0 */
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed)) { cpu++; }
+    std::thread([cpu] {
+        assert(CpuAffinity::PinThread(cpu));
+        assert(sched_getcpu() == cpu);
+    }).join();
+
+    /* 绑定之后创建的线程继承绑定,之前创建的线程保持原来的掩码 */
+    std::thread([cpu, allowed] {
+        std::atomic<bool> pinned(false);
+        cpu_set_t before, after;
+        std::thread early([&] {
+            while (!pinned.load()) { std::this_thread::yield(); }
+            sched_getaffinity(0, sizeof(before), &before);
+        });
+        assert(CpuAffinity::PinThread(cpu));
+        pinned = true;
+        std::thread([&after] { sched_getaffinity(0, sizeof(after), &after); }).join();
+        early.join();
+        cpu_set_t only;
+        CPU_ZERO(&only);
+        CPU_SET(cpu, &only);
+        assert(CPU_EQUAL(&before, &allowed) && CPU_EQUAL(&after, &only));
+    }).join();
+
+    /* 每个工作线程在开始取任务之前调用一次onStart */
+    const int N = 4;
+    std::atomic<int> started(0), pinned(0);
+    {
+        ThreadPool pool(N, 64, true, [&, cpu](size_t i) {
+            started.fetch_add(1 << i);
+            if (CpuAffinity::PinThread(cpu) && sched_getcpu() == cpu) { pinned++; }
+        });
+        assert(started.load() == (1 << N) - 1);
+        std::atomic<int> done(0);
+        for (int i = 0; i < 100; i++) { pool.AddTask(i, [&done] { done++; }); }
+        while (done.load() < 100) { std::this_thread::yield(); }
+    }
+    printf("CpuAffinity: %d/%d workers pinned to cpu %d (node %d)\n", pinned.load(), N, cpu,
+           CpuAffinity::NodeOf(cpu));
+    assert(pinned.load() == N);
+}
+
+void TestThreadPoolBench() {
+    /* 队列基本语义: 先进先出,满时拒绝 */
+    MpmcQueue<int> queue(4);
+    for (int i = 0; i < 4; i++) { assert(queue.TryPush(i)); }
+    assert(!queue.TryPush(4));
+    int value = -1;
+    for (int i = 0; i < 4; i++) { assert(queue.TryPop(value) && value == i); }
+    assert(!queue.TryPop(value));
+
+    /* 多生产者多消费者下每个元素恰好取出一次 */
+    const int PER = 100000, N = 4;
+    MpmcQueue<int> shared(1024);
+    std::atomic<long long> sum(0);
+    std::atomic<int> popped(0);
+    std::vector <std::thread> threads;
+    for (int p = 0; p < N; p++) {
+        threads.emplace_back([&shared, p] {
+            for (int i = 0; i < PER; i++) {
+                while (!shared.TryPush(p * PER + i)) { std::this_thread::yield(); }
+            }
+        });
+        threads.emplace_back([&] {
+            int v;
+            while (popped.load() < N * PER) {
+                if (shared.TryPop(v)) {
+                    sum += v;
+                    popped++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto &t : threads) { t.join(); }
+    long long all = (long long) N * PER;
+    assert(popped.load() == N * PER && sum.load() == all * (all - 1) / 2);
+
+    /* 逐个提交并等待完成,工作线程反复在休眠与唤醒之间切换,丢失唤醒会卡在这里 */
+    {
+        ThreadPool pool(N, 64);
+        std::atomic<int> done(0);
+        for (int i = 1; i <= 20000; i++) {
+            pool.AddTask([&done] { done++; });
+            while (done.load() < i) { std::this_thread::yield(); }
+        }
+    }
+
+    /* 工作窃取模式下按key投递同样不能丢失唤醒 */
+    {
+        ThreadPool pool(N, 64, true);
+        std::atomic<int> done(0);
+        for (int i = 1; i <= 20000; i++) {
+            pool.AddTask(i, [&done] { done++; });
+            while (done.load() < i) { std::this_thread::yield(); }
+        }
+    }
+
+    /* 模拟连接: 每个key有自己的缓冲区,任务读写整个缓冲区;统计同一key的相邻任务落在同一线程上的比例 */
+    const int KEYS = 64, BUF = 32 << 10, ROUNDS = 200;
+    for (bool stealing : {false, true}) {
+        std::vector <std::vector<char>> bufs(KEYS, std::vector<char>(BUF, 1));
+        std::vector <std::thread::id> last(KEYS);
+        std::atomic<int> done(0), same(0);
+        auto start = std::chrono::steady_clock::now();
+        {
+            ThreadPool pool(N, 1 << 16, stealing);
+            for (int r = 0; r < ROUNDS; r++) {
+                for (int k = 0; k < KEYS; k++) {
+                    pool.AddTask(k, [&, k] {
+                        char *buf = bufs[k].data();
+                        for (int i = 0; i < BUF; i += 64) { buf[i]++; }
+                        if (last[k] == std::this_thread::get_id()) { same++; }
+                        last[k] = std::this_thread::get_id();
+                        done++;
+                    });
+                }
+                //同一key同时只有一个任务,与EPOLLONESHOT下的连接一致
+                while (done.load() < (r + 1) * KEYS) { std::this_thread::yield(); }
+            }
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printf("ThreadPool %s: %.0f ns/task, same thread as previous task of the key %.0f%%, steals %llu\n",
+                   stealing ? "work-stealing" : "shared FIFO  ", sec * 1e9 / (ROUNDS * KEYS),
+                   100.0 * same.load() / (ROUNDS * KEYS), (unsigned long long) pool.StealCount());
+        }
+    }
+
+    const int TOTAL = 400000;
+    for (int producers : {1, N}) {
+        double locked, lockFree;
+        {
+            LockedPool pool(N);
+            locked = PoolThroughput(pool, producers, TOTAL);
+        }
+        {
+            ThreadPool pool(N);
+            lockFree = PoolThroughput(pool, producers, TOTAL);
+        }
+        printf("ThreadPool %d producer / %d consumer: mutex %.2f Mtask/s, lock-free %.2f Mtask/s\n",
+               producers, N, TOTAL / locked / 1e6, TOTAL / lockFree / 1e6);
+    }
+}
+
 void TestThreadPool() {
     Log::Instance()->init(0, "./testThreadpool", ".log", 5000);
     ThreadPool threadpool(6);
@@ -50,7 +874,1175 @@ void TestThreadPool() {
     getchar();
 }
 
+/* 旧版基于正则的解析流程, 仅作为TestHttpRequestParse的性能对照 */
+bool RegexParse(Buffer &buff, std::unordered_map<std::string, std::string> &header) {
+    const char CRLF[] = "\r\n";
+    std::string method, path, version;
+    int state = 0;
+    while (buff.ReadableBytes() && state != 2) {
+        const char *lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+        std::string line(buff.Peek(), lineEnd);
+        std::smatch subMatch;
+        if (state == 0) {
+            std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+            if (!std::regex_match(line, subMatch, patten)) { return false; }
+            method = subMatch[1];
+            path = subMatch[2];
+            version = subMatch[3];
+            state = 1;
+        } else {
+            std::regex patten("^([^:]*): ?(.*)$");
+            if (std::regex_match(line, subMatch, patten)) {
+                header[subMatch[1]] = subMatch[2];
+            }
+            if (buff.ReadableBytes() <= 2) { state = 2; }
+        }
+        if (lineEnd == buff.BeginWrite()) { break; }
+        buff.RetrieveUntil(lineEnd + 2);
+    }
+    buff.RetrieveAll();
+    return true;
+}
+
+void TestHttpRequestParse() {
+    const std::string req =
+            "GET /index.html HTTP/1.1\r\n"
+            "Host: 127.0.0.1:1316\r\n"
+            "Connection: keep-alive\r\n"
+            "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+            "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+            "Accept-Encoding: gzip, deflate, br\r\n"
+            "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+            "Cookie: session=0123456789abcdef0123456789abcdef\r\n"
+            "\r\n";
+
+    /* 报文被拆成任意两段到达时都能从断点继续解析 */
+    for (size_t cut = 1; cut < req.size(); cut++) {
+        Buffer buff;
+        HttpRequest request;
+        buff.Append(req.data(), cut);
+        assert(request.parse(buff) == HttpRequest::NO_REQUEST);
+        buff.Append(req.data() + cut, req.size() - cut);
+        assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+        assert(request.path() == "/index.html");
+        assert(request.method() == "GET" && request.version() == "1.1");
+        assert(request.GetHeader("cookie") == "session=0123456789abcdef0123456789abcdef");
+        assert(request.IsKeepAlive());
+        assert(buff.ReadableBytes() == 0);
+    }
+
+    const int N = 200000;
+    Buffer buff(4096);
+    HttpRequest request;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        buff.Append(req);
+        request.parse(buff);
+    }
+    double fsm = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::unordered_map<std::string, std::string> header;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N / 20; i++) {
+        buff.Append(req);
+        RegexParse(buff, header);
+    }
+    double regex = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("HttpRequest parse (1 core): state machine %.0f req/s, regex %.0f req/s\n",
+           N / fsm, N / 20 / regex);
+}
+
+int ParseRanges(const std::string &range, HttpRequest::Range *out) {
+    Buffer buff;
+    HttpRequest request;
+    buff.Append("GET /video/xxx.mp4 HTTP/1.1\r\nRange: " + range + "\r\n\r\n");
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+    return request.GetRanges(out);
+}
+
+void TestHttpRequestRange() {
+    HttpRequest::Range r[HttpRequest::MAX_RANGES];
+    assert(ParseRanges("bytes=0-499", r) == 1 && r[0].first == 0 && r[0].last == 499);
+    assert(ParseRanges("bytes=9500-", r) == 1 && r[0].first == 9500 && r[0].last == -1);
+    assert(ParseRanges("bytes=-500", r) == 1 && r[0].first == -1 && r[0].last == 500);
+    assert(ParseRanges("Bytes=0-0, 10-20 ,-1", r) == 3 && r[1].first == 10 && r[2].last == 1);
+    assert(ParseRanges("bytes=5-2", r) == 0);          //last < first, 整个Range头无效
+    assert(ParseRanges("bytes=a-b", r) == 0);
+    assert(ParseRanges("items=0-1", r) == 0);
+    std::string many = "bytes=0-0";
+    for (int i = 1; i <= HttpRequest::MAX_RANGES; i++) { many += "," + std::to_string(i) + "-" + std::to_string(i); }
+    assert(ParseRanges(many, r) == 0);
+}
+
+/**
+ * 非阻塞地发送conn的整批响应,同时从peer读出,返回peer收到的全部数据
+ */
+std::string DrainConn(HttpConn &conn, int peer) {
+    std::string data;
+    char buf[65536];
+    int err = 0;
+    while (true) {
+        if (conn.ToWriteBytes() > 0) { conn.write(&err); }
+        ssize_t len;
+        while ((len = ::read(peer, buf, sizeof(buf))) > 0) { data.append(buf, len); }
+        if (conn.ToWriteBytes() == 0 && len < 0) { break; }
+    }
+    return data;
+}
+
+/**
+ * 统计响应的个数
+ */
+int CountResponses(const std::string &data) {
+    int n = 0;
+    for (size_t pos = 0; (pos = data.find("HTTP/1.1 ", pos)) != std::string::npos; pos++) { n++; }
+    return n;
+}
+
+void TestPipeline() {
+    char dir[] = "/tmp/pipelineXXXXXX";
+    assert(mkdtemp(dir));
+    WriteFile(std::string(dir) + "/a.txt", "AAA");
+    WriteFile(std::string(dir) + "/b.txt", "BBB");
+    WriteFile(std::string(dir) + "/c.txt", "CCC");
+    WriteFile(std::string(dir) + "/big.bin", std::string(HttpResponse::sendfileThreshold, 'x'));
+    std::string srcDir = std::string(dir) + "/";
+    HttpConn::srcDir = srcDir.c_str();
+    auto get = [](const char *path, bool keepAlive = true) {
+        return std::string("GET ") + path + " HTTP/1.1\r\nConnection: " + (keepAlive ? "keep-alive" : "close") + "\r\n\r\n";
+    };
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    sockaddr_in addr = {0};
+    HttpConn conn;
+    conn.init(fds[0], addr);
+    int err = 0;
+    auto send = [&](const std::string &data) {
+        assert(::write(fds[1], data.data(), data.size()) == (ssize_t) data.size());
+        assert(conn.read(&err) > 0);
+    };
+
+    /* 一次读到的多个请求在一批中按顺序响应 */
+    send(get("/a.txt") + get("/b.txt") + get("/c.txt"));
+    assert(conn.process());
+    std::string out = DrainConn(conn, fds[1]);
+    assert(CountResponses(out) == 3 && conn.IsKeepAlive());
+    size_t a = out.find("\r\n\r\nAAA"), b = out.find("\r\n\r\nBBB"), c = out.find("\r\n\r\nCCC");
+    assert(a != std::string::npos && a < b && b < c && c != std::string::npos);
+    assert(!conn.process());
+
+    /* 一批最多MAX_PIPELINE(16)个,其余的在本批发送完后处理 */
+    std::string many;
+    for (int i = 0; i < 20; i++) { many += get("/a.txt"); }
+    send(many);
+    assert(conn.process());
+    assert(CountResponses(DrainConn(conn, fds[1])) == 16);
+    assert(conn.process());
+    assert(CountResponses(DrainConn(conn, fds[1])) == 4);
+    assert(!conn.process());
+
+    /* sendfile只能放在一批的最后,之后的请求等它发送完再处理 */
+    send(get("/a.txt") + get("/big.bin") + get("/c.txt"));
+    assert(conn.process());
+    out = DrainConn(conn, fds[1]);
+    assert(CountResponses(out) == 2 && out.find("AAA") != std::string::npos);
+    assert(out.size() > HttpResponse::sendfileThreshold && out.compare(out.size() - 3, 3, "xxx") == 0);
+    assert(conn.process());
+    out = DrainConn(conn, fds[1]);
+    assert(CountResponses(out) == 1 && out.find("\r\n\r\nCCC") != std::string::npos);
+
+    /* 分两次到达的请求从断点继续解析 */
+    std::string req = get("/b.txt");
+    send(req.substr(0, 20));
+    assert(!conn.process());
+    send(req.substr(20));
+    assert(conn.process());
+    out = DrainConn(conn, fds[1]);
+    assert(CountResponses(out) == 1 && out.find("\r\n\r\nBBB") != std::string::npos);
+
+    /* 不保持连接的请求之后的请求不再处理 */
+    send(get("/a.txt") + get("/b.txt", false) + get("/c.txt"));
+    assert(conn.process());
+    out = DrainConn(conn, fds[1]);
+    assert(CountResponses(out) == 2 && out.find("CCC") == std::string::npos && !conn.IsKeepAlive());
+
+    conn.Close();
+    close(fds[1]);
+    HttpConn::userCount = 0;
+    for (const char *name : {"a.txt", "b.txt", "c.txt", "big.bin"}) { unlink((srcDir + name).c_str()); }
+    rmdir(dir);
+}
+
+void TestSidecar() {
+    /* 按Accept-Encoding选择预压缩文件;有预压缩文件时不论是否命中缓存都带Vary */
+    char dir[] = "/tmp/sidecarXXXXXX";
+    assert(mkdtemp(dir));
+    std::string srcDir = std::string(dir) + "/";
+    WriteFile(srcDir + "page.html", "plain");
+    WriteFile(srcDir + "page.html.gz", "GZ");
+    WriteFile(srcDir + "page.html.br", "BR");
+    WriteFile(srcDir + "other.html", "other");
+    HttpConn::srcDir = srcDir.c_str();
+    sockaddr_in addr = {0};
+    for (bool useCache : {false, true}) {
+        FileCache::Instance()->Init(useCache ? 16 * 4096 : 0, 2048);
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        HttpConn conn;
+        conn.init(fds[0], addr);
+        auto fetch = [&](const char *path, const std::string &headers) {
+            std::string req = std::string("GET ") + path + " HTTP/1.1\r\nConnection: keep-alive\r\n" + headers + "\r\n";
+            assert(::write(fds[1], req.data(), req.size()) == (ssize_t) req.size());
+            int err = 0;
+            assert(conn.read(&err) > 0 && conn.process());
+            return DrainConn(conn, fds[1]);
+        };
+        auto body = [](const std::string &resp) { return resp.substr(resp.find("\r\n\r\n") + 4); };
+        auto has = [](const std::string &resp, const char *header) { return resp.find(header) != std::string::npos; };
+
+        std::string resp = fetch("/page.html", "");
+        assert(body(resp) == "plain" && has(resp, "Vary: Accept-Encoding") && !has(resp, "Content-Encoding"));
+        std::string etag = resp.substr(resp.find("ETag: ") + 6);
+        etag = etag.substr(0, etag.find("\r\n"));
+        resp = fetch("/page.html", "Accept-Encoding: gzip\r\n");
+        assert(body(resp) == "GZ" && has(resp, "Content-Encoding: gzip") && has(resp, "Vary: Accept-Encoding"));
+        assert(has(resp, "Content-type: text/html"));
+        resp = fetch("/page.html", "Accept-Encoding: gzip, br\r\n");
+        assert(body(resp) == "BR" && has(resp, "Content-Encoding: br"));
+        resp = fetch("/page.html", "Accept-Encoding: br;q=0.5, gzip\r\n");
+        assert(body(resp) == "GZ");
+        resp = fetch("/page.html", "Accept-Encoding: identity\r\n");
+        assert(body(resp) == "plain" && has(resp, "Vary: Accept-Encoding") && !has(resp, "Content-Encoding"));
+        resp = fetch("/page.html", "Accept-Encoding: gzip\r\nRange: bytes=0-1\r\n");
+        assert(resp.compare(0, 12, "HTTP/1.1 206") == 0 && body(resp) == "pl" && has(resp, "Vary: Accept-Encoding"));
+        resp = fetch("/page.html", "If-None-Match: " + etag + "\r\n");
+        assert(resp.compare(0, 12, "HTTP/1.1 304") == 0 && has(resp, "Vary: Accept-Encoding"));
+        resp = fetch("/other.html", "Accept-Encoding: gzip\r\n");
+        assert(body(resp) == "other" && !has(resp, "Vary") && !has(resp, "Content-Encoding"));
+        conn.Close();
+        close(fds[1]);
+    }
+    FileCache::Instance()->Init(0);
+    HttpConn::userCount = 0;
+    for (const char *name : {"page.html", "page.html.gz", "page.html.br", "other.html"}) { unlink((srcDir + name).c_str()); }
+    rmdir(dir);
+}
+
+void TestPartialWrite() {
+    /* 发送缓冲区很小时writev和sendfile都只能部分发送,之后从断点继续 */
+    char dir[] = "/tmp/partialXXXXXX";
+    assert(mkdtemp(dir));
+    std::string srcDir = std::string(dir) + "/";
+    std::string mid, big;
+    for (size_t i = 0; i < HttpResponse::sendfileThreshold / 2; i++) { mid += char('a' + i % 26); }
+    for (size_t i = 0; i < HttpResponse::sendfileThreshold; i++) { big += char('A' + i % 26); }
+    WriteFile(srcDir + "mid.txt", mid);
+    WriteFile(srcDir + "big.txt", big);
+    HttpConn::srcDir = srcDir.c_str();
+    sockaddr_in addr = {0};
+    for (const std::string *content : {&mid, &big}) {
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        int size = 4096;
+        setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        HttpConn conn;
+        conn.init(fds[0], addr);
+        std::string req = std::string("GET /") + (content == &mid ? "mid" : "big") + ".txt HTTP/1.1\r\n\r\n";
+        assert(::write(fds[1], req.data(), req.size()) == (ssize_t) req.size());
+        int err = 0;
+        assert(conn.read(&err) > 0 && conn.process());
+        std::string out;
+        char buf[4096];
+        int partial = 0;
+        while (conn.ToWriteBytes() > 0) {
+            size_t before = conn.ToWriteBytes();
+            err = 0;
+            if (conn.write(&err) < 0) {
+                assert(err == EAGAIN && conn.ToWriteBytes() > 0);
+                partial++;
+            }
+            assert(conn.ToWriteBytes() < before || err == EAGAIN);
+            ssize_t len;
+            while ((len = ::read(fds[1], buf, sizeof(buf))) > 0) { out.append(buf, len); }
+        }
+        ssize_t len;
+        while ((len = ::read(fds[1], buf, sizeof(buf))) > 0) { out.append(buf, len); }
+        size_t body = out.find("\r\n\r\n");
+        assert(partial > 1 && body != std::string::npos && out.substr(body + 4) == *content);
+        conn.Close();
+        close(fds[1]);
+    }
+
+    /* 文件在sendfile发送期间被截断时按出错结束,不带上遗留的errno */
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    HttpConn conn;
+    conn.init(fds[0], addr);
+    std::string req = "GET /big.txt HTTP/1.1\r\n\r\n";
+    assert(::write(fds[1], req.data(), req.size()) == (ssize_t) req.size());
+    int err = 0;
+    assert(conn.read(&err) > 0 && conn.process());
+    assert(truncate((srcDir + "big.txt").c_str(), 0) == 0);
+    char buf[65536];
+    while (conn.ToWriteBytes() > 0) {
+        errno = EAGAIN;
+        err = -1;
+        ssize_t ret = conn.write(&err);
+        if (ret == 0) { break; }
+        assert(ret > 0 || err == EAGAIN);
+        while (::read(fds[1], buf, sizeof(buf)) > 0) {}
+    }
+    assert(conn.ToWriteBytes() > 0 && err == 0);
+    conn.Close();
+    close(fds[1]);
+    HttpConn::userCount = 0;
+    unlink((srcDir + "mid.txt").c_str());
+    unlink((srcDir + "big.txt").c_str());
+    rmdir(dir);
+}
+
+void TestDelimScanner() {
+    /* 模拟携带JWT/Cookie的大请求头 */
+    std::string req = "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:1316\r\n";
+    req += "Authorization: Bearer " + std::string(6000, 'x') + "\r\n";
+    req += "Cookie: a=1; b=2; c=" + std::string(2000, 'y') + "\r\n\r\n";
+
+    uint32_t simd[256], scalar[256];
+    size_t simdScanned = 0, scalarScanned = 0;
+    size_t n = DelimScanner::Scan(req.data(), req.size(), simd, 256, &simdScanned);
+    size_t m = DelimScanner::ScanScalar(req.data(), req.size(), scalar, 256, &scalarScanned);
+    assert(n == m && simdScanned == scalarScanned && memcmp(simd, scalar, n * sizeof(uint32_t)) == 0);
+    /* 输出数组写满时两种实现停在同一位置 */
+    n = DelimScanner::Scan(req.data(), req.size(), simd, 3, &simdScanned);
+    m = DelimScanner::ScanScalar(req.data(), req.size(), scalar, 3, &scalarScanned);
+    assert(n == 3 && m == 3 && simdScanned == scalarScanned);
+
+    const int N = 100000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        DelimScanner::ScanScalar(req.data(), req.size(), scalar, 256, &scalarScanned);
+    }
+    double scalarSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        DelimScanner::Scan(req.data(), req.size(), simd, 256, &simdScanned);
+    }
+    double simdSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    HttpRequest::maxHeaderSize = 16384;
+    Buffer buff(16384);
+    HttpRequest request;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        buff.Append(req);
+        assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+    }
+    double parseSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("DelimScanner %zu-byte header: scalar %.2f GB/s, %s %.2f GB/s, parse %.0f req/s\n",
+           req.size(), N * req.size() / scalarSec / 1e9, DelimScanner::Name(),
+           N * req.size() / simdSec / 1e9, N / parseSec);
+}
+
+void TestFileCache() {
+    char dir[] = "/tmp/filecacheXXXXXX";
+    assert(mkdtemp(dir));
+    std::string a = std::string(dir) + "/a.html", b = std::string(dir) + "/b.txt";
+    WriteFile(a, "<html>v1</html>");
+    WriteFile(b, std::string(3000, 'b'));
+
+    FileCache *cache = FileCache::Instance();
+    cache->Init(16 * 4096, 2048);
+    auto entry = cache->Get(a);
+    assert(entry && entry->HasBody() && entry->body == "<html>v1</html>" && entry->mime == "text/html");
+    assert(cache->Get(a) == entry);                        //命中返回同一条目
+    auto big = cache->Get(b);                              //超过单文件上限,只缓存元数据
+    assert(big && !big->HasBody() && big->st.st_size == 3000);
+    assert(cache->Get(std::string(dir) + "/none") == nullptr);
+    assert(cache->Get(dir) == nullptr);
+
+    /* 同一文件的不同写法共用一个条目;不存在的路径不注册监听 */
+    size_t count = cache->Count(), watches = cache->WatchCount();
+    for (const char *sep : {"/./", "//", "/././", "//.//"}) {
+        assert(cache->Get(dir + std::string(sep) + "a.html") == entry);
+    }
+    for (int i = 0; i < 10; i++) {
+        assert(cache->Get(std::string(dir) + "/none" + std::to_string(i) + "/a.html") == nullptr);
+    }
+    assert(cache->Count() == count && cache->WatchCount() == watches);
+    /* 经符号链接的写法对应同一个wd,不再登记第二个写法,这种写法下的文件也不缓存 */
+    std::string link = std::string(dir) + "-link";
+    assert(symlink(dir, link.data()) == 0);
+    auto viaLink = cache->Get(link + "/a.html");
+    assert(viaLink && viaLink != entry && viaLink->body == entry->body && cache->Get(link + "/a.html") != viaLink);
+    assert(cache->Count() == count && cache->WatchCount() == watches);
+    unlink(link.data());
+    /* ".."按字面回退,与不含".."的写法共用条目 */
+    for (const char *sep : {"/x/../", "/./x/y/../../", "/x//..//"}) {
+        assert(cache->Get(dir + std::string(sep) + "a.html") == entry);
+    }
+    assert(cache->Count() == count && cache->WatchCount() == watches);
+    /* 越过资源根目录的请求直接返回400,不进入缓存也不监听根目录之外的目录 */
+    for (const char *path : {"/../../../../etc/passwd", "/a.html/../../etc/passwd", "/..", "x/../../etc/passwd"}) {
+        Buffer buff;
+        HttpRequest request;
+        buff.Append(std::string("GET ") + path + " HTTP/1.1\r\n\r\n");
+        assert(request.parse(buff) == HttpRequest::BAD_REQUEST);
+    }
+    for (auto &c : std::vector <std::pair<const char *, const char *>>{
+            {"/x/../a.html", "/a.html"}, {"/./a.html", "/a.html"}, {"//x/./..//y/", "/y/"}, {"/x/..", "/index.html"}}) {
+        Buffer buff;
+        HttpRequest request;
+        buff.Append(std::string("GET ") + c.first + " HTTP/1.1\r\n\r\n");
+        assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.path() == c.second);
+    }
+    std::string srcDir = std::string(dir) + "/";
+    HttpConn::srcDir = srcDir.c_str();
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    sockaddr_in addr = {0};
+    HttpConn conn;
+    conn.init(fds[0], addr);
+    int err = 0;
+    std::string req = "GET /../../../../etc/passwd HTTP/1.1\r\n\r\n";
+    assert(::write(fds[1], req.data(), req.size()) == (ssize_t) req.size());
+    assert(conn.read(&err) > 0 && conn.process());
+    assert(DrainConn(conn, fds[1]).compare(0, 12, "HTTP/1.1 400") == 0);
+    assert(cache->Count() == count && cache->WatchCount() == watches);
+    conn.Close();
+    close(fds[1]);
+    HttpConn::userCount = 0;
+
+    /* 修改文件后,inotify线程使条目失效 */
+    WriteFile(a, "<html>v2</html>");
+    for (int i = 0; i < 100 && cache->Get(a)->body != "<html>v2</html>"; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    assert(cache->Get(a)->body == "<html>v2</html>");
+    assert(cache->Get(a)->etag != entry->etag);           //内容变化后ETag随之变化
+    assert(entry->lastModified == HttpResponse::HttpDate(entry->st.st_mtime));
+    assert(HttpResponse::HttpDate(0) == "Thu, 01 Jan 1970 00:00:00 GMT");
+    assert(entry->body == "<html>v1</html>");             //已取出的旧条目仍然有效
+    unlink(a.data());
+    for (int i = 0; i < 100 && cache->Get(a); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    assert(cache->Get(a) == nullptr);
+
+    /* 超出容量时按LRU淘汰 */
+    for (int i = 0; i < 200; i++) {
+        std::string path = std::string(dir) + "/f" + std::to_string(i);
+        WriteFile(path, std::string(1000, 'f'));
+        assert(cache->Get(path));
+    }
+    assert(cache->Bytes() <= 16 * 4096 && cache->Count() < 200);
+    for (int i = 0; i < 200; i++) {
+        unlink((std::string(dir) + "/f" + std::to_string(i)).data());
+    }
+    unlink(b.data());
+    rmdir(dir);
+    cache->Init(0);
+}
+
+void TestDeflater() {
+    /* 以resources下的页面作为典型的动态HTML响应,找不到时用合成数据 */
+    std::string html;
+    FILE *fp = fopen("../resources/index.html", "r");
+    if (fp) {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) { html.append(buf, n); }
+        fclose(fp);
+    }
+    for (int i = 0; html.size() < 2048; i++) {
+        html += "<tr><td>" + std::to_string(i) + "</td><td class=\"name\">user" + std::to_string(i) + "</td></tr>\n";
+    }
+
+    const int N = 20000;
+    for (int level : {1, 3, 6, 9}) {
+        Deflater::level = level;
+        std::string_view out = Deflater::Local()->Compress(html.data(), html.size());
+        assert(!out.empty() && out.size() < html.size());
+
+        /* 解压校验 */
+        std::string back(html.size(), '\0');
+        z_stream strm = {};
+        assert(inflateInit2(&strm, 15 + 16) == Z_OK);
+        strm.next_in = (Bytef *) out.data();
+        strm.avail_in = out.size();
+        strm.next_out = (Bytef *) &back[0];
+        strm.avail_out = back.size();
+        assert(inflate(&strm, Z_FINISH) == Z_STREAM_END && strm.total_out == html.size());
+        inflateEnd(&strm);
+        assert(back == html);
+
+        size_t outLen = out.size();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < N; i++) {
+            Deflater::Local()->Compress(html.data(), html.size());
+        }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Deflater level %d: %zu -> %zu bytes (saved %.1f%%), %.1f us/response, %.0f MB/s\n",
+               level, html.size(), outLen, 100.0 * (html.size() - outLen) / html.size(),
+               sec * 1e6 / N, N * html.size() / sec / 1e6);
+    }
+    Deflater::level = 6;
+}
+
+void TestConnTable() {
+    ConnTable table(1024);
+    sockaddr_in addr = {0};
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    assert(table.Get(fds[0]) == nullptr);
+
+    HttpConn *conn = table.Acquire(fds[0]);
+    assert(reinterpret_cast<uintptr_t>(conn) % 64 == 0);
+    conn->init(fds[0], addr);
+    uint32_t gen = conn->GetGen();
+    assert(table.Get(fds[0], gen) == conn);
+
+    /* 关闭后旧代数的事件被丢弃 */
+    conn->Close();
+    assert(table.Get(fds[0], gen) == nullptr);
+
+    /* fd复用时沿用同一个HttpConn,旧代数仍然失效 */
+    assert(dup2(fds[1], fds[0]) == fds[0]);
+    HttpConn *reused = table.Acquire(fds[0]);
+    assert(reused == conn);
+    reused->init(fds[0], addr);
+    assert(table.Get(fds[0], reused->GetGen()) == reused);
+    assert(table.Get(fds[0], gen) == nullptr);
+    reused->Close();
+    close(fds[1]);
+    HttpConn::userCount = 0;
+
+    /* 与unordered_map查找对比 */
+    const int N = 1000, ROUNDS = 10000;
+    std::unordered_map<int, int> map;
+    ConnTable bench(N);
+    for (int i = 0; i < N; i++) {
+        map[i] = i;
+        bench.Acquire(i);
+    }
+    size_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < N; i++) { sum += map.count(i) + map[i]; }
+    }
+    double mapSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < N; i++) { sum += reinterpret_cast<uintptr_t>(bench.Get(i, 0)); }
+    }
+    double tableSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("ConnTable lookup: unordered_map %.1f ns, table %.1f ns (%zu)\n",
+           mapSec * 1e9 / N / ROUNDS, tableSec * 1e9 / N / ROUNDS, sum & 1);
+}
+
+/**
+ * 等待一轮事件,返回fd -> 事件掩码
+ */
+std::map<int, uint32_t> WaitEvents(Poller &poller, int timeoutMs, std::map<int, uint32_t> *tags = nullptr) {
+    std::map<int, uint32_t> events;
+    int n = poller.Wait(timeoutMs);
+    for (int i = 0; i < n; i++) {
+        events[poller.GetEventFd(i)] |= poller.GetEvents(i);
+        if (tags) { (*tags)[poller.GetEventFd(i)] = poller.GetEventTag(i); }
+    }
+    return events;
+}
+
+/**
+ * 用poller收取fd上的数据直到EAGAIN
+ */
+std::string RecvAll(Poller &poller, int fd, ssize_t *last = nullptr) {
+    std::string data;
+    Buffer buff;
+    int err = 0;
+    ssize_t len;
+    while ((len = poller.Recv(fd, buff, &err)) > 0) { data += buff.RetrieveAllToStr(); }
+    if (last) { *last = len < 0 ? -err : 0; }
+    return data;
+}
+
+void TestPoller() {
+    /* io_uring_setup失败(SQ超过32768项)时回退到epoll */
+    assert(!UringPoller(65536).IsValid());
+    std::unique_ptr<Poller> fallback(Poller::NewPoller(true, 65536));
+    assert(std::string(fallback->Name()) == "epoll");
+
+    for (bool useUring : {false, true}) {
+        std::unique_ptr<Poller> poller(Poller::NewPoller(useUring));
+        if (useUring && std::string(poller->Name()) != "io_uring") {
+            printf("Poller: io_uring unavailable, skipped\n");
+            continue;
+        }
+        bool uring = useUring;
+
+        /* 管道: 水平触发持续报告,EPOLLONESHOT触发一次后需ModFd重新注册,注销后不再报告 */
+        int p[2];
+        assert(pipe2(p, O_NONBLOCK) == 0);
+        assert(poller->AddFd(p[0], EPOLLIN, 5));
+        assert(WaitEvents(*poller, 0).empty());
+        assert(::write(p[1], "x", 1) == 1);
+        std::map<int, uint32_t> tags;
+        std::map<int, uint32_t> ev = WaitEvents(*poller, 1000, &tags);
+        assert(ev.size() == 1 && ev[p[0]] == EPOLLIN && tags[p[0]] == 5);
+        assert(WaitEvents(*poller, 1000)[p[0]] == EPOLLIN);
+        char c;
+        assert(::read(p[0], &c, 1) == 1);
+        assert(WaitEvents(*poller, 0).empty());
+        assert(poller->ModFd(p[0], EPOLLIN | EPOLLONESHOT, 6));
+        assert(::write(p[1], "x", 1) == 1);
+        tags.clear();
+        ev = WaitEvents(*poller, 1000, &tags);
+        assert(ev[p[0]] == EPOLLIN && tags[p[0]] == 6);
+        assert(WaitEvents(*poller, 0).empty());
+        assert(poller->ModFd(p[0], EPOLLIN | EPOLLONESHOT, 6));
+        assert(WaitEvents(*poller, 1000)[p[0]] == EPOLLIN);
+        assert(poller->DelFd(p[0]) && !poller->DelFd(p[0]));
+        assert(WaitEvents(*poller, 0).empty());
+        close(p[0]);
+        close(p[1]);
+
+        /* 连接fd: EPOLLOUT经ModFd注册;数据由Recv取出,EPOLLONESHOT下取完之前到达的数据在ModFd后报告 */
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        assert(poller->AddConnFd(fds[0], EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, 9));
+        assert(WaitEvents(*poller, 0).empty());
+        assert(poller->ModFd(fds[0], EPOLLOUT | EPOLLRDHUP | EPOLLONESHOT, 9));
+        assert(WaitEvents(*poller, 1000)[fds[0]] == EPOLLOUT);
+        std::string sent(64 * 1024, 0);
+        for (size_t i = 0; i < sent.size(); i++) { sent[i] = static_cast<char>(i * 7); }
+        assert(::write(fds[1], sent.data(), sent.size()) == (ssize_t) sent.size());
+        assert(WaitEvents(*poller, 0).empty());
+        assert(poller->ModFd(fds[0], EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, 9));
+        tags.clear();
+        ev = WaitEvents(*poller, 1000, &tags);
+        assert(ev[fds[0]] == EPOLLIN && tags[fds[0]] == 9);
+        if (uring) {
+            /* 数据已被内核收进提供缓冲区,套接字中没有了 */
+            assert(::read(fds[0], &c, 1) < 0 && errno == EAGAIN);
+        }
+        ssize_t last;
+        std::string got = RecvAll(*poller, fds[0], &last);
+        assert(last == -EAGAIN);
+        assert(::write(fds[1], "tail", 4) == 4);
+        assert(WaitEvents(*poller, 50).empty());
+        assert(poller->ModFd(fds[0], EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, 9));
+        assert(WaitEvents(*poller, 1000)[fds[0]] == EPOLLIN);
+        got += RecvAll(*poller, fds[0]);
+        /* 线程池模式下由工作线程ModFd,已到达的数据也要唤醒阻塞在Wait中的线程 */
+        assert(::write(fds[1], "more", 4) == 4);
+        assert(WaitEvents(*poller, 50).empty());
+        std::thread worker([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            poller->ModFd(fds[0], EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, 9);
+        });
+        auto start = std::chrono::steady_clock::now();
+        assert(WaitEvents(*poller, 5000)[fds[0]] == EPOLLIN);
+        assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+        worker.join();
+        got += RecvAll(*poller, fds[0]);
+        assert(got == sent + "tail" + "more");
+        close(fds[1]);
+        assert(poller->ModFd(fds[0], EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, 9));
+        assert(WaitEvents(*poller, 1000)[fds[0]] & EPOLLRDHUP);
+        assert(RecvAll(*poller, fds[0], &last).empty() && last == 0);
+        assert(poller->DelFd(fds[0]));
+        close(fds[0]);
+
+        /* Send: 响应头与响应体按序发出,对端读完之前套接字写满时等EPOLLOUT后以剩余的iov继续;
+         * io_uring下整串在内核中发完,只需等一次EPOLLOUT */
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        assert(poller->AddConnFd(fds[0], EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, 3));
+        std::string head = "HTTP/1.1 200 OK\r\n\r\n", body(512 * 1024, 0);
+        for (size_t i = 0; i < body.size(); i++) { body[i] = static_cast<char>(i * 13); }
+        std::vector <struct iovec> iov = {{&head[0], head.size()}, {&body[0], body.size()}};
+        size_t iovIdx = 0;
+        auto advance = [&](size_t n) {
+            while (n > 0) {
+                if (n >= iov[iovIdx].iov_len) {
+                    n -= iov[iovIdx++].iov_len;
+                } else {
+                    iov[iovIdx].iov_base = static_cast<char *>(iov[iovIdx].iov_base) + n;
+                    iov[iovIdx].iov_len -= n;
+                    n = 0;
+                }
+            }
+        };
+        got.clear();
+        std::thread reader([&] {
+            char buf[65536];
+            while (got.size() < head.size() + body.size()) {
+                ssize_t n = ::read(fds[1], buf, sizeof(buf));
+                if (n > 0) {
+                    got.append(buf, n);
+                } else {
+                    struct pollfd pfd = {fds[1], POLLIN, 0};
+                    poll(&pfd, 1, 100);
+                }
+            }
+        });
+        int err = 0, outWaits = 0;
+        while (iovIdx < iov.size()) {
+            ssize_t n = poller->Send(fds[0], iov.data() + iovIdx, iov.size() - iovIdx, false, &err);
+            if (n > 0) {
+                advance(n);
+                continue;
+            }
+            assert(n < 0 && err == EAGAIN);
+            assert(poller->ModFd(fds[0], EPOLLOUT | EPOLLRDHUP | EPOLLONESHOT, 3));
+            tags.clear();
+            ev = WaitEvents(*poller, 2000, &tags);
+            assert((ev[fds[0]] & EPOLLOUT) && tags[fds[0]] == 3);
+            outWaits++;
+        }
+        reader.join();
+        assert(got == head + body);
+        assert(!uring || outWaits == 1);
+        /* 对端不读时注销: io_uring下在途的send被撤销,之后改写的内存不会再被发出,对端只收到原数据的前缀 */
+        iov = {{&head[0], head.size()}, {&body[0], body.size()}};
+        iovIdx = 0;
+        ssize_t first = poller->Send(fds[0], iov.data(), iov.size(), false, &err);
+        assert(first > 0 || err == EAGAIN);
+        assert(poller->DelFd(fds[0]));
+        std::string whole = head + body;
+        body.assign(body.size(), 'Z');
+        got.clear();
+        for (int idle = 0; idle < 5;) {
+            char buf[65536];
+            ssize_t n = ::read(fds[1], buf, sizeof(buf));
+            if (n > 0) {
+                got.append(buf, n);
+                idle = 0;
+            } else {
+                idle++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        assert(got.size() < whole.size() && whole.compare(0, got.size(), got) == 0);
+        assert(WaitEvents(*poller, 50).empty());
+        close(fds[0]);
+        close(fds[1]);
+
+        /* 数据多于单个fd可占用的缓冲区时recv暂停,Recv归还缓冲区后继续,数据完整且有序 */
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        int flags = fcntl(fds[1], F_GETFL);
+        fcntl(fds[1], F_SETFL, flags & ~O_NONBLOCK);
+        assert(poller->AddConnFd(fds[0], EPOLLIN | EPOLLRDHUP));
+        assert(WaitEvents(*poller, 0).empty());   //提交recv,等待期间内核持续收进缓冲区直到耗尽
+        const size_t BIG = 3 << 20;
+        std::thread writer([&] {
+            std::string chunk(64 * 1024, 0);
+            for (size_t off = 0; off < BIG; off += chunk.size()) {
+                for (size_t i = 0; i < chunk.size(); i++) { chunk[i] = static_cast<char>((off + i) % 251); }
+                assert(::write(fds[1], chunk.data(), chunk.size()) == (ssize_t) chunk.size());
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        got.clear();
+        while (got.size() < BIG) {
+            ev = WaitEvents(*poller, 1000);
+            assert(ev[fds[0]] == EPOLLIN);
+            got += RecvAll(*poller, fds[0]);
+        }
+        writer.join();
+        assert(got.size() == BIG);
+        for (size_t i = 0; i < BIG; i++) { assert(got[i] == static_cast<char>(i % 251)); }
+        assert(poller->DelFd(fds[0]));
+        close(fds[0]);
+        close(fds[1]);
+
+        /* 一个fd不取数据而对端持续发送时,它占用的缓冲区有上限,另一个fd仍能收到数据 */
+        int hog[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, hog) == 0);
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        assert(poller->AddConnFd(hog[0], EPOLLIN | EPOLLRDHUP));
+        assert(poller->AddConnFd(fds[0], EPOLLIN | EPOLLRDHUP));
+        std::string chunk(64 * 1024, 0);
+        size_t hogSent = 0;
+        for (int idle = 0; idle < 20 && hogSent < (8u << 20);) {
+            ssize_t n = ::write(hog[1], chunk.data(), chunk.size());
+            if (n > 0) {
+                hogSent += n;
+                idle = 0;
+            } else {
+                idle++;
+            }
+            WaitEvents(*poller, n > 0 ? 0 : 5);
+        }
+        assert(hogSent < (8u << 20));
+        assert(::write(fds[1], "ping", 4) == 4);
+        got.clear();
+        for (int i = 0; i < 100 && got.empty(); i++) {
+            if (WaitEvents(*poller, 10).count(fds[0])) { got = RecvAll(*poller, fds[0]); }
+        }
+        assert(got == "ping");
+        /* 取走之后恢复接收,数据完整 */
+        size_t hogGot = 0;
+        for (int i = 0; i < 1000 && hogGot < hogSent; i++) {
+            WaitEvents(*poller, 10);
+            hogGot += RecvAll(*poller, hog[0]).size();
+        }
+        assert(hogGot == hogSent);
+        assert(poller->DelFd(hog[0]) && poller->DelFd(fds[0]));
+        for (int fd : {hog[0], hog[1], fds[0], fds[1]}) { close(fd); }
+
+        /* 监听fd: 水平触发时每轮Accept一个,其余的下一轮继续报告;新连接为非阻塞,地址为对端地址 */
+        int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        assert(bind(listenFd, (sockaddr *) &addr, sizeof(addr)) == 0 && listen(listenFd, 16) == 0);
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, (sockaddr *) &addr, &len);
+        assert(poller->AddListenFd(listenFd, EPOLLIN));
+        const int CLIENTS = 3;
+        std::set<int> ports;
+        int clients[CLIENTS];
+        for (int &client : clients) {
+            client = socket(AF_INET, SOCK_STREAM, 0);
+            assert(connect(client, (sockaddr *) &addr, sizeof(addr)) == 0);
+            sockaddr_in local;
+            len = sizeof(local);
+            getsockname(client, (sockaddr *) &local, &len);
+            ports.insert(local.sin_port);
+        }
+        std::vector<int> accepted;
+        while (accepted.size() < CLIENTS) {
+            assert(WaitEvents(*poller, 1000)[listenFd] & EPOLLIN);
+            sockaddr_in peer;
+            int fd = poller->Accept(listenFd, &peer);
+            assert(fd >= 0 && (fcntl(fd, F_GETFL) & O_NONBLOCK) && ports.erase(peer.sin_port) == 1);
+            accepted.push_back(fd);
+        }
+        sockaddr_in peer;
+        assert(poller->Accept(listenFd, &peer) < 0 && errno == EAGAIN);
+        assert(WaitEvents(*poller, 0).empty());
+        assert(poller->DelFd(listenFd));
+        close(listenFd);
+        for (int fd : accepted) { close(fd); }
+        for (int client : clients) { close(client); }
+    }
+
+    /* 单线程乒乓: 一轮为写入、Wait、Recv */
+    const int ROUNDS = 20000;
+    for (bool useUring : {false, true}) {
+        std::unique_ptr<Poller> poller(Poller::NewPoller(useUring, 64));
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        poller->AddConnFd(fds[0], EPOLLIN | EPOLLET);
+        char msg[64] = {0};
+        Buffer buff;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; i++) {
+            assert(::write(fds[1], msg, sizeof(msg)) == sizeof(msg));
+            while (poller->Wait(1000) == 0) {}
+            int err = 0;
+            while (poller->Recv(fds[0], buff, &err) > 0) {}
+            buff.RetrieveAll();
+        }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Poller ping-pong %-8s: %.2f us/round\n", poller->Name(), sec * 1e6 / ROUNDS);
+        poller->DelFd(fds[0]);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    /* 线程池模式: 多个线程ModFd/DelFd的同时另一线程阻塞在Wait中,每次重新注册的EPOLLONESHOT都要报告;
+     * 请求在填完之前被另一线程的io_uring_enter提交时会丢失,对应的fd不再有事件 */
+    for (bool useUring : {false, true}) {
+        std::unique_ptr<Poller> poller(Poller::NewPoller(useUring, 16));
+        const int THREADS = 4, PER = 4, REARMS = 500;
+        std::vector<int> pipes;
+        for (int i = 0; i < THREADS * PER; i++) {
+            int p[2];
+            assert(pipe2(p, O_NONBLOCK) == 0 && ::write(p[1], "x", 1) == 1);   //一直可读
+            pipes.push_back(p[0]);
+            pipes.push_back(p[1]);
+        }
+        std::unique_ptr<std::atomic<int>[]> seen(new std::atomic<int>[1024]());
+        for (int i = 0; i < THREADS * PER; i++) { assert(poller->AddFd(pipes[2 * i], EPOLLIN | EPOLLONESHOT)); }
+        std::atomic<bool> stop(false);
+        std::thread waiter([&] {
+            while (!stop) {
+                int n = poller->Wait(100);
+                for (int i = 0; i < n; i++) { seen[poller->GetEventFd(i)]++; }
+            }
+        });
+        auto waitSeen = [&](int fd, int above) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            while (seen[fd] <= above) {
+                assert(std::chrono::steady_clock::now() < deadline);
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+        };
+        auto start = std::chrono::steady_clock::now();
+        std::vector <std::thread> workers;
+        for (int t = 0; t < THREADS; t++) {
+            workers.emplace_back([&, t] {
+                for (int i = 0; i < PER; i++) { waitSeen(pipes[2 * (t * PER + i)], 0); }
+                for (int r = 0; r < REARMS; r++) {
+                    for (int i = 0; i < PER; i++) {
+                        int fd = pipes[2 * (t * PER + i)];
+                        int before = seen[fd];
+                        if (r % 2) {
+                            assert(poller->DelFd(fd) && poller->AddFd(fd, EPOLLIN | EPOLLONESHOT));
+                        } else {
+                            assert(poller->ModFd(fd, EPOLLIN | EPOLLONESHOT));
+                        }
+                        waitSeen(fd, before);
+                    }
+                }
+            });
+        }
+        for (auto &worker : workers) { worker.join(); }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stop = true;
+        waiter.join();
+        printf("Poller %-8s: %d threads rearming while another waits, %.1f us/rearm\n", poller->Name(), THREADS,
+               sec * 1e6 * THREADS / (THREADS * PER * REARMS));
+        for (int fd : pipes) { close(fd); }
+    }
+}
+
+void TestSubReactor() {
+    /* 主Reactor通过AddClient投递连接,子Reactor经eventfd唤醒后接管,在自己的线程中读、处理并回复 */
+    HttpConn::srcDir = "./no-such-dir";
+    for (bool useUring : {false, true}) {
+        Config config;
+        config.useUring = useUring;
+        SubReactor reactor(0, 60000, EPOLLRDHUP, config);
+        reactor.Start();
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        int flags = fcntl(fds[1], F_GETFL);
+        fcntl(fds[1], F_SETFL, flags & ~O_NONBLOCK);
+        sockaddr_in addr = {0};
+        reactor.AddClient(fds[0], addr);
+
+        /* 保持连接的请求得到响应后连接仍在,同一连接上的下一个请求同样被处理 */
+        const char keep[] = "GET /a HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+        assert(::write(fds[1], keep, sizeof(keep) - 1) == (ssize_t) sizeof(keep) - 1);
+        std::string resp = RecvUntil(fds[1], "</html>");
+        assert(resp.compare(0, 22, "HTTP/1.1 404 Not Found") == 0);
+        assert(resp.find("Connection: keep-alive") != std::string::npos);
+        const char last[] = "GET /b HTTP/1.1\r\nConnection: close\r\n\r\n";
+        assert(::write(fds[1], last, sizeof(last) - 1) == (ssize_t) sizeof(last) - 1);
+        resp = RecvUntil(fds[1], "");
+        assert(resp.compare(0, 22, "HTTP/1.1 404 Not Found") == 0 && resp.find("Connection: close") != std::string::npos);
+        close(fds[1]);
+        reactor.Stop();
+        assert(HttpConn::userCount == 0);
+    }
+
+    /* 响应直接发送;大于套接字缓冲区时遇到EAGAIN才注册EPOLLOUT,发完后改回EPOLLIN,同一连接上的下一个请求照常处理 */
+    char dir[] = "/tmp/subreactorXXXXXX";
+    assert(mkdtemp(dir));
+    const size_t BIG = 4 << 20;
+    WriteFile(std::string(dir) + "/big.bin", std::string(BIG, 'x'));
+    HttpConn::srcDir = dir;
+    HttpConn::isET = true;
+    for (bool useUring : {false, true}) {
+        Config config;
+        config.useUring = useUring;
+        SubReactor reactor(0, 60000, EPOLLRDHUP | EPOLLET, config);
+        reactor.Start();
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        sockaddr_in addr = {0};
+        reactor.AddClient(fds[0], addr);
+        const char req[] = "GET /big.bin HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+        for (int round = 0; round < 2; round++) {
+            assert(::write(fds[1], req, sizeof(req) - 1) == (ssize_t) sizeof(req) - 1);
+            if (round == 0) { std::this_thread::sleep_for(std::chrono::milliseconds(50)); }   //暂不读取,发送遇到EAGAIN
+            std::string resp = RecvUntil(fds[1], "\r\n\r\n");
+            size_t head = resp.find("\r\n\r\n");
+            assert(head != std::string::npos && resp.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+            head += 4;
+            while (resp.size() < head + BIG) {
+                std::string more = RecvUntil(fds[1], "x", 2000);
+                assert(!more.empty());
+                resp += more;
+            }
+            assert(resp.size() == head + BIG && resp.find_first_not_of('x', head) == std::string::npos);
+        }
+        close(fds[1]);
+        for (int i = 0; i < 200 && HttpConn::userCount > 0; i++) {   //对端关闭由loop线程异步处理
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        reactor.Stop();
+        assert(HttpConn::userCount == 0);
+    }
+    HttpConn::isET = false;
+    HttpConn::srcDir = "./no-such-dir";
+    unlink((std::string(dir) + "/big.bin").data());
+    rmdir(dir);
+}
+
+void TestReusePort() {
+    /* 每个分片一个绑定同一端口的SO_REUSEPORT监听fd,由内核分发新连接;各分片的accept计数之和等于连接数 */
+    HttpConn::srcDir = "./no-such-dir";
+    const int SHARDS = 4, CONNS = 64;
+    for (bool useUring : {false, true}) {
+        Config config;
+        config.useUring = useUring;
+        sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        std::vector<std::unique_ptr<SubReactor>> shards;
+        for (int i = 0; i < SHARDS; i++) {
+            int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            int on = 1;
+            assert(setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == 0);
+            assert(bind(listenFd, (sockaddr *) &addr, sizeof(addr)) == 0 && listen(listenFd, CONNS) == 0);
+            if (i == 0) {
+                socklen_t len = sizeof(addr);
+                getsockname(listenFd, (sockaddr *) &addr, &len);   //其余分片绑定同一端口
+            }
+            shards.emplace_back(new SubReactor(i, 60000, EPOLLRDHUP, config));
+            shards.back()->SetListenFd(listenFd, EPOLLRDHUP);
+            shards.back()->Start();
+        }
+
+        std::vector<int> clients;
+        for (int i = 0; i < CONNS; i++) {
+            int client = socket(AF_INET, SOCK_STREAM, 0);
+            assert(connect(client, (sockaddr *) &addr, sizeof(addr)) == 0);
+            clients.push_back(client);
+        }
+        uint64_t total = 0;
+        for (int i = 0; i < 200 && total < CONNS; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            total = 0;
+            for (auto &shard : shards) { total += shard->AcceptCount(); }
+        }
+        assert(total == CONNS);
+        int used = 0;
+        std::string stat;
+        for (auto &shard : shards) {
+            used += shard->AcceptCount() > 0;
+            stat += " [" + std::to_string(shard->GetId()) + "]:" + std::to_string(shard->AcceptCount());
+        }
+        assert(used > 1);
+        printf("ReusePort %-8s: %d connections over %d shards:%s\n", useUring ? "io_uring" : "epoll", CONNS, SHARDS,
+               stat.c_str());
+
+        for (int client : clients) { close(client); }
+        for (int i = 0; i < 200 && HttpConn::userCount > 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        assert(HttpConn::userCount == 0);
+        shards.clear();
+    }
+}
+
+void TestTimer() {
+    for (bool useWheel : {false, true}) {
+        std::unique_ptr<Timer> timer(Timer::NewTimer(useWheel, 1));
+        std::vector<int> fired;
+        auto record = [&fired](int id) { return [&fired, id] { fired.push_back(id); }; };
+        timer->add(1, 30, record(1));
+        timer->add(2, 10, record(2));
+        timer->add(3, 20, record(3));
+        timer->add(4, 5, record(4));
+        timer->add(5, 300, record(5));   //跨过时间轮第0层一圈
+        timer->adjust(2, 40);            //刷新后晚于1
+        timer->cancel(3);                //取消后不再触发
+        timer->doWork(4);                //立即触发
+        assert(fired == std::vector<int>({4}) && timer->size() == 3);
+
+        auto start = Clock::now();
+        while (timer->size() > 0) {
+            int ms = timer->GetNextTick();   //最后一个任务在其中触发时返回-1
+            assert(ms <= 300);
+            if (ms > 0) { std::this_thread::sleep_for(MS(ms)); }
+        }
+        int elapsed = std::chrono::duration_cast<MS>(Clock::now() - start).count();
+        assert(fired == std::vector<int>({4, 1, 2, 5}) && elapsed >= 299);
+        assert(timer->GetNextTick() == -1);
+
+        /* 回调函数中重新添加同一id(惰性超时的续期方式),不影响同一轮到期的其他任务 */
+        fired.clear();
+        int renew = 2;
+        std::function<void()> lazy = [&] {
+            fired.push_back(6);
+            if (renew-- > 0) { timer->add(6, 5, lazy); }
+        };
+        timer->add(6, 5, lazy);
+        timer->add(7, 5, record(7));
+        while (timer->size() > 0) {
+            int ms = timer->GetNextTick();
+            if (ms > 0) { std::this_thread::sleep_for(MS(ms)); }
+        }
+        assert(std::count(fired.begin(), fired.end(), 6) == 3 && std::count(fired.begin(), fired.end(), 7) == 1);
+    }
+
+    /* 惰性超时模式下每个事件只读一次缓存的粗粒度时钟 */
+    const int CLOCK_N = 1000000;
+    int64_t sink = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < CLOCK_N; i++) { sink += Clock::now().time_since_epoch().count() & 1; }
+    auto mid = Clock::now();
+    for (int i = 0; i < CLOCK_N; i++) { sink += Timer::CoarseMs() & 1; }
+    auto end = Clock::now();
+    printf("Clock::now %.1f ns, CLOCK_MONOTONIC_COARSE %.1f ns (%lld)\n",
+           std::chrono::duration<double, std::nano>(mid - start).count() / CLOCK_N,
+           std::chrono::duration<double, std::nano>(end - mid).count() / CLOCK_N, (long long) (sink & 1));
+
+    /* 添加、刷新、取消的耗时对比;timeout取1~60秒,与连接超时的量级一致 */
+    for (int n : {10000, 100000, 1000000}) {
+        std::vector<int> timeouts(n);
+        unsigned seed = 1;
+        for (int &t : timeouts) {
+            seed = seed * 1103515245 + 12345;
+            t = 1000 + (seed >> 8) % 59000;
+        }
+        for (bool useWheel : {false, true}) {
+            std::unique_ptr<Timer> timer(Timer::NewTimer(useWheel, 10));
+            auto start = Clock::now();
+            for (int i = 0; i < n; i++) { timer->add(i, timeouts[i], [] {}); }
+            auto added = Clock::now();
+            for (int i = 0; i < n; i++) { timer->adjust(static_cast<int>(i * 7919LL % n), timeouts[n - 1 - i]); }
+            auto adjusted = Clock::now();
+            for (int i = 0; i < n; i++) { timer->cancel(i); }
+            auto cancelled = Clock::now();
+            assert(timer->size() == 0);
+            auto ns = [n](TimeStamp a, TimeStamp b) {
+                return std::chrono::duration<double, std::nano>(b - a).count() / n;
+            };
+            printf("Timer %-5s %7d timers: add %.0f ns, adjust %.0f ns, cancel %.0f ns\n", timer->Name(), n,
+                   ns(start, added), ns(added, adjusted), ns(adjusted, cancelled));
+        }
+    }
+}
+
 int main() {
+    TestHttpRequestParse();
+    TestHttpRequestRange();
+    TestDelimScanner();
+    TestPipeline();
+    TestPartialWrite();
+    TestSidecar();
+    TestFileCache();
+    TestDeflater();
+    TestConnTable();
+    TestPoller();
+    TestSubReactor();
+    TestReusePort();
+    TestTimer();
+    TestTask();
+    TestCpuAffinity();
+    TestThreadPoolBench();
     TestLog();
+    TestLogRing();
+    TestLogLevel();
+    TestLogBinary();
+    TestAccessLog();
+    TestLogRotate();
+    TestLogArchiver();
+    TestMetrics();
     TestThreadPool();
 }
\ No newline at end of file